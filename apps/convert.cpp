@@ -0,0 +1,301 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vibration_daq/CSVImporter.hpp>
+#include <vibration_daq/CaptureIndex.hpp>
+#include <vibration_daq/CaptureReader.hpp>
+#include <vibration_daq/SegmentArchive.hpp>
+#include <vibration_daq/StorageModule.hpp>
+#include <vibration_daq/utils/WorkStealingPool.hpp>
+#include "loguru/loguru.hpp"
+
+using namespace vibration_daq;
+
+/**
+ * Files converted by one thread in order: a segment, or the CSV files of a sensor in one segment duration.
+ */
+struct ConvertTask {
+    std::vector<fs::path> files;
+    uint64_t size = 0; // bytes
+};
+
+struct ConvertStatistics {
+    std::atomic<uint64_t> capturesCount{0};
+    std::atomic<uint64_t> skippedCount{0}; // files or captures
+    std::atomic<bool> failed{false};
+};
+
+static void printUsage() {
+    std::cerr << "Usage: vibration_daq_convert <input_directory> <output_directory> --format <CSV|SEGMENT>"
+                 " [--codec <RAW|DELTA_PACK>] [--threads <count>] [--recursive]" << std::endl
+              << "Converts the CSV files and segments of the input directory to the format in the output"
+                 " directory." << std::endl;
+}
+
+static uint64_t getDirectorySize(const fs::path &directory) {
+    uint64_t size = 0;
+    for (const auto &entry : fs::recursive_directory_iterator(directory)) {
+        if (entry.is_regular_file()) {
+            size += entry.file_size();
+        }
+    }
+    return size;
+}
+
+/**
+ * Groups the input files to tasks, the largest first.
+ */
+static std::vector<ConvertTask> createTasks(const fs::path &inputDirectory, bool recursive,
+                                            const StorageConfig &storageConfig, uint64_t &totalSize) {
+    std::vector<ConvertTask> tasks;
+    // CSV files per sensor and segment duration, ordered by trigger time
+    std::map<std::pair<std::string, int64_t>, std::map<int64_t, fs::path>> csvFiles;
+    const int64_t segmentDurationNs = static_cast<int64_t>(storageConfig.segmentMaxDuration) * 1000000000;
+    totalSize = 0;
+
+    const auto addFile = [&](const fs::directory_entry &entry) {
+        if (!entry.is_regular_file()) {
+            return;
+        }
+        const fs::path &path = entry.path();
+        CaptureLocation captureLocation;
+        if (path.extension() == SegmentArchive::SEGMENT_EXTENSION) {
+            ConvertTask task;
+            task.files.push_back(path);
+            task.size = entry.file_size();
+            tasks.push_back(task);
+        } else if (CaptureIndex::parseCSVFileName(path.filename().string(), captureLocation)) {
+            const int64_t window = captureLocation.triggerRealtimeNs / segmentDurationNs;
+            csvFiles[{captureLocation.sensorName, window}][captureLocation.triggerRealtimeNs] = path;
+        } else {
+            return;
+        }
+        totalSize += entry.file_size();
+    };
+    if (recursive) {
+        for (const auto &entry : fs::recursive_directory_iterator(inputDirectory)) {
+            addFile(entry);
+        }
+    } else {
+        for (const auto &entry : fs::directory_iterator(inputDirectory)) {
+            addFile(entry);
+        }
+    }
+
+    for (const auto &group : csvFiles) {
+        ConvertTask task;
+        for (const auto &file : group.second) {
+            task.files.push_back(file.second);
+            std::error_code errorCode;
+            task.size += fs::file_size(file.second, errorCode);
+        }
+        tasks.push_back(task);
+    }
+    std::sort(tasks.begin(), tasks.end(), [](const ConvertTask &a, const ConvertTask &b) {
+        return a.size > b.size;
+    });
+    return tasks;
+}
+
+/**
+ * Writes the capture like StorageModule::storeVibrationData() with StorageFormat::CSV.
+ */
+static bool writeCSVCapture(const fs::path &outputDirectory, const CaptureRecord &captureRecord) {
+    const VibrationData &vibrationData = captureRecord.vibrationData;
+    const std::string fileStem = (outputDirectory / StorageModule::getCSVFileStem(
+            vibrationData.recordingMode, captureRecord.sensorName, captureRecord.triggerTimestamp)).string();
+    const std::string dataFilePath = fileStem + ".csv";
+    const std::string metadataFilePath = fileStem + ".yaml";
+    const std::string temporaryDataFilePath = dataFilePath + StorageModule::TEMPORARY_EXTENSION;
+    const std::string temporaryMetadataFilePath = metadataFilePath + StorageModule::TEMPORARY_EXTENSION;
+
+    std::error_code errorCode;
+    if (!StorageModule::writeCSVFile(vibrationData, temporaryDataFilePath) ||
+        !StorageModule::storeCaptureMetadata(vibrationData.metadata, captureRecord.sensorName,
+                                             captureRecord.triggerTimestamp, temporaryMetadataFilePath)) {
+        fs::remove(temporaryDataFilePath, errorCode);
+        fs::remove(temporaryMetadataFilePath, errorCode);
+        return false;
+    }
+    // the data file is renamed last, so a data file always has its metadata file
+    fs::rename(temporaryMetadataFilePath, metadataFilePath, errorCode);
+    if (!errorCode) {
+        fs::rename(temporaryDataFilePath, dataFilePath, errorCode);
+    }
+    return !errorCode;
+}
+
+/**
+ * Converts the files of the task, one capture at a time.
+ */
+static void convert(const ConvertTask &task, const fs::path &outputDirectory, const StorageConfig &storageConfig,
+                    ConvertStatistics &statistics) {
+    std::map<std::string, std::unique_ptr<SegmentArchive>> segmentArchives; // per sensor name
+    const auto store = [&](const CaptureRecord &captureRecord) {
+        if (storageConfig.format == StorageFormat::CSV) {
+            return writeCSVCapture(outputDirectory, captureRecord);
+        }
+        auto &segmentArchive = segmentArchives[captureRecord.sensorName];
+        if (!segmentArchive) {
+            segmentArchive = std::make_unique<SegmentArchive>(outputDirectory, captureRecord.sensorName,
+                                                              storageConfig);
+        }
+        CaptureLocation captureLocation;
+        return segmentArchive->append(captureRecord.vibrationData, captureRecord.triggerTimestamp,
+                                      captureLocation);
+    };
+
+    CaptureRecord captureRecord;
+    for (const auto &file : task.files) {
+        if (statistics.failed) {
+            return;
+        }
+
+        if (file.extension() != SegmentArchive::SEGMENT_EXTENSION) {
+            if (!CSVImporter::importFile(file, captureRecord)) {
+                std::cerr << "Skipped " << file << std::endl;
+                ++statistics.skippedCount;
+                continue;
+            }
+            if (!store(captureRecord)) {
+                statistics.failed = true;
+                return;
+            }
+            ++statistics.capturesCount;
+            continue;
+        }
+
+        CaptureReader captureReader;
+        if (!captureReader.open(file)) {
+            std::cerr << "Skipped " << file << std::endl;
+            ++statistics.skippedCount;
+            continue;
+        }
+        for (size_t i = 0; i < captureReader.getCapturesCount(); ++i) {
+            if (!captureReader.readCapture(i, captureRecord)) {
+                std::cerr << "Skipped capture " << i << " of " << file << std::endl;
+                ++statistics.skippedCount;
+                continue;
+            }
+            if (!store(captureRecord)) {
+                statistics.failed = true;
+                return;
+            }
+            ++statistics.capturesCount;
+        }
+    }
+
+    for (auto &segmentArchive : segmentArchives) {
+        if (!segmentArchive.second->close()) {
+            statistics.failed = true;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+    loguru::g_preamble_uptime = false;
+    loguru::g_preamble_thread = false;
+
+    if (argc < 3) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    const fs::path inputDirectory = argv[1];
+    const fs::path outputDirectory = argv[2];
+    int threadsCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    bool recursive = false;
+    bool hasFormat = false;
+    StorageConfig storageConfig;
+
+    for (int i = 3; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--recursive") {
+            recursive = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+        const std::string value = argv[++i];
+
+        bool validValue = true;
+        try {
+            if (option == "--format") {
+                validValue = Enum::convert(value, storageConfig.format);
+                hasFormat = true;
+            } else if (option == "--codec") {
+                validValue = Enum::convert(value, storageConfig.sampleCodec);
+            } else if (option == "--threads") {
+                threadsCount = std::stoi(value);
+            } else {
+                validValue = false;
+            }
+        } catch (const std::exception &) {
+            validValue = false;
+        }
+        if (!validValue || threadsCount <= 0) {
+            std::cerr << "Invalid option: " << option << " " << value << std::endl;
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::error_code errorCode;
+    if (!hasFormat || !fs::is_directory(inputDirectory) || !fs::is_directory(outputDirectory) ||
+        fs::equivalent(inputDirectory, outputDirectory, errorCode)) {
+        std::cerr << "Input and output directory must exist and differ, the format is required." << std::endl;
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t inputSize;
+    std::vector<ConvertTask> tasks;
+    try {
+        tasks = createTasks(inputDirectory, recursive, storageConfig, inputSize);
+    } catch (const fs::filesystem_error &error) {
+        std::cerr << "Could not list " << inputDirectory << ": " << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    ConvertStatistics statistics;
+    WorkStealingPool workStealingPool(threadsCount);
+    for (const auto &task : tasks) {
+        workStealingPool.submit([&task, &outputDirectory, &storageConfig, &statistics]() {
+            convert(task, outputDirectory, storageConfig, statistics);
+        });
+    }
+    workStealingPool.run();
+    if (statistics.failed) {
+        std::cerr << "Storing failed." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the index is built from the converted files
+    const bool hadIndex = fs::is_directory(outputDirectory / CaptureIndex::INDEX_DIRECTORY);
+    CaptureIndex captureIndex;
+    if (!captureIndex.setup(outputDirectory) || (hadIndex && !captureIndex.rebuild())) {
+        std::cerr << "Could not build the capture index." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const uint64_t capturesCount = statistics.capturesCount;
+    std::cout << "converted: " << capturesCount << " captures of " << tasks.size() << " tasks, skipped: "
+              << statistics.skippedCount << std::endl;
+    std::cout << "elapsed: " << elapsed << " s, " << capturesCount / elapsed << " captures/s, "
+              << inputSize / elapsed / 1e6 << " MB/s read" << std::endl;
+    std::cout << "input: " << inputSize << " bytes, output: " << getDirectorySize(outputDirectory) << " bytes"
+              << std::endl;
+    return statistics.skippedCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
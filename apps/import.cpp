@@ -0,0 +1,197 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vibration_daq/CSVImporter.hpp>
+#include <vibration_daq/CaptureIndex.hpp>
+#include <vibration_daq/StorageModule.hpp>
+#include "loguru/loguru.hpp"
+
+using namespace vibration_daq;
+
+static const size_t FILES_PER_THREAD_BATCH = 64;
+
+struct ImportFile {
+    int64_t triggerRealtimeNs;
+    fs::path path;
+};
+
+struct ImportedCapture {
+    bool imported = false;
+    CaptureRecord captureRecord;
+};
+
+static void printUsage() {
+    std::cerr << "Usage: vibration_daq_import <csv_directory> <storage_directory> [--threads <count>]"
+                 " [--codec <RAW|DELTA_PACK>] [--recursive]" << std::endl
+              << "Imports the CSV files of the StorageModule into segments in the storage directory." << std::endl;
+}
+
+/**
+ * Lists the CSV files with a file name of the StorageModule, ordered by trigger time.
+ */
+static std::vector<ImportFile> listFiles(const fs::path &csvDirectory, bool recursive, uint64_t &totalSize) {
+    std::vector<ImportFile> files;
+    totalSize = 0;
+    const auto addFile = [&](const fs::directory_entry &entry) {
+        CaptureLocation captureLocation;
+        if (entry.is_regular_file() &&
+            CaptureIndex::parseCSVFileName(entry.path().filename().string(), captureLocation)) {
+            files.push_back({captureLocation.triggerRealtimeNs, entry.path()});
+            totalSize += entry.file_size();
+        }
+    };
+    if (recursive) {
+        for (const auto &entry : fs::recursive_directory_iterator(csvDirectory)) {
+            addFile(entry);
+        }
+    } else {
+        for (const auto &entry : fs::directory_iterator(csvDirectory)) {
+            addFile(entry);
+        }
+    }
+    // the capture index and the segments expect the captures of a sensor in order
+    std::sort(files.begin(), files.end(), [](const ImportFile &a, const ImportFile &b) {
+        return a.triggerRealtimeNs < b.triggerRealtimeNs;
+    });
+    return files;
+}
+
+/**
+ * Starts threadsCount threads, which import the files [first, first + captures.size()) into captures.
+ */
+static std::vector<std::thread> startImport(const std::vector<ImportFile> &files, size_t first,
+                                            std::vector<ImportedCapture> &captures, int threadsCount) {
+    auto next = std::make_shared<std::atomic<size_t>>(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadsCount; ++i) {
+        threads.emplace_back([&files, first, &captures, next]() {
+            for (size_t j = (*next)++; j < captures.size(); j = (*next)++) {
+                captures[j].imported = CSVImporter::importFile(files[first + j].path, captures[j].captureRecord);
+            }
+        });
+    }
+    return threads;
+}
+
+/**
+ * Stores the imported captures of the files [first, first + captures.size()).
+ */
+static bool storeCaptures(StorageModule &storageModule, const std::vector<ImportFile> &files, size_t first,
+                          const std::vector<ImportedCapture> &captures, size_t &importedCount, size_t &skippedCount) {
+    for (size_t i = 0; i < captures.size(); ++i) {
+        const ImportedCapture &capture = captures[i];
+        if (!capture.imported) {
+            std::cerr << "Skipped " << files[first + i].path << std::endl;
+            ++skippedCount;
+            continue;
+        }
+        const CaptureRecord &captureRecord = capture.captureRecord;
+        if (!storageModule.storeVibrationData(captureRecord.vibrationData, captureRecord.sensorName,
+                                              captureRecord.triggerTimestamp)) {
+            return false;
+        }
+        ++importedCount;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+    loguru::g_preamble_uptime = false;
+    loguru::g_preamble_thread = false;
+
+    if (argc < 3) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    const fs::path csvDirectory = argv[1];
+    const fs::path storageDirectory = argv[2];
+    int threadsCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    bool recursive = false;
+    StorageConfig storageConfig;
+    storageConfig.format = StorageFormat::SEGMENT;
+    // the segments are synced when they are closed
+    storageConfig.syncMode = SyncMode::NEVER;
+
+    for (int i = 3; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--recursive") {
+            recursive = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+        const std::string value = argv[++i];
+
+        bool validValue = true;
+        try {
+            if (option == "--threads") {
+                threadsCount = std::stoi(value);
+            } else if (option == "--codec") {
+                validValue = Enum::convert(value, storageConfig.sampleCodec);
+            } else {
+                validValue = false;
+            }
+        } catch (const std::exception &) {
+            validValue = false;
+        }
+        if (!validValue || threadsCount <= 0) {
+            std::cerr << "Invalid option: " << option << " " << value << std::endl;
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t totalSize;
+    std::vector<ImportFile> files;
+    try {
+        files = listFiles(csvDirectory, recursive, totalSize);
+    } catch (const fs::filesystem_error &error) {
+        std::cerr << "Could not list " << csvDirectory << ": " << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    StorageModule storageModule;
+    // the StorageModule concatenates the directory and the file name
+    if (!storageModule.setup(storageDirectory.string() + "/", storageConfig)) {
+        return EXIT_FAILURE;
+    }
+
+    // the next batch is imported while the previous one is stored
+    const size_t batchSize = FILES_PER_THREAD_BATCH * threadsCount;
+    std::vector<ImportedCapture> importing, storing;
+    size_t storingFirst = 0, importedCount = 0, skippedCount = 0;
+    bool stored = true;
+    for (size_t first = 0; stored && (first < files.size() || !storing.empty()); first += batchSize) {
+        importing.assign(first < files.size() ? std::min(batchSize, files.size() - first) : 0, ImportedCapture());
+        std::vector<std::thread> threads = startImport(files, first, importing, threadsCount);
+        stored = storeCaptures(storageModule, files, storingFirst, storing, importedCount, skippedCount);
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        std::swap(importing, storing);
+        storingFirst = first;
+    }
+    storageModule.close();
+    if (!stored) {
+        std::cerr << "Storing failed." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "imported: " << importedCount << " files, skipped: " << skippedCount << " files" << std::endl;
+    std::cout << "elapsed: " << elapsed << " s, " << files.size() / elapsed << " files/s, "
+              << totalSize / elapsed / 1e6 << " MB/s" << std::endl;
+    return skippedCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
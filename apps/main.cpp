@@ -13,9 +13,12 @@
 #include <date/date.h>
 #include <chrono>
 #include <date/tz.h>
-#include <vibration_daq/StorageModule.hpp>
+#include <vibration_daq/CaptureSink.hpp>
+#include <vibration_daq/RecordingScheduler.hpp>
+#include <vibration_daq/CalibrationModule.hpp>
 #include "chrono"
 #include "thread"
+#include <future>
 #include "yaml-cpp/yaml.h"
 #include "date/date.h"
 
@@ -24,16 +27,47 @@ using namespace std::this_thread; // sleep_for, sleep_until
 using namespace std::chrono; // nanoseconds, system_clock, seconds
 
 static const int SPI_SPEED = 14000000;
+static const int DEFAULT_SPI_WORD_GAP = 40; // us
+static const auto TRIGGER_PULSE_WIDTH = 10us;
+static const int GPIO_WRITE_ATTEMPTS = 3;
+// delay of the next recovery after a failed one, doubled up to the maximum
+static const auto RECOVERY_BACKOFF_MIN = 10s;
+static const auto RECOVERY_BACKOFF_MAX = 30min;
 gpio_t *gpioTrigger;
 gpio_t *gpioStatusLed;
+unsigned long gpioWriteErrors = 0;
 
+bool externalTriggerActivated = false;
+bool verifySensorConfig = false;
+int spiWordGap = DEFAULT_SPI_WORD_GAP;
+std::vector<VibrationSensorConfig> vibrationSensorConfigs;
 std::vector<VibrationSensorModule> vibrationSensorModules;
 ConfigModule configModule;
-StorageModule storageModule;
+std::unique_ptr<CaptureSink> captureSink;
+RecordingScheduler recordingScheduler;
+CalibrationModule calibrationModule;
 
-bool setupVibrationSensorModules(const bool &externalTriggerActivated);
+struct RecoveryState {
+    int failedRecoveriesCount = 0; // since the last successful recovery
+    steady_clock::time_point nextRecoveryTime;
+};
+std::vector<RecoveryState> recoveryStates;
 
-system_clock::time_point triggerVibrationSensors(const bool &externalTrigger);
+bool setupVibrationSensorModules();
+
+bool setupVibrationSensorModule(VibrationSensorModule &vibrationSensorModule,
+                                const VibrationSensorConfig &vibrationSensorConfig);
+
+/**
+ * Resets and configures a faulted sensor. After a failed recovery, the sensor is skipped until its backoff
+ * elapsed, so a dead sensor doesn't stall the rounds of the others.
+ */
+bool recoverVibrationSensorModule(int sensor);
+
+bool triggerVibrationSensors(const std::vector<const ScheduleEntry *> &round,
+                             std::vector<HostTimestamp> &triggerTimes);
+
+bool writeGpio(gpio_t *gpio, bool value);
 
 int main(int argc, char *argv[]) {
     loguru::g_preamble_uptime = false;
@@ -54,7 +88,6 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    bool externalTriggerActivated = false;
     int externalTriggerPin = -1;
     if (!configModule.readExternalTriggerConfig(externalTriggerActivated, externalTriggerPin)) {
         LOG_S(ERROR) << "Could not retrieve externalTrigger config.";
@@ -83,7 +116,7 @@ int main(int argc, char *argv[]) {
     }
 
 
-    if (!setupVibrationSensorModules(externalTriggerActivated)) {
+    if (!setupVibrationSensorModules()) {
         return EXIT_FAILURE;
     }
 
@@ -92,8 +125,19 @@ int main(int argc, char *argv[]) {
         LOG_S(ERROR) << "Could not retrieve storage_directory from config.";
         return EXIT_FAILURE;
     }
-    if (!storageModule.setup({storageDirectoryPath})) {
-        LOG_S(ERROR) << "Could not setup StorageModule.";
+    StorageConfig storageConfig;
+    if (!configModule.readStorageConfig(storageConfig)) {
+        LOG_S(ERROR) << "Could not retrieve storage config.";
+        return EXIT_FAILURE;
+    }
+    SinkConfig sinkConfig;
+    if (!configModule.readSinkConfig(storageConfig, sinkConfig)) {
+        LOG_S(ERROR) << "Could not retrieve storage sinks config.";
+        return EXIT_FAILURE;
+    }
+    captureSink = CaptureSink::create(sinkConfig, {storageDirectoryPath}, storageConfig);
+    if (!captureSink) {
+        LOG_S(ERROR) << "Could not setup storage sinks.";
         return EXIT_FAILURE;
     }
 
@@ -102,41 +146,72 @@ int main(int argc, char *argv[]) {
         recordingsCount = 1;
     }
 
-    if (statusLedActivated && gpio_write(gpioStatusLed, true) < 0) {
-        fprintf(stderr, "gpio_write(): %s", gpio_errmsg(gpioStatusLed));
-        exit(1);
+    if (statusLedActivated) {
+        writeGpio(gpioStatusLed, true);
     }
 
+    recoveryStates.assign(vibrationSensorModules.size(), RecoveryState());
+
     // run indefinitely if recordingsCount == 0
     for (int i = 0; i < recordingsCount || recordingsCount == 0; ++i) {
-        system_clock::time_point triggerTime = triggerVibrationSensors(externalTriggerActivated);
-
-        for (const auto &vibrationSensorModule : vibrationSensorModules) {
-            auto vibrationData = vibrationSensorModule.retrieveVibrationData();
+        for (auto round : recordingScheduler.planCycle(i)) {
+            for (int sensor = 0; sensor < vibrationSensorModules.size(); ++sensor) {
+                if (!round[sensor]) {
+                    continue;
+                }
+                // a faulted sensor is skipped until it's recovered, the others keep recording
+                if (vibrationSensorModules[sensor].hasFault() && !recoverVibrationSensorModule(sensor)) {
+                    round[sensor] = nullptr;
+                    continue;
+                }
+                if (!vibrationSensorModules[sensor].activateMode(*round[sensor])) {
+                    LOG_S(ERROR) << vibrationSensorModules[sensor].getSensorName() << ": Could not activate "
+                                 << Enum::toString(round[sensor]->recordingMode) << " mode.";
+                }
+            }
 
-            if (statusLedActivated && gpio_write(gpioStatusLed, false) < 0) {
-                fprintf(stderr, "gpio_write(): %s", gpio_errmsg(gpioStatusLed));
-                exit(1);
+            std::vector<HostTimestamp> triggerTimes;
+            if (!triggerVibrationSensors(round, triggerTimes)) {
+                LOG_S(ERROR) << "Could not trigger vibration sensors, skipping recording.";
+                continue;
             }
 
-            bool storedVibrationData = storageModule.storeVibrationData(vibrationData,
-                                                                        vibrationSensorModule.getSensorName(),
-                                                                        triggerTime);
+            for (int sensor = 0; sensor < vibrationSensorModules.size(); ++sensor) {
+                if (!round[sensor]) {
+                    continue;
+                }
+                const auto &vibrationSensorModule = vibrationSensorModules[sensor];
+                auto vibrationData = vibrationSensorModule.retrieveVibrationData();
 
-            if (statusLedActivated && gpio_write(gpioStatusLed, true) < 0) {
-                fprintf(stderr, "gpio_write(): %s", gpio_errmsg(gpioStatusLed));
-                exit(1);
-            }
+                if (vibrationSensorModule.hasFault()) {
+                    LOG_S(ERROR) << vibrationSensorModule.getSensorName() << ": Discarding vibration data, "
+                                 << vibrationSensorModule.getFaultCounters();
+                    continue;
+                }
 
-            LOG_IF_F(ERROR, !storedVibrationData, "Could not store vibration data.");
-        }
+                if (statusLedActivated) {
+                    writeGpio(gpioStatusLed, false);
+                }
+
+                bool storedVibrationData = captureSink->storeVibrationData(vibrationData,
+                                                                           vibrationSensorModule.getSensorName(),
+                                                                           triggerTimes[sensor]);
 
+                if (statusLedActivated) {
+                    writeGpio(gpioStatusLed, true);
+                }
 
+                LOG_IF_F(ERROR, !storedVibrationData, "Could not store vibration data.");
+            }
+        }
     }
 
     for (auto &vibrationSensorModule : vibrationSensorModules) {
+        LOG_S(INFO) << vibrationSensorModule.getSensorName() << ": " << vibrationSensorModule.getFaultCounters();
         vibrationSensorModule.close();
     }
+    LOG_S(INFO) << "gpio_write_errors: " << gpioWriteErrors;
+    captureSink->close();
 
     if (externalTriggerActivated) {
         gpio_close(gpioTrigger);
@@ -144,10 +219,7 @@ int main(int argc, char *argv[]) {
     }
 
     if (statusLedActivated) {
-        if (gpio_write(gpioStatusLed, false) < 0) {
-            fprintf(stderr, "gpio_write(): %s", gpio_errmsg(gpioStatusLed));
-            exit(1);
-        }
+        writeGpio(gpioStatusLed, false);
 
         gpio_close(gpioStatusLed);
         gpio_free(gpioStatusLed);
@@ -156,69 +228,168 @@ int main(int argc, char *argv[]) {
     return EXIT_SUCCESS;
 }
 
-system_clock::time_point triggerVibrationSensors(const bool &externalTrigger) {
-    system_clock::time_point triggerTime;
-    if (externalTrigger) {
-        if (gpio_write(gpioTrigger, true) < 0) {
-            fprintf(stderr, "gpio_write(): %s", gpio_errmsg(gpioTrigger));
-            exit(1);
+bool writeGpio(gpio_t *gpio, bool value) {
+    for (int attempt = 0; attempt < GPIO_WRITE_ATTEMPTS; ++attempt) {
+        if (gpio_write(gpio, value) >= 0) {
+            return true;
         }
+        gpioWriteErrors++;
+        LOG_F(WARNING, "gpio_write(): %s", gpio_errmsg(gpio));
+    }
+    return false;
+}
 
-        triggerTime = system_clock::now();
-        LOG_S(INFO) << "Triggered over PIN.";
-        sleep_for(5ms);
+bool triggerVibrationSensors(const std::vector<const ScheduleEntry *> &round,
+                             std::vector<HostTimestamp> &triggerTimes) {
+    triggerTimes.assign(vibrationSensorModules.size(), HostTimestamp());
 
-        if (gpio_write(gpioTrigger, false) < 0) {
-            fprintf(stderr, "gpio_write(): %s", gpio_errmsg(gpioTrigger));
-            exit(1);
+    if (externalTriggerActivated) {
+        if (!writeGpio(gpioTrigger, true)) {
+            return false;
         }
+
+        triggerTimes.assign(vibrationSensorModules.size(), getHostTimestamp());
+
+        // busy wait, sleeping would stretch the pulse by far more than the minimum width
+        const auto pulseEnd = steady_clock::now() + TRIGGER_PULSE_WIDTH;
+        while (steady_clock::now() < pulseEnd) {
+        }
+
+        // sensors are already triggered, the next trigger retries to reset the pin
+        writeGpio(gpioTrigger, false);
+        LOG_S(INFO) << "Triggered over PIN.";
     } else {
-        for (const auto &vibrationSensorModule : vibrationSensorModules) {
-            // start recording
-            LOG_S(INFO) << vibrationSensorModule.getSensorName() << " triggered over SPI.";
-            vibrationSensorModule.triggerRecording();
+        // only sensors which record in this round
+        std::vector<int> triggeredSensors;
+        for (int sensor = 0; sensor < vibrationSensorModules.size(); ++sensor) {
+            if (round[sensor]) {
+                triggeredSensors.push_back(sensor);
+            }
+        }
+        if (triggeredSensors.empty()) {
+            return true;
+        }
+
+        // prepare all sensors first, so that the triggers are sent back-to-back with one transfer each
+        for (int sensor : triggeredSensors) {
+            vibrationSensorModules[sensor].prepareTrigger();
+        }
+        for (int sensor : triggeredSensors) {
+            triggerTimes[sensor] = vibrationSensorModules[sensor].fireTrigger();
+        }
+
+        const int64_t triggerSkew = triggerTimes[triggeredSensors.back()].monotonicRawNs -
+                                    triggerTimes[triggeredSensors.front()].monotonicRawNs;
+        LOG_S(INFO) << triggeredSensors.size() << " sensors triggered over SPI, skew: " << triggerSkew << "ns";
+    }
+
+    return true;
+}
+
+bool recoverVibrationSensorModule(int sensor) {
+    auto &vibrationSensorModule = vibrationSensorModules[sensor];
+    auto &recoveryState = recoveryStates[sensor];
+    const auto now = steady_clock::now();
+    if (now < recoveryState.nextRecoveryTime) {
+        return false;
+    }
+
+    LOG_S(WARNING) << vibrationSensorModule.getSensorName() << ": Recovering, "
+                   << vibrationSensorModule.getFaultCounters();
+
+    if (vibrationSensorModule.reset()) {
+        // settings are loaded from flash on reset, usually only the config hash is read
+        vibrationSensorModule.configure(vibrationSensorConfigs[sensor], externalTriggerActivated,
+                                        verifySensorConfig);
+        if (!vibrationSensorModule.hasFault()) {
+            recoveryState = RecoveryState();
+            return true;
         }
-        triggerTime = system_clock::now();
     }
 
-    return triggerTime;
+    const int doublingsCount = std::min(recoveryState.failedRecoveriesCount, 16);
+    const auto backoff = std::min<steady_clock::duration>(RECOVERY_BACKOFF_MIN * (1 << doublingsCount),
+                                                          RECOVERY_BACKOFF_MAX);
+    recoveryState.failedRecoveriesCount++;
+    recoveryState.nextRecoveryTime = now + backoff;
+    LOG_S(ERROR) << vibrationSensorModule.getSensorName() << ": Recovery failed, skipping the sensor for "
+                 << duration_cast<seconds>(backoff).count() << " s.";
+    return false;
 }
 
-bool setupVibrationSensorModules(const bool &externalTriggerActivated) {
-    std::vector<VibrationSensorConfig> vibrationSensorConfigs;
+bool setupVibrationSensorModules() {
     if (!configModule.readVibrationSensors(vibrationSensorConfigs)) {
         LOG_S(ERROR) << "Could not retrieve vibration sensors from config.";
         return false;
     }
 
+    if (!configModule.readVerifySensorConfig(verifySensorConfig)) {
+        verifySensorConfig = false;
+    }
+
+    if (!configModule.readSpiWordGap(spiWordGap)) {
+        spiWordGap = DEFAULT_SPI_WORD_GAP;
+    }
+
+    AutonullConfig autonullConfig;
+    if (!configModule.readAutonullConfig(autonullConfig)) {
+        LOG_S(ERROR) << "Could not retrieve autonull config.";
+        return false;
+    }
+    if (!calibrationModule.setup(autonullConfig)) {
+        LOG_S(ERROR) << "Could not setup CalibrationModule.";
+        return false;
+    }
+
     for (const auto &vibrationSensorConfig : vibrationSensorConfigs) {
-        VibrationSensorModule vibrationSensorModule(vibrationSensorConfig.name);
-        if (!vibrationSensorModule.setup(vibrationSensorConfig.resetPin, vibrationSensorConfig.busyPin,
-                                         vibrationSensorConfig.spiPath,
-                                         SPI_SPEED)) {
-            LOG_S(ERROR) << "Could not setup vibration sensor: " << vibrationSensorConfig.name;
-            return false;
-        }
+        vibrationSensorModules.emplace_back(vibrationSensorConfig.name);
+    }
 
-        if (externalTriggerActivated) {
-            vibrationSensorModule.activateExternalTrigger();
-        }
+    // sensors are independent, set them up concurrently so it takes only as long as the slowest sensor
+    std::vector<std::future<bool>> setupResults;
+    for (int sensor = 0; sensor < vibrationSensorConfigs.size(); ++sensor) {
+        setupResults.push_back(std::async(std::launch::async, setupVibrationSensorModule,
+                                          std::ref(vibrationSensorModules[sensor]),
+                                          std::cref(vibrationSensorConfigs[sensor])));
+    }
 
-       vibrationSensorModule.triggerAutonull();
-//        vibrationSensorModule.restoreFactorySettings();
+    bool setupSuccessful = true;
+    for (auto &setupResult : setupResults) {
+        setupSuccessful &= setupResult.get();
+    }
+    if (!setupSuccessful) {
+        return false;
+    }
 
-        switch (vibrationSensorConfig.recordingMode) {
-            case RecordingMode::MFFT:
-                vibrationSensorModule.activateMode(vibrationSensorConfig.mfftConfig);
-                break;
-            case RecordingMode::MTC:
-                vibrationSensorModule.activateMode(vibrationSensorConfig.mtcConfig);
-                break;
-        }
+    for (const auto &vibrationSensorConfig : vibrationSensorConfigs) {
+        recordingScheduler.addSchedule(vibrationSensorConfig.schedule);
+    }
+
+    return true;
+}
+
+bool setupVibrationSensorModule(VibrationSensorModule &vibrationSensorModule,
+                                const VibrationSensorConfig &vibrationSensorConfig) {
+    vibrationSensorModule.setWordGap(std::chrono::microseconds(spiWordGap));
+    if (!vibrationSensorModule.setup(vibrationSensorConfig.resetPin, vibrationSensorConfig.busyPin,
+                                     vibrationSensorConfig.spiPath,
+                                     SPI_SPEED)) {
+        LOG_S(ERROR) << "Could not setup vibration sensor: " << vibrationSensorConfig.name;
+        return false;
+    }
 
-        vibrationSensorModules.push_back(vibrationSensorModule);
-        LOG_S(INFO) << vibrationSensorModule.getSensorName() << " setup done";
+    vibrationSensorModule.setAxes(vibrationSensorConfig.axes);
+
+    calibrationModule.calibrate(vibrationSensorModule);
+//    vibrationSensorModule.restoreFactorySettings();
+
+    vibrationSensorModule.configure(vibrationSensorConfig, externalTriggerActivated, verifySensorConfig);
+
+    if (!vibrationSensorModule.activateMode(vibrationSensorConfig.schedule.front())) {
+        LOG_S(ERROR) << "Could not activate mode of vibration sensor: " << vibrationSensorConfig.name;
+        return false;
     }
 
+    LOG_S(INFO) << vibrationSensorModule.getSensorName() << " setup done";
     return true;
 }
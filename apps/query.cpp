@@ -0,0 +1,110 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <date/date.h>
+#include <vibration_daq/CaptureIndex.hpp>
+#include "loguru/loguru.hpp"
+
+using namespace vibration_daq;
+
+static void printUsage() {
+    std::cerr << "Usage: vibration_daq_query <storage_directory> [--sensor <name>] [--mode <MFFT|AFFT|MTC>]"
+                 " [--from <UTC time>] [--to <UTC time>] [--rebuild]" << std::endl
+              << "UTC time e.g. 2020-06-25T07:34:45 or 2020-06-25T07:34:45.609" << std::endl;
+}
+
+static bool parseTime(const std::string &timeString, int64_t &realtimeNs) {
+    std::istringstream timeStream(timeString);
+    date::sys_time<std::chrono::nanoseconds> timePoint;
+    timeStream >> date::parse("%FT%T", timePoint);
+    if (timeStream.fail()) {
+        return false;
+    }
+    realtimeNs = timePoint.time_since_epoch().count();
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+    loguru::g_preamble_uptime = false;
+    loguru::g_preamble_thread = false;
+
+    if (argc < 2) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    const fs::path storageDirectory = argv[1];
+    std::string sensorName;
+    std::optional<RecordingMode> recordingMode;
+    int64_t fromRealtimeNs = std::numeric_limits<int64_t>::min();
+    int64_t toRealtimeNs = std::numeric_limits<int64_t>::max();
+    bool rebuild = false;
+
+    for (int i = 2; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--rebuild") {
+            rebuild = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+        const std::string value = argv[++i];
+
+        bool validValue = true;
+        if (option == "--sensor") {
+            sensorName = value;
+        } else if (option == "--mode") {
+            RecordingMode mode{};
+            validValue = Enum::convert(value, mode);
+            if (validValue) {
+                recordingMode = mode;
+            }
+        } else if (option == "--from") {
+            validValue = parseTime(value, fromRealtimeNs);
+        } else if (option == "--to") {
+            validValue = parseTime(value, toRealtimeNs);
+        } else {
+            validValue = false;
+        }
+        if (!validValue) {
+            std::cerr << "Invalid option: " << option << " " << value << std::endl;
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!fs::is_directory(storageDirectory)) {
+        std::cerr << "Storage directory does not exist: " << storageDirectory << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    CaptureIndex captureIndex;
+    if (!captureIndex.setup(storageDirectory) || (rebuild && !captureIndex.rebuild())) {
+        std::cerr << "Could not open capture index." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<CaptureLocation> captureLocations;
+    if (!captureIndex.query(sensorName, fromRealtimeNs, toRealtimeNs, recordingMode, captureLocations)) {
+        std::cerr << "Could not query capture index." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    for (const auto &captureLocation : captureLocations) {
+        const date::sys_time<std::chrono::nanoseconds> triggerTime{
+                std::chrono::nanoseconds(captureLocation.triggerRealtimeNs)};
+        std::cout << date::format("%FT%TZ", triggerTime) << " " << captureLocation.sensorName << " "
+                  << Enum::toString(captureLocation.recordingMode) << " " << captureLocation.fileName << " "
+                  << captureLocation.offset << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
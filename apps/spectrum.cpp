@@ -0,0 +1,117 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <iostream>
+#include <vibration_daq/CSVImporter.hpp>
+#include <vibration_daq/CaptureReader.hpp>
+#include <vibration_daq/SegmentArchive.hpp>
+#include <vibration_daq/SpectrumAnalyzer.hpp>
+#include "loguru/loguru.hpp"
+
+using namespace vibration_daq;
+
+static void printUsage() {
+    std::cerr << "Usage: vibration_daq_spectrum <csv_file|segment> [--capture <index>]"
+                 " [--window <RECTANGULAR|HANNING|FLAT_TOP|BLACKMAN_HARRIS>] [--segment-length <samples>]"
+                 " [--overlap <0-1>] [--scaling <AMPLITUDE|PSD>]" << std::endl
+              << "Prints the spectrum of an MTC capture as CSV, --capture selects the capture of a segment."
+              << std::endl;
+}
+
+static bool readCapture(const fs::path &path, size_t captureIndex, CaptureRecord &captureRecord) {
+    if (path.extension() != SegmentArchive::SEGMENT_EXTENSION) {
+        return captureIndex == 0 && CSVImporter::importFile(path, captureRecord);
+    }
+    CaptureReader captureReader;
+    return captureReader.open(path) && captureIndex < captureReader.getCapturesCount() &&
+           captureReader.readCapture(captureIndex, captureRecord);
+}
+
+int main(int argc, char *argv[]) {
+    loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+    loguru::g_preamble_uptime = false;
+    loguru::g_preamble_thread = false;
+
+    if (argc < 2) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    const fs::path path = argv[1];
+    size_t captureIndex = 0;
+    SpectrumConfig spectrumConfig;
+
+    for (int i = 2; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (i + 1 >= argc) {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+        const std::string value = argv[++i];
+
+        bool validValue = true;
+        try {
+            if (option == "--capture") {
+                captureIndex = std::stoul(value);
+            } else if (option == "--window") {
+                validValue = Enum::convert(value, spectrumConfig.windowSetting);
+            } else if (option == "--segment-length") {
+                spectrumConfig.segmentLength = std::stoi(value);
+            } else if (option == "--overlap") {
+                spectrumConfig.overlap = std::stof(value);
+            } else if (option == "--scaling") {
+                validValue = Enum::convert(value, spectrumConfig.scaling);
+            } else {
+                validValue = false;
+            }
+        } catch (const std::exception &) {
+            validValue = false;
+        }
+        if (!validValue || spectrumConfig.segmentLength < 0) {
+            std::cerr << "Invalid option: " << option << " " << value << std::endl;
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    CaptureRecord captureRecord;
+    if (!readCapture(path, captureIndex, captureRecord)) {
+        std::cerr << "Could not read capture " << captureIndex << " of " << path << std::endl;
+        return EXIT_FAILURE;
+    }
+    const VibrationData &vibrationData = captureRecord.vibrationData;
+    if (vibrationData.recordingMode != RecordingMode::MTC) {
+        std::cerr << "Not an MTC capture: " << Enum::toString(vibrationData.recordingMode) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<float> frequencies;
+    std::vector<std::vector<float>> spectra;
+    for (const auto &axis : vibrationData.axes) {
+        spectra.emplace_back();
+        if (!SpectrumAnalyzer::computeSpectrum(vibrationData.getAxisData(axis), vibrationData.stepSize,
+                                               spectrumConfig, frequencies, spectra.back())) {
+            std::cerr << "Invalid spectrum options for " << vibrationData.stepAxis.size() << " samples: the segment"
+                         " length must be a power of two not above the samples, the overlap in [0, 1)." << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    const std::string unit = spectrumConfig.scaling == SpectrumScaling::PSD ? " [g^2/Hz]" : " [g]";
+    std::cout << "Frequency [Hz]";
+    for (const auto &axis : vibrationData.axes) {
+        std::cout << "," << Enum::toString(axis) << unit;
+    }
+    std::cout << '\n';
+    for (size_t k = 0; k < frequencies.size(); ++k) {
+        std::cout << frequencies[k];
+        for (const auto &spectrum : spectra) {
+            std::cout << "," << spectrum[k];
+        }
+        std::cout << '\n';
+    }
+    std::cout.flush();
+    return std::cout.good() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
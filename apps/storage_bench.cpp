@@ -0,0 +1,228 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#include <vibration_daq/StorageModule.hpp>
+#include <vibration_daq/utils/SampleConversion.hpp>
+#include <vibration_daq/utils/TimeUtils.hpp>
+#include "loguru/loguru.hpp"
+
+using namespace vibration_daq;
+
+static const int SAMPLES_COUNT = 4096;
+
+static void printUsage() {
+    std::cerr << "Usage: vibration_daq_storage_bench <directory> [--captures <count>] [--sensors <count>]"
+                 " [--format <CSV|SEGMENT>] [--codec <RAW|DELTA_PACK>] [--sync <CAPTURE|COUNT|INTERVAL|NEVER>]"
+                 " [--sync-count <count>] [--sync-interval <s>] [--write-block-kb <KiB>] [--direct-io]"
+                 " [--no-preallocate]" << std::endl
+              << "Stores synthetic MTC captures in a temporary directory below <directory> and reports the"
+                 " throughput and the write amplification." << std::endl;
+}
+
+/**
+ * @return sectors written to the block device of the path, from /sys/dev/block/<major>:<minor>/stat
+ */
+static bool readSectorsWritten(const fs::path &path, uint64_t &sectorsWritten) {
+    struct stat pathStat{};
+    if (::stat(path.c_str(), &pathStat) != 0) {
+        return false;
+    }
+    std::ifstream statFile("/sys/dev/block/" + std::to_string(major(pathStat.st_dev)) + ":" +
+                           std::to_string(minor(pathStat.st_dev)) + "/stat");
+    uint64_t value;
+    for (int field = 0; field < 7 && statFile >> value; ++field) {
+        sectorsWritten = value; // field 7: sectors written
+    }
+    return statFile.good();
+}
+
+/**
+ * @param name field of /proc/self/io, e.g. syscw or write_bytes
+ */
+static uint64_t readProcessIO(const std::string &name) {
+    std::ifstream ioFile("/proc/self/io");
+    std::string line;
+    while (std::getline(ioFile, line)) {
+        if (line.compare(0, name.size() + 1, name + ":") == 0) {
+            return std::stoull(line.substr(name.size() + 1));
+        }
+    }
+    return 0;
+}
+
+static uint64_t getDirectorySize(const fs::path &directory) {
+    uint64_t size = 0;
+    for (const auto &entry : fs::recursive_directory_iterator(directory)) {
+        if (entry.is_regular_file()) {
+            size += entry.file_size();
+        }
+    }
+    return size;
+}
+
+/**
+ * Sine with harmonics and noise, similar to the example captures.
+ */
+static VibrationData createCapture(std::mt19937 &generator) {
+    std::normal_distribution<float> noise(0, 60);
+    VibrationData vibrationData;
+    vibrationData.recordingMode = RecordingMode::MTC;
+    vibrationData.stepSize = 1.0f / 220000 * 64;
+    for (int i = 0; i < SAMPLES_COUNT; ++i) {
+        vibrationData.stepAxis.push_back(vibrationData.stepSize * i);
+    }
+    for (const auto &axis : ALL_AXES) {
+        std::vector<int16_t> &samples = vibrationData.getAxisRawData(axis);
+        for (int i = 0; i < SAMPLES_COUNT; ++i) {
+            const float phase = 2 * M_PI * i / 64.0f + static_cast<int>(axis);
+            samples.push_back(static_cast<int16_t>(1000 * std::sin(phase) + 200 * std::sin(3 * phase) +
+                                                   noise(generator)));
+        }
+        vibrationData.getAxisData(axis) = convertVibrationValues(RecordingMode::MTC, samples, 1);
+    }
+    return vibrationData;
+}
+
+int main(int argc, char *argv[]) {
+    loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+    loguru::g_preamble_uptime = false;
+    loguru::g_preamble_thread = false;
+
+    if (argc < 2) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    const fs::path directory = argv[1];
+    int capturesCount = 1000;
+    int sensorsCount = 1;
+    StorageConfig storageConfig;
+
+    for (int i = 2; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--direct-io") {
+            storageConfig.directIO = true;
+            continue;
+        }
+        if (option == "--no-preallocate") {
+            storageConfig.preallocate = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+        const std::string value = argv[++i];
+
+        bool validValue = true;
+        try {
+            if (option == "--captures") {
+                capturesCount = std::stoi(value);
+            } else if (option == "--sensors") {
+                sensorsCount = std::stoi(value);
+            } else if (option == "--format") {
+                validValue = Enum::convert(value, storageConfig.format);
+            } else if (option == "--codec") {
+                validValue = Enum::convert(value, storageConfig.sampleCodec);
+            } else if (option == "--sync") {
+                validValue = Enum::convert(value, storageConfig.syncMode);
+            } else if (option == "--sync-count") {
+                storageConfig.syncCount = std::stoi(value);
+            } else if (option == "--sync-interval") {
+                storageConfig.syncInterval = std::stoi(value);
+            } else if (option == "--write-block-kb") {
+                storageConfig.writeBlockSize = std::stoul(value) * 1024;
+                validValue = storageConfig.writeBlockSize > 0 && storageConfig.writeBlockSize % 4096 == 0;
+            } else {
+                validValue = false;
+            }
+        } catch (const std::exception &) {
+            validValue = false;
+        }
+        if (!validValue || capturesCount <= 0 || sensorsCount <= 0) {
+            std::cerr << "Invalid option: " << option << " " << value << std::endl;
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    const fs::path storageDirectory = directory / ("storage_bench_" + std::to_string(::getpid()));
+    std::error_code errorCode;
+    if (!fs::create_directory(storageDirectory, errorCode)) {
+        std::cerr << "Could not create " << storageDirectory << ": " << errorCode.message() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 generator(42);
+    const VibrationData vibrationData = createCapture(generator);
+
+    uint64_t sectorsWrittenBefore = 0, sectorsWrittenAfter = 0;
+    const bool hasDeviceStats = readSectorsWritten(storageDirectory, sectorsWrittenBefore);
+    const uint64_t syscallsBefore = readProcessIO("syscw");
+    const auto start = std::chrono::steady_clock::now();
+
+    bool stored = true;
+    {
+        StorageModule storageModule;
+        // the StorageModule concatenates the directory and the file name
+        stored = storageModule.setup(storageDirectory.string() + "/", storageConfig);
+        HostTimestamp triggerTimestamp = getHostTimestamp();
+        for (int i = 0; i < capturesCount && stored; ++i) {
+            triggerTimestamp.realtimeNs += 1000000000;
+            for (int sensor = 0; sensor < sensorsCount && stored; ++sensor) {
+                stored = storageModule.storeVibrationData(vibrationData, "sensor" + std::to_string(sensor + 1),
+                                                          triggerTimestamp);
+            }
+        }
+        storageModule.close();
+    }
+
+    // the written data reaches the device before it is counted
+    const int directoryFd = ::open(storageDirectory.c_str(), O_RDONLY | O_DIRECTORY);
+    ::syncfs(directoryFd);
+    ::close(directoryFd);
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const uint64_t syscalls = readProcessIO("syscw") - syscallsBefore;
+    const bool hasDeviceStatsAfter = hasDeviceStats && readSectorsWritten(storageDirectory, sectorsWrittenAfter);
+
+    const uint64_t storedBytes = getDirectorySize(storageDirectory);
+    const uint64_t samplesBytes = static_cast<uint64_t>(capturesCount) * sensorsCount * ALL_AXES.size() *
+                                  SAMPLES_COUNT * sizeof(int16_t);
+    fs::remove_all(storageDirectory, errorCode);
+    if (!stored) {
+        std::cerr << "Storing failed." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const int totalCaptures = capturesCount * sensorsCount;
+    std::cout << "format " << Enum::toString(storageConfig.format) << ", codec "
+              << Enum::toString(storageConfig.sampleCodec) << ", sync " << Enum::toString(storageConfig.syncMode)
+              << ", write block " << storageConfig.writeBlockSize / 1024 << " KiB"
+              << (storageConfig.directIO ? ", O_DIRECT" : "") << (storageConfig.preallocate ? ", preallocated" : "")
+              << std::endl;
+    std::cout << "captures: " << totalCaptures << " in " << elapsed << " s, " << totalCaptures / elapsed
+              << " captures/s" << std::endl;
+    std::cout << "samples: " << samplesBytes << " bytes, stored: " << storedBytes << " bytes" << std::endl;
+    std::cout << "write syscalls: " << syscalls << ", per capture: " << static_cast<double>(syscalls) / totalCaptures
+              << std::endl;
+    if (hasDeviceStatsAfter) {
+        const uint64_t deviceBytes = (sectorsWrittenAfter - sectorsWrittenBefore) * 512;
+        // includes writes of other processes to the same device
+        std::cout << "device writes: " << deviceBytes << " bytes, write amplification: "
+                  << static_cast<double>(deviceBytes) / storedBytes << std::endl;
+    } else {
+        std::cout << "device writes: not available" << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
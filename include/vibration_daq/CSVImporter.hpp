@@ -0,0 +1,45 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <filesystem>
+#include "entities/CaptureRecord.hpp"
+
+namespace fs = std::filesystem;
+
+namespace vibration_daq {
+    /**
+     * The CSVImporter reads CSV files of the StorageModule back into captures, e.g. to move them to segments.
+     *
+     * Sensor name, recording mode and trigger time are recovered from the file name, the other metadata from the
+     * metadata file if there is one. Without it, the decimation factor is derived from the step size. The raw
+     * samples are recovered by inverting the conversion of the samples; for FFT captures without metadata file the
+     * smallest spectral average count is searched, which maps all bins to raw values.
+     */
+    class CSVImporter {
+    private:
+        static constexpr int MAX_SPECTRAL_AVG_COUNT = 255;
+        static constexpr size_t SEARCH_SAMPLES_COUNT = 64; // non-zero FFT bins to search the spectral average count
+        // LSB, the CSV values have 6 significant digits: a relative error of 5e-6, up to 0.17 LSB for MTC samples
+        // and 0.015 LSB for the log-encoded FFT samples
+        static constexpr double MAX_MTC_ERROR = 0.25;
+        static constexpr double MAX_FFT_ERROR = 0.03;
+
+        static bool recoverMTCSamples(VibrationData &vibrationData);
+
+        /**
+         * @param spectralAvgCountKnown if false, metadata.spectralAvgCount is searched
+         */
+        static bool recoverFFTSamples(VibrationData &vibrationData, bool spectralAvgCountKnown);
+
+    public:
+        /**
+         * Reads the CSV file and its metadata file.
+         * @return false if the file name isn't one of the StorageModule or the samples can't be recovered
+         */
+        static bool importFile(const fs::path &dataFilePath, CaptureRecord &captureRecord);
+    };
+}
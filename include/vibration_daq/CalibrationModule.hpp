@@ -0,0 +1,49 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+#include "yaml-cpp/yaml.h"
+#include "VibrationSensorModule.hpp"
+#include "entities/AutonullConfig.hpp"
+#include "entities/Calibration.hpp"
+
+namespace fs = std::filesystem;
+
+namespace vibration_daq {
+    /**
+     * The CalibrationModule decides when a sensor needs an autonull and persists the calibrations on the host,
+     * keyed by the SERIAL_ID of the sensor.
+     */
+    class CalibrationModule {
+    private:
+        AutonullConfig autonullConfig;
+        YAML::Node calibrationsNode;
+        mutable std::mutex calibrationsMutex; // sensors are calibrated concurrently
+
+        bool readCalibration(uint16_t serialId, Calibration &calibration) const;
+
+        bool storeCalibration(const Calibration &calibration);
+
+        static std::string getSerialIdKey(uint16_t serialId);
+
+    public:
+        /**
+         * Loads the persisted calibrations, if the calibration file exists. A calibration file which can't be
+         * parsed is logged and ignored, the autonull runs again then.
+         */
+        bool setup(const AutonullConfig &autonullConfig);
+
+        /**
+         * Runs the autonull according to the autonull mode. In AUTO mode, it's skipped if the sensor holds the
+         * calibration that was persisted for its SERIAL_ID and the drift (if checked) is below the threshold.
+         * Thread-safe, can be called for several sensors concurrently.
+         * @return true if the sensor has a valid calibration
+         */
+        bool calibrate(VibrationSensorModule &vibrationSensorModule);
+    };
+}
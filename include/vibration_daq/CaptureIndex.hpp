@@ -0,0 +1,144 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+#include "entities/CaptureLocation.hpp"
+
+namespace fs = std::filesystem;
+
+namespace vibration_daq {
+    /**
+     * The CaptureIndex keeps track of the stored captures, to find the captures of a time range without listing the
+     * storage directory. Per sensor, the index directory contains a file of fixed-size records sorted by trigger
+     * time (<sensor>.vidx), which is searched binary, and a table of fixed-size file name records (<sensor>.files)
+     * read by file id. CSV files are not added to the table, their name is derived from the record.
+     *
+     * Several processes may use the index, e.g. the acquisition and vibration_daq_query: writers take an exclusive
+     * flock on the index directory, queries a shared one. A process reloads its cached state of a sensor when the
+     * index files were changed by another process.
+     */
+    class CaptureIndex {
+    private:
+        static constexpr uint64_t MAGIC = 0x3158494351414456; // "VDAQCIX1"
+        static constexpr uint32_t VERSION = 2;
+        static constexpr uint32_t CSV_FILE_ID = UINT32_MAX; // name derived from sensor, mode and trigger time
+        static constexpr size_t FILE_NAME_SIZE = 256; // of a record of the files table, NUL padded
+
+        struct IndexFileHeader {
+            uint64_t magic;
+            uint32_t version;
+            uint32_t recordSize;
+        };
+
+        struct IndexRecord {
+            int64_t triggerRealtimeNs;
+            uint64_t offset;
+            uint32_t fileId; // record in the files table, or CSV_FILE_ID
+            uint8_t recordingMode;
+            uint8_t reserved[3];
+        };
+
+        struct FileState {
+            uint64_t inode = 0; // 0 if the file doesn't exist
+            uint64_t size = 0;
+            int64_t modificationTimeNs = 0; // an inode may be reused by a rebuild
+
+            bool operator==(const FileState &other) const {
+                return inode == other.inode && size == other.size && modificationTimeNs == other.modificationTimeNs;
+            }
+        };
+
+        struct SensorIndex {
+            FileState recordsFileState; // as last loaded or written by this process
+            FileState filesFileState;
+            uint64_t recordsCount = 0;
+            int64_t lastTriggerRealtimeNs = 0;
+            uint32_t filesCount = 0;
+            std::string lastFileName; // of the last record of the files table, captures are added file by file
+        };
+
+        fs::path storageDirectory;
+        fs::path indexDirectory;
+        std::map<std::string, SensorIndex> sensorIndices;
+
+        fs::path getRecordsPath(const std::string &sensorName) const;
+
+        fs::path getFilesPath(const std::string &sensorName) const;
+
+        static FileState getFileState(const fs::path &path);
+
+        bool loadSensorIndex(const std::string &sensorName, SensorIndex &sensorIndex) const;
+
+        /**
+         * Updates the file states of the sensor index after it was written.
+         */
+        void updateFileStates(const std::string &sensorName, SensorIndex &sensorIndex) const;
+
+        /**
+         * @return id of the file, added to the files table unless it is a CSV file or the last file of the table
+         */
+        std::optional<uint32_t> getFileId(SensorIndex &sensorIndex, const CaptureLocation &captureLocation);
+
+        static bool readFileName(int fd, uint32_t fileId, std::string &fileName);
+
+        static std::string getCSVFileName(const std::string &sensorName, RecordingMode recordingMode,
+                                          int64_t triggerRealtimeNs);
+
+        /**
+         * Writes all records of a sensor, sorted by trigger time.
+         */
+        bool writeRecords(const std::string &sensorName, std::vector<IndexRecord> &records) const;
+
+        /**
+         * rebuild() with the exclusive index lock held.
+         */
+        bool rebuildLocked();
+
+    public:
+        static constexpr const char *INDEX_DIRECTORY = "index";
+
+        /**
+         * Opens the index of the storage directory, it is rebuilt if it doesn't exist or is of an older version.
+         */
+        bool setup(const fs::path &storageDirectory);
+
+        /**
+         * Adds a stored capture. Captures are expected in order of their trigger time, older captures are
+         * sorted in by rewriting the sensor's index.
+         */
+        bool add(const CaptureLocation &captureLocation);
+
+        /**
+         * Finds the captures with from <= trigger time < to, in O(log n) per sensor.
+         * @param sensorName empty for all sensors
+         * @param recordingMode only captures of this mode if set
+         * Captures of files which don't exist anymore are skipped.
+         */
+        bool query(const std::string &sensorName, int64_t fromRealtimeNs, int64_t toRealtimeNs,
+                   const std::optional<RecordingMode> &recordingMode,
+                   std::vector<CaptureLocation> &captureLocations) const;
+
+        /**
+         * Builds the index from the CSV files (including the ones not yet renamed from their temporary name) and
+         * segments of the storage directory. Waits for the exclusive index lock, so it can run while the
+         * acquisition adds captures.
+         */
+        bool rebuild();
+
+        std::vector<std::string> getSensorNames() const;
+
+        /**
+         * Recovers sensor name, recording mode and trigger time from a CSV file name of the StorageModule, e.g.
+         * vibration_data_MTC_2020-06-25T07_34_45.609_sensor1.csv
+         */
+        static bool parseCSVFileName(const std::string &fileName, CaptureLocation &captureLocation);
+    };
+}
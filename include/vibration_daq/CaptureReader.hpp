@@ -0,0 +1,88 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <filesystem>
+#include <vector>
+#include "entities/CaptureRecord.hpp"
+#include "entities/CaptureView.hpp"
+#include "entities/SegmentIndexEntry.hpp"
+#include "utils/Span.hpp"
+
+namespace fs = std::filesystem;
+
+namespace vibration_daq {
+    /**
+     * The CaptureReader maps a segment into memory and reads its captures in place. Raw samples are returned as
+     * spans into the mapping without copying, compressed samples are decoded on access. Conversion to physical
+     * units is done only if requested by getAxisData().
+     *
+     * The views returned by readCapture() are valid until the reader is closed. Open segments are read up to the
+     * size they had when opened.
+     */
+    class CaptureReader {
+    private:
+        int fd = -1;
+        const uint8_t *mapping = nullptr;
+        size_t mappingSize = 0;
+        std::vector<SegmentIndexEntry> index;
+        bool verifyChecksums = true;
+
+        /**
+         * Checks the frame at offset.
+         * @return payload of the capture frame, nullptr if there is none
+         */
+        const uint8_t *getCapturePayload(uint64_t offset, uint32_t &length) const;
+
+    public:
+        CaptureReader() = default;
+
+        CaptureReader(const CaptureReader &) = delete;
+
+        CaptureReader &operator=(const CaptureReader &) = delete;
+
+        ~CaptureReader();
+
+        /**
+         * Maps the segment and reads its index.
+         * @param verifyChecksums if false, only magic, type and length of the capture frames are checked
+         */
+        bool open(const fs::path &segmentPath, bool verifyChecksums = true);
+
+        void close();
+
+        size_t getCapturesCount() const;
+
+        const std::vector<SegmentIndexEntry> &getIndex() const;
+
+        /**
+         * @param i position in the index, ordered as stored
+         */
+        bool readCapture(size_t i, CaptureView &captureView) const;
+
+        /**
+         * @param offset of the capture frame in the segment
+         */
+        bool readCaptureAt(uint64_t offset, CaptureView &captureView) const;
+
+        /**
+         * Reads a copy of the capture with converted samples.
+         */
+        bool readCapture(size_t i, CaptureRecord &captureRecord) const;
+
+        /**
+         * @param buffer used for compressed samples, raw samples are not copied
+         * @return samples of the axis, empty if the axis is not recorded or could not be decoded
+         */
+        static Span<const int16_t> getAxisRawData(const CaptureView &captureView, const Axis &axis,
+                                                  std::vector<int16_t> &buffer);
+
+        /**
+         * Converts the samples of the axis to physical units.
+         */
+        static bool getAxisData(const CaptureView &captureView, const Axis &axis, std::vector<float> &data);
+    };
+}
@@ -0,0 +1,54 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "entities/CaptureRecord.hpp"
+#include "entities/SegmentIndexEntry.hpp"
+#include "entities/SampleCodec.hpp"
+#include "entities/CaptureView.hpp"
+
+namespace vibration_daq {
+    /**
+     * The CaptureSerializer converts captures to and from the payload of a capture frame (see FrameFormat.hpp).
+     * The payload contains the trigger timestamp, the capture metadata and the raw samples of the recorded axes,
+     * the physical values are calculated on deserialization.
+     */
+    class CaptureSerializer {
+    public:
+        static constexpr uint16_t VERSION = 2; // 2: statistics of MTC captures, version 1 is still read
+
+        /**
+         * @param sampleCodec encoding of the raw samples, all codecs are decoded by deserialize()
+         */
+        static void serialize(const VibrationData &vibrationData, const std::string &sensorName,
+                              const HostTimestamp &triggerTimestamp, std::vector<uint8_t> &payload,
+                              SampleCodec sampleCodec = SampleCodec::RAW);
+
+        /**
+         * @return false if the payload is malformed or of an unknown version
+         */
+        static bool deserialize(const uint8_t *payload, size_t length, CaptureRecord &captureRecord);
+
+        /**
+         * Reads the capture without copying or decoding the samples, the view points into the payload.
+         */
+        static bool readView(const uint8_t *payload, size_t length, CaptureView &captureView);
+
+        /**
+         * Decodes the samples of an axis of a CaptureView.
+         */
+        static bool decodeSamples(const CaptureView::AxisSamples &axisSamples, uint32_t samplesCount,
+                                  std::vector<int16_t> &samples);
+
+        /**
+         * Reads only trigger timestamp and recording mode, the offset of indexEntry is not touched.
+         */
+        static bool readIndexEntry(const uint8_t *payload, size_t length, SegmentIndexEntry &indexEntry);
+    };
+}
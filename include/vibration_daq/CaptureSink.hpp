@@ -0,0 +1,97 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <vibration_daq/entities/VibrationData.hpp>
+#include <vibration_daq/entities/HostTimestamp.hpp>
+#include <vibration_daq/entities/SinkConfig.hpp>
+#include <vibration_daq/entities/StorageConfig.hpp>
+
+namespace fs = std::filesystem;
+
+namespace vibration_daq {
+    /**
+     * A CaptureSink takes the captures of the acquisition loop, see SinkType for the implementations. Sinks are
+     * created from a SinkConfig by create() and may be combined by a TeeSink.
+     */
+    class CaptureSink {
+    private:
+        /**
+         * @param directories of the StorageModule sinks created so far, a directory may only be used once
+         */
+        static std::unique_ptr<CaptureSink> create(const SinkConfig &sinkConfig, const fs::path &storageDirectory,
+                                                   const StorageConfig &storageConfig,
+                                                   std::set<fs::path> &directories);
+
+    public:
+        virtual ~CaptureSink() = default;
+
+        /**
+         * @param sensorName of the sensor the capture was recorded by
+         * @param triggerTimestamp instant the sensor was triggered
+         * @return true if success
+         */
+        virtual bool storeVibrationData(const VibrationData &vibrationData, const std::string &sensorName,
+                                        const HostTimestamp &triggerTimestamp) = 0;
+
+        /**
+         * Flushes the pending captures and releases the resources of the sink.
+         */
+        virtual void close() = 0;
+
+        /**
+         * Creates and sets up the sink and its children.
+         * @param storageDirectory of StorageModule sinks without their own directory
+         * @param storageConfig of StorageModule sinks, format and codec are set by the sink type
+         * @return nullptr if a sink could not be set up
+         */
+        static std::unique_ptr<CaptureSink> create(const SinkConfig &sinkConfig, const fs::path &storageDirectory,
+                                                   const StorageConfig &storageConfig);
+    };
+
+    /**
+     * Discards the captures, to measure the acquisition throughput without storage. The count and rate of the
+     * captures are logged on close.
+     */
+    class NullSink : public CaptureSink {
+    private:
+        uint64_t capturesCount = 0;
+        std::chrono::steady_clock::time_point firstCapture;
+        std::chrono::steady_clock::time_point lastCapture;
+
+    public:
+        bool storeVibrationData(const VibrationData &vibrationData, const std::string &sensorName,
+                                const HostTimestamp &triggerTimestamp) override;
+
+        void close() override;
+    };
+
+    /**
+     * Passes every capture to all of its sinks in order. A failing sink doesn't keep the capture from the others.
+     */
+    class TeeSink : public CaptureSink {
+    private:
+        std::vector<std::unique_ptr<CaptureSink>> sinks;
+
+    public:
+        explicit TeeSink(std::vector<std::unique_ptr<CaptureSink>> sinks);
+
+        /**
+         * @return true if all sinks stored the capture
+         */
+        bool storeVibrationData(const VibrationData &vibrationData, const std::string &sensorName,
+                                const HostTimestamp &triggerTimestamp) override;
+
+        void close() override;
+    };
+}
@@ -0,0 +1,48 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <deque>
+#include <utility>
+#include "entities/ClockMapping.hpp"
+
+namespace vibration_daq {
+    /**
+     * The ClockSync maps the TIME_STAMP of a sensor to the host clock. It fits a line through the latest pairs of
+     * sensor ticks and host CLOCK_MONOTONIC_RAW time, which were read together.
+     */
+    class ClockSync {
+    private:
+        static const int WINDOW_SIZE = 64;
+        static const int MIN_DRIFT_POINTS = 8;
+
+        std::deque<std::pair<int64_t, int64_t>> points; // unwrapped ticks, monotonicRawNs
+        uint32_t lastTicks = 0;
+        int64_t wrapOffset = 0;
+        double initialNsPerTick = 0;
+        ClockMapping mapping;
+
+        void fit();
+
+    public:
+        /**
+         * Adds a pair of sensor ticks and host time. The 32-bit ticks are unwrapped on overflow.
+         */
+        void addPoint(uint32_t ticks, int64_t monotonicRawNs);
+
+        /**
+         * Drops all points, needed when the sensor clock restarts (e.g. on reset).
+         */
+        void clear();
+
+        const ClockMapping &getMapping() const;
+
+        /**
+         * @return host CLOCK_MONOTONIC_RAW time of the given sensor ticks, 0 if the mapping is not valid yet
+         */
+        int64_t toMonotonicRawNs(uint32_t ticks) const;
+    };
+}
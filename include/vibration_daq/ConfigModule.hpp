@@ -10,6 +10,9 @@
 #include <vibration_daq/entities/RecordingMode.hpp>
 #include "yaml-cpp/yaml.h"
 #include "vibration_daq/entities/VibrationSensorConfig.hpp"
+#include "vibration_daq/entities/AutonullConfig.hpp"
+#include "vibration_daq/entities/StorageConfig.hpp"
+#include "vibration_daq/entities/SinkConfig.hpp"
 
 namespace vibration_daq {
     /**
@@ -24,12 +27,41 @@ namespace vibration_daq {
 
         static bool readVibrationSensor(const YAML::Node &node, VibrationSensorConfig &vibrationSensor);
 
+        /**
+         * @param node of the schedule entry
+         * @param sensorNode fallback for MFFT_config and MTC_config if the entry has none
+         */
+        static bool readScheduleEntry(const YAML::Node &node, const YAML::Node &sensorNode,
+                                      ScheduleEntry &scheduleEntry);
+
         static bool readRecordingConfig(const YAML::Node &node, RecordingConfig &recordingConfig);
 
         static bool readMFFTConfig(const YAML::Node &node, MFFTConfig &mfftConfig);
 
         static bool readMTCConfig(const YAML::Node &node, MTCConfig &mtcConfig);
 
+        static bool readRetentionConfig(const YAML::Node &node, RetentionConfig &retentionConfig);
+
+        static bool readSinkConfig(const YAML::Node &node, SinkConfig &sinkConfig);
+
+        static bool readFeatureConfig(const YAML::Node &node, FeatureConfig &featureConfig);
+
+        /**
+         * Reads window, segment length and overlap, the scaling is left unchanged.
+         */
+        static bool readSpectrumConfig(const YAML::Node &node, SpectrumConfig &spectrumConfig);
+
+        /**
+         * Assigns each recording config to one of the four sample rate slots of the sensor. Configs with the same
+         * decimation factor and spectral average count share a slot.
+         * @param recordingConfigs sampleRateSlot of these configs is set
+         * @param spectralAvgCounts per recording config, 0 if it doesn't matter (MTC)
+         * @return false if more than four slots are needed
+         */
+        static bool assignSampleRateSlots(const std::vector<RecordingConfig *> &recordingConfigs,
+                                          const std::vector<int> &spectralAvgCounts,
+                                          SampleRateSlots &sampleRateSlots);
+
     public:
         /**
          * Setups module, checks if it's yaml file.
@@ -53,11 +85,41 @@ namespace vibration_daq {
          */
         bool readStorageDirectoryPath(std::string &storageDirectory) const;
 
+        /**
+         * Optional, keeps the defaults of StorageConfig if not set.
+         * @return true if read-out is successful
+         */
+        bool readStorageConfig(StorageConfig &storageConfig) const;
+
+        /**
+         * Optional, a single sink of the storage format if not set. Several sinks are combined by a tee.
+         * @param storageConfig of which the format is used by default
+         * @return true if read-out is successful
+         */
+        bool readSinkConfig(const StorageConfig &storageConfig, SinkConfig &sinkConfig) const;
+
         /**
          * @return true if read-out is successful
          */
         bool readExternalTriggerConfig(bool &externalTriggerActivated, int &externalTriggerPin) const;
 
+        /**
+         * @return true if read-out is successful
+         */
+        bool readVerifySensorConfig(bool &verifySensorConfig) const;
+
+        /**
+         * @param spiWordGap in microseconds
+         * @return true if read-out is successful
+         */
+        bool readSpiWordGap(int &spiWordGap) const;
+
+        /**
+         * Optional, keeps the defaults of AutonullConfig if not set.
+         * @return true if read-out is successful
+         */
+        bool readAutonullConfig(AutonullConfig &autonullConfig) const;
+
         /**
          * @return true if read-out is successful
          */
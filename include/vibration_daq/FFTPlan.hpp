@@ -0,0 +1,60 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace vibration_daq {
+    /**
+     * FFT of real samples of a power-of-two size, planned once per size and shared by all threads.
+     *
+     * The size samples are packed into a complex sequence of half the size, transformed by a Stockham autosort FFT
+     * (radix-4 stages, one radix-2 stage for odd powers of two, no bit reversal) and split into the spectrum of
+     * the real samples. The complex values are kept as separate real and imaginary arrays, so the butterflies of a
+     * stage run on SIMD lanes of floats. All twiddle factors are computed in double when planned.
+     */
+    class FFTPlan {
+    private:
+        struct Stage {
+            size_t length; // of the sub-transforms of this stage
+            size_t stride; // distance of their elements
+            size_t twiddlesOffset; // cos and sin of w^p, w^2p, w^3p for p < length / 4, each length / 4 floats
+        };
+
+        size_t size;
+        std::vector<Stage> stages; // radix-4
+        bool radix2Stage; // last stage
+        std::vector<float> twiddles;
+        std::vector<float> splitTwiddles; // cos and sin of the real split, each size / 2 floats
+
+        explicit FFTPlan(size_t size);
+
+        void radix4Stage(const Stage &stage, const float *inReal, const float *inImaginary, float *outReal,
+                         float *outImaginary) const;
+
+        /**
+         * Returns the buffer which holds the transformed sequence.
+         */
+        int transformComplex(float *real[2], float *imaginary[2]) const;
+
+    public:
+        /**
+         * @param size of the real samples, power of two, at least 4
+         * @return nullptr if the size is not supported
+         */
+        static std::shared_ptr<const FFTPlan> get(size_t size);
+
+        size_t getSize() const;
+
+        /**
+         * @param samples size real samples
+         * @param real resized to the size / 2 + 1 bins, unscaled (bin 0 is the sum of the samples)
+         */
+        void transform(const float *samples, std::vector<float> &real, std::vector<float> &imaginary) const;
+    };
+}
@@ -0,0 +1,124 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <vibration_daq/CaptureSink.hpp>
+#include <vibration_daq/entities/AxisFeatures.hpp>
+#include <vibration_daq/entities/FeatureConfig.hpp>
+#include <vibration_daq/entities/StorageConfig.hpp>
+
+namespace vibration_daq {
+    /**
+     * The FeatureSink stores only the features of the captures: per axis a line of the time-domain statistics, the
+     * band energies and the highest spectral peaks (of the host spectrum for MTC captures). The lines are appended
+     * to features_<sensor>_<UTC start>.csv, which the retention manager never deletes. As the features file is the
+     * only record of most captures, it is synced by the sync mode of the storage config like the raw captures.
+     *
+     * A capture is passed on to the raw sink only if a feature crosses a threshold, deviates from the baseline of the
+     * sensor, recording mode and axis, or if it is the periodic sample. The baseline is the mean and variance of RMS,
+     * peak, crest factor and band energies, averaged over baselineCaptures captures and learned from the captures
+     * which were not kept for deviating. It is learned again after a restart.
+     */
+    class FeatureSink : public CaptureSink {
+    private:
+        /**
+         * Exponentially weighted mean and variance of a feature.
+         */
+        struct Baseline {
+            int count = 0;
+            double mean = 0;
+            double variance = 0;
+        };
+
+        struct FeaturesFile {
+            int fd = -1;
+            int pendingCaptures = 0; // since the last sync
+            std::chrono::steady_clock::time_point lastSync;
+        };
+
+        using BaselineKey = std::tuple<std::string, RecordingMode, Axis>; // sensor name, recording mode, axis
+
+        fs::path directory;
+        FeatureConfig featureConfig;
+        StorageConfig storageConfig; // sync mode of the features files
+        std::unique_ptr<CaptureSink> rawSink; // may be empty
+        std::map<std::string, FeaturesFile> featuresFiles; // per sensor name
+        std::map<std::string, int> capturesCounts; // per sensor name
+        std::map<BaselineKey, std::vector<Baseline>> baselines; // per monitored feature
+
+        /**
+         * @return RMS, peak, crest factor and band energies
+         */
+        static std::vector<float> getMonitoredFeatures(const AxisFeatures &axisFeatures);
+
+        /**
+         * @return reason to keep the capture raw, empty if none
+         */
+        std::string checkThresholds(RecordingMode recordingMode, const std::vector<AxisFeatures> &axesFeatures) const;
+
+        /**
+         * Updates the baselines unless a feature deviates.
+         * @return reason to keep the capture raw, empty if none
+         */
+        std::string checkBaselines(const std::string &sensorName, RecordingMode recordingMode,
+                                   const std::vector<Axis> &axes, const std::vector<AxisFeatures> &axesFeatures);
+
+        /**
+         * Opens the features file of the sensor, named by the trigger time of its first capture.
+         */
+        bool openFeaturesFile(const std::string &sensorName, const HostTimestamp &triggerTimestamp,
+                              FeaturesFile &featuresFile) const;
+
+        bool appendFeatures(const VibrationData &vibrationData, const std::string &sensorName,
+                            const HostTimestamp &triggerTimestamp, const std::vector<AxisFeatures> &axesFeatures,
+                            const std::string &rawReason);
+
+    public:
+        static constexpr const char *THRESHOLD_REASON = "THRESHOLD";
+        static constexpr const char *DEVIATION_REASON = "DEVIATION";
+        static constexpr const char *INTERVAL_REASON = "INTERVAL";
+
+        FeatureSink() = default;
+
+        FeatureSink(const FeatureSink &) = delete;
+
+        FeatureSink &operator=(const FeatureSink &) = delete;
+
+        ~FeatureSink() override;
+
+        /**
+         * @param directory of the features files
+         * @param storageConfig its sync mode is applied to the features files
+         * @param rawSink stores the captures which are kept raw, may be empty
+         */
+        bool setup(const fs::path &directory, const FeatureConfig &featureConfig, const StorageConfig &storageConfig,
+                   std::unique_ptr<CaptureSink> rawSink);
+
+        /**
+         * Computes and stores the features, passes the capture to the raw sink if it is kept raw.
+         */
+        bool storeVibrationData(const VibrationData &vibrationData, const std::string &sensorName,
+                                const HostTimestamp &triggerTimestamp) override;
+
+        /**
+         * Syncs and closes the features files, closes the raw sink.
+         */
+        void close() override;
+
+        /**
+         * Computes the features of the recorded axes, the spectral features of MTC captures from the spectrum computed
+         * by the SpectrumAnalyzer.
+         */
+        static std::vector<AxisFeatures> computeFeatures(const VibrationData &vibrationData,
+                                                         const FeatureConfig &featureConfig);
+    };
+}
@@ -0,0 +1,35 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include "entities/ScheduleEntry.hpp"
+
+namespace vibration_daq {
+    /**
+     * The RecordingScheduler decides which recordings of the sensors' schedules are due in a monitoring cycle.
+     */
+    class RecordingScheduler {
+    private:
+        std::vector<std::vector<ScheduleEntry>> schedules; // per sensor
+        std::vector<int> lastEntryIndices; // per sensor, entry that is currently active on the sensor
+
+    public:
+        /**
+         * Adds the schedule of the next sensor, sensors are referenced by the order they were added.
+         */
+        void addSchedule(const std::vector<ScheduleEntry> &schedule);
+
+        /**
+         * Plans the recordings of a cycle. They are split into rounds, in which every sensor records at most once,
+         * so all sensors of a round can be triggered together. A sensor starts with the entry that is still active
+         * from the previous cycle to save a mode switch.
+         * @param cycle counting from 0, an entry is due if cycle is a multiple of its interval
+         * @return per round and sensor the entry to record, nullptr if the sensor doesn't record in this round
+         */
+        std::vector<std::vector<const ScheduleEntry *>> planCycle(unsigned long cycle);
+    };
+}
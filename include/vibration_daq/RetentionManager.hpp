@@ -0,0 +1,138 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vibration_daq/entities/RetentionConfig.hpp>
+#include <vibration_daq/entities/CaptureRecord.hpp>
+
+namespace fs = std::filesystem;
+
+namespace vibration_daq {
+    /**
+     * The RetentionManager keeps the storage directory within the byte quota and removes captures older than the
+     * maximum age. It runs on its own thread: the storage directory is scanned once on start, afterwards the usage
+     * is tracked by notifyStored() and the files are kept ordered by the time of their newest capture.
+     *
+     * Aged out raw captures (CSV files and segments) are replaced according to the AgedOutMode. If the quota is
+     * exceeded, the oldest files are deleted first, downsampled files included; with AgedOutMode::FEATURES the
+     * features of raw captures are kept. Feature files are never deleted. Open segments are not touched.
+     */
+    class RetentionManager {
+    private:
+        static constexpr std::chrono::seconds CHECK_INTERVAL{60};
+
+        enum class FileTier {
+            RAW,
+            DOWNSAMPLED,
+            FEATURES
+        };
+
+        struct StoredFile {
+            uint64_t size = 0; // bytes, including the metadata file of a CSV file
+            int64_t newestRealtimeNs = 0; // trigger time of the newest capture
+            FileTier tier = FileTier::RAW;
+        };
+
+        using AgeKey = std::pair<int64_t, std::string>; // newest trigger time, file name
+
+        fs::path storageDirectory;
+        RetentionConfig retentionConfig;
+
+        std::thread worker;
+        std::mutex mutex; // guards the members below
+        std::condition_variable condition;
+        bool stopRequested = false;
+        bool enforceRequested = false;
+        std::map<std::string, StoredFile> storedFiles; // per file name
+        std::set<AgeKey> rawByAge;
+        std::set<AgeKey> removableByAge;
+        uint64_t usage = 0; // bytes
+
+        void run();
+
+        /**
+         * Tracks all files of the storage directory.
+         */
+        void scan();
+
+        void enforce();
+
+        /**
+         * @return the oldest file of the set which is older than beforeRealtimeNs, not open and not skipped
+         */
+        bool findOldest(const std::set<AgeKey> &byAge, int64_t beforeRealtimeNs, const std::set<std::string> &skipped,
+                        std::string &fileName);
+
+        /**
+         * Replaces the raw file according to agedOutMode and deletes it.
+         */
+        bool ageOut(const std::string &fileName, AgedOutMode agedOutMode);
+
+        bool removeFile(const std::string &fileName);
+
+        bool forEachCapture(const std::string &fileName, const std::function<bool(CaptureRecord &)> &callback) const;
+
+        bool appendFeatures(const CaptureRecord &captureRecord);
+
+        bool storeDownsampled(const CaptureRecord &captureRecord);
+
+        /**
+         * Adds the file or updates its size and time, mutex must be held.
+         */
+        void track(const std::string &fileName, uint64_t size, int64_t newestRealtimeNs, FileTier tier);
+
+        /**
+         * Mutex must be held.
+         */
+        void untrack(const std::string &fileName);
+
+        bool isStopRequested();
+
+    public:
+        // features files of the FeatureSink, with the spectral columns
+        static constexpr const char *FEATURES_PREFIX = "features_";
+        // features of aged out captures, with the reduced columns of appendFeatures
+        static constexpr const char *AGED_FEATURES_PREFIX = "aged_features_";
+        static constexpr const char *DOWNSAMPLED_PREFIX = "downsampled_";
+
+        RetentionManager() = default;
+
+        RetentionManager(const RetentionManager &) = delete;
+
+        RetentionManager &operator=(const RetentionManager &) = delete;
+
+        ~RetentionManager();
+
+        /**
+         * Starts the thread, nothing is started if neither quota nor maximum age are configured.
+         */
+        bool start(const fs::path &storageDirectory, const RetentionConfig &retentionConfig);
+
+        void stop();
+
+        /**
+         * Called after a capture was stored, wakes the thread if the quota is exceeded. Cheap enough for the
+         * acquisition thread.
+         * @param fileName of the CSV file or segment, without OPEN_EXTENSION
+         * @param size of the file, including the metadata file of a CSV file
+         */
+        void notifyStored(const std::string &fileName, uint64_t size, int64_t newestRealtimeNs);
+
+        /**
+         * Downsamples by factor: MTC samples are averaged, FFT bins keep their maximum to preserve peaks.
+         */
+        static VibrationData downsample(const VibrationData &vibrationData, int factor);
+    };
+}
@@ -0,0 +1,48 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vibration_daq {
+    /**
+     * Lossless compression of the int16 samples of an axis (SampleCodec::DELTA_PACK).
+     *
+     * The samples are split in blocks of BLOCK_SIZE, each block is encoded with the smallest of:
+     * - a predictor: none, the previous sample (delta) or the linear extrapolation of the two previous samples (suits
+     *   the correlated MTC samples). The residuals are zigzag encoded and bit-packed with the width of the largest.
+     * - a dictionary of the distinct samples of the block, the indices are bit-packed. FFT bins are log-encoded
+     *   magnitudes, which take only a few distinct values.
+     * A block starts with a header byte (mode << 6 | width). A predictor block continues with the packed residuals,
+     * a dictionary block with u8 size - 1, the sorted int16 dictionary and the packed indices. Values are packed
+     * LSB first and padded to a full byte. The predictor state continues across blocks.
+     */
+    class SampleCompression {
+    private:
+        static constexpr size_t BLOCK_SIZE = 128;
+        static constexpr unsigned MAX_WIDTH = 18; // of zigzag residuals of the linear extrapolation
+        static constexpr size_t MAX_DICTIONARY_SIZE = 64;
+
+        /**
+         * Unpacks count values of width bits, data must hold (count * width + 7) / 8 bytes.
+         */
+        static void unpackBlock(const uint8_t *data, size_t count, unsigned width, uint32_t *values);
+
+    public:
+        /**
+         * Appends the encoded samples to data.
+         */
+        static void encode(const std::vector<int16_t> &samples, std::vector<uint8_t> &data);
+
+        /**
+         * @param samplesCount number of encoded samples
+         * @return false if the data is malformed
+         */
+        static bool decode(const uint8_t *data, size_t size, size_t samplesCount, std::vector<int16_t> &samples);
+    };
+}
@@ -0,0 +1,144 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "entities/VibrationData.hpp"
+#include "entities/HostTimestamp.hpp"
+#include "entities/StorageConfig.hpp"
+#include "entities/SegmentIndexEntry.hpp"
+#include "entities/CaptureLocation.hpp"
+#include "entities/CaptureRecord.hpp"
+#include "utils/AlignedBuffer.hpp"
+
+namespace fs = std::filesystem;
+
+namespace vibration_daq {
+    /**
+     * The SegmentArchive appends the captures of one sensor to segment files. A segment starts with a header frame,
+     * followed by one frame per capture (see FrameFormat.hpp). The segment is written with the extension
+     * ".vseg.open"; when it is full, it gets an index frame and a trailer pointing to the index and is renamed to
+     * ".vseg". Open segments left behind by a crash are cut after the last valid frame and closed by
+     * recoverSegment().
+     *
+     * Frames are staged in a page aligned buffer and written in blocks of StorageConfig::writeBlockSize, so the
+     * storage sees few large aligned writes instead of one small write per capture. flush() writes the staged
+     * partial block, padded with zeros to full pages; the padding is overwritten by the following frames. Segments
+     * are preallocated to their maximum size and optionally written with O_DIRECT.
+     */
+    class SegmentArchive {
+    private:
+        static constexpr uint16_t VERSION = 1;
+        static constexpr uint64_t TRAILER_MAGIC = 0x3158444951414456; // "VDAQIDX1"
+        static constexpr size_t IO_ALIGNMENT = 4096; // of O_DIRECT buffers, offsets and sizes
+
+        struct SegmentTrailer {
+            uint64_t indexOffset;
+            uint64_t magic;
+        };
+
+        fs::path storageDirectory;
+        std::string sensorName;
+        StorageConfig storageConfig;
+
+        int fd = -1;
+        fs::path segmentPath; // of the open segment, without OPEN_EXTENSION
+        uint64_t segmentSize = 0;
+        int64_t segmentStartNs = 0;
+        std::vector<SegmentIndexEntry> index;
+        AlignedBuffer writeBuffer;
+        uint64_t bufferOffset = 0; // in the segment of the first staged byte, a multiple of IO_ALIGNMENT
+
+        bool openSegment(const HostTimestamp &timestamp);
+
+        /**
+         * Appends to the staged data, full blocks are written.
+         */
+        bool stage(const void *data, size_t size);
+
+        /**
+         * Closes the segment after a failed write, it is recovered on the next start.
+         */
+        void abandonSegment();
+
+        bool closeSegment();
+
+        /**
+         * Scans the frames of a segment.
+         * @param validSize end of the last valid frame
+         */
+        static bool scanSegment(int fd, uint64_t fileSize, std::vector<SegmentIndexEntry> &index,
+                                uint64_t &validSize);
+
+        /**
+         * Creates index frame and trailer for the end of the segment at offset.
+         */
+        static void createFooter(uint64_t offset, const std::vector<SegmentIndexEntry> &index,
+                                 std::vector<uint8_t> &footer);
+
+        static bool writeAll(int fd, const void *data, size_t size, uint64_t offset);
+
+    public:
+        static constexpr const char *SEGMENT_EXTENSION = ".vseg";
+        static constexpr const char *OPEN_EXTENSION = ".open";
+
+        SegmentArchive(const fs::path &storageDirectory, const std::string &sensorName,
+                       const StorageConfig &storageConfig);
+
+        SegmentArchive(const SegmentArchive &) = delete;
+
+        SegmentArchive &operator=(const SegmentArchive &) = delete;
+
+        ~SegmentArchive();
+
+        /**
+         * Appends the capture to the open segment, a new segment is started if the open one exceeds the size or
+         * duration limit.
+         * @param captureLocation set to the location of the appended capture
+         * @return true if success
+         */
+        bool append(const VibrationData &vibrationData, const HostTimestamp &triggerTimestamp,
+                    CaptureLocation &captureLocation);
+
+        /**
+         * Closes the open segment.
+         */
+        bool close();
+
+        /**
+         * Writes the staged frames to the open segment, without syncing.
+         */
+        bool flush();
+
+        /**
+         * @return size of the open segment in bytes, 0 if none is open
+         */
+        uint64_t getSegmentSize() const;
+
+        /**
+         * Cuts an open segment after the last valid frame, writes its index and renames it to ".vseg".
+         * @param openSegmentPath path with OPEN_EXTENSION
+         */
+        static bool recoverSegment(const fs::path &openSegmentPath);
+
+        /**
+         * Reads the sensor name from the header frame of a segment.
+         */
+        static bool readHeader(const fs::path &segmentPath, std::string &sensorName);
+
+        /**
+         * Reads the index of a closed segment from its footer, open segments are scanned.
+         */
+        static bool readIndex(const fs::path &segmentPath, std::vector<SegmentIndexEntry> &index);
+
+        /**
+         * Reads the capture frame at the offset of an index entry.
+         */
+        static bool readCapture(const fs::path &segmentPath, uint64_t offset, CaptureRecord &captureRecord);
+    };
+}
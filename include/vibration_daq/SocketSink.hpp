@@ -0,0 +1,68 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vibration_daq/CaptureSink.hpp>
+#include <vibration_daq/entities/SampleCodec.hpp>
+
+namespace vibration_daq {
+    /**
+     * The SocketSink streams the captures to the clients of a Unix domain stream socket. Every capture is sent as
+     * capture frame, as in segments (see FrameFormat.hpp), which CaptureSerializer::deserialize() reads. Clients
+     * are accepted while storing. The client sockets are non-blocking and a frame is sent to all clients at once
+     * with one deadline of SEND_TIMEOUT_MS, a client which hasn't taken the whole frame by then is disconnected.
+     * So slow clients delay a capture by at most SEND_TIMEOUT_MS and never stall the acquisition. Captures
+     * without clients are dropped.
+     */
+    class SocketSink : public CaptureSink {
+    private:
+        static constexpr int SEND_TIMEOUT_MS = 100;
+        static constexpr int LISTEN_BACKLOG = 4;
+
+        std::string socketPath;
+        SampleCodec sampleCodec = SampleCodec::RAW;
+        int listenFd = -1;
+        std::vector<int> clientFds;
+        std::vector<uint8_t> payload; // reused between captures
+        std::vector<uint8_t> frame;
+
+        void acceptClients();
+
+        /**
+         * Sends the frame to all clients until the deadline, the clients which failed or timed out are disconnected.
+         */
+        void sendFrame();
+
+    public:
+        SocketSink() = default;
+
+        SocketSink(const SocketSink &) = delete;
+
+        SocketSink &operator=(const SocketSink &) = delete;
+
+        ~SocketSink() override;
+
+        /**
+         * Creates the socket file, a stale socket file of a previous run is replaced.
+         * @param sampleCodec encoding of the samples in the frames
+         */
+        bool setup(const std::string &socketPath, SampleCodec sampleCodec);
+
+        /**
+         * @return false only if the sink is not set up, a disconnected client doesn't fail the capture
+         */
+        bool storeVibrationData(const VibrationData &vibrationData, const std::string &sensorName,
+                                const HostTimestamp &triggerTimestamp) override;
+
+        /**
+         * Disconnects the clients and removes the socket file.
+         */
+        void close() override;
+    };
+}
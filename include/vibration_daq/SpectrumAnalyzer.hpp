@@ -0,0 +1,40 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "entities/SpectrumConfig.hpp"
+#include "utils/Span.hpp"
+
+namespace vibration_daq {
+    /**
+     * Single-sided spectra of MTC samples computed on the host, so one MTC capture gives both the waveform and
+     * the spectrum. The samples are split into segments of segmentLength overlapping by overlap (Welch's method),
+     * each segment is windowed and transformed by an FFTPlan, the squared magnitudes are averaged over the
+     * segments and scaled:
+     * - AMPLITUDE: sqrt(mean |X[k]|^2) * 2 / sum(window), a sine of amplitude A gives a peak of A (exact for
+     *   FLAT_TOP, up to the scalloping loss of the other windows)
+     * - PSD: mean |X[k]|^2 * 2 / (sampleRate * sum(window^2)), its sum times the bin width is about the mean square
+     * DC and the Nyquist bin are not doubled.
+     */
+    class SpectrumAnalyzer {
+    public:
+        /**
+         * Periodic (DFT-even) window of the size, computed once per size and window.
+         */
+        static std::shared_ptr<const std::vector<float>> getWindow(size_t size, WindowSetting windowSetting);
+
+        /**
+         * @param stepSize time between the samples [s]
+         * @param frequencies of the segmentLength / 2 + 1 bins [Hz]
+         * @param spectrum in the unit of the samples (AMPLITUDE) resp. its square per Hz (PSD)
+         * @return false if the segment length is no power of two or longer than the samples
+         */
+        static bool computeSpectrum(Span<const float> samples, float stepSize, const SpectrumConfig &spectrumConfig,
+                                    std::vector<float> &frequencies, std::vector<float> &spectrum);
+    };
+}
@@ -6,7 +6,17 @@
 #pragma once
 
 #include <filesystem>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
 #include <vibration_daq/entities/VibrationData.hpp>
+#include <vibration_daq/entities/HostTimestamp.hpp>
+#include <vibration_daq/entities/StorageConfig.hpp>
+#include <vibration_daq/CaptureSink.hpp>
+#include <vibration_daq/SegmentArchive.hpp>
+#include <vibration_daq/CaptureIndex.hpp>
+#include <vibration_daq/RetentionManager.hpp>
 #include <date/tz.h>
 #include <chrono>
 
@@ -14,32 +24,119 @@ namespace fs = std::filesystem;
 
 namespace vibration_daq {
     /**
-     * The StorageModule stores the VibrationData on disk.
+     * The StorageModule stores the VibrationData on disk, either as CSV files or appended to segments. It is the
+     * CaptureSink of the CSV, BINARY, SEGMENT and COMPRESSED sink types.
      */
-    class StorageModule {
+    class StorageModule : public CaptureSink {
     private:
         fs::path storageDirectory;
+        StorageConfig storageConfig;
+        std::map<std::string, std::unique_ptr<SegmentArchive>> segmentArchives; // per sensor name
+        CaptureIndex captureIndex;
+        RetentionManager retentionManager;
+
+        int directoryFd = -1; // of the storage directory, for syncing
+        std::vector<std::pair<fs::path, fs::path>> pendingRenames; // temporary to final path
+        int pendingCaptures = 0; // since the last sync
+        std::chrono::steady_clock::time_point lastSync;
 
         static std::string getLocalTimestampString(const std::chrono::system_clock::time_point &timePoint);
 
         static std::string getUTCTimestampString(const std::chrono::system_clock::time_point &timePoint);
 
+        static std::string getAxisColumnName(const Axis &axis);
+
+        bool isSyncDue() const;
+
+        /**
+         * Writes the staged segment data, flushes the file system of the storage directory (unless SyncMode::NEVER)
+         * and renames the pending CSV and metadata files to their final names.
+         */
+        bool sync();
+
+        /**
+         * Deletes the temporary files of captures which were not synced before a crash.
+         */
+        static void removeTemporaryFiles(const fs::path &storageDirectoryPath);
+
     public:
+        static constexpr const char *TEMPORARY_EXTENSION = ".tmp";
+
+        StorageModule() = default;
+
+        StorageModule(const StorageModule &) = delete;
+
+        StorageModule &operator=(const StorageModule &) = delete;
+
+        ~StorageModule() override;
+
         /**
-         * Checks if storage directory is existing.
+         * Checks if storage directory is existing. Temporary files and segments left by a crash are cleaned up, the
+         * capture index is opened and the retention manager is started.
          * @param storageDirectoryPath
          * @return true if storage directory exists
          */
-        bool setup(const fs::path &storageDirectoryPath);
+        bool setup(const fs::path &storageDirectoryPath, const StorageConfig &storageConfig = StorageConfig());
 
         /**
-         * Stores the vibration data as CSV file.
+         * Syncs the pending captures, closes the open segments and stops the retention manager.
+         */
+        void close() override;
+
+        /**
+         * Stores the vibration data as CSV file. Only the recorded axes are written as columns. The capture metadata is
+         * stored in a YAML file with the same name. Both are written with TEMPORARY_EXTENSION and renamed on the
+         * next sync, see SyncMode, so a CSV file with its final name is always complete. With StorageFormat::SEGMENT the capture is appended to the
+         * segment of the sensor instead. The capture is added to the capture index and the retention manager is
+         * notified.
          * @param vibrationData
          * @param sensorName will be used for filename
-         * @param measurementTimestamp will be used for filename
+         * @param triggerTimestamp will be used for filename
          * @return true if success
          */
         bool storeVibrationData(const VibrationData &vibrationData, const std::string &sensorName,
-                                const std::chrono::system_clock::time_point &measurementTimestamp) const;
+                                const HostTimestamp &triggerTimestamp) override;
+
+        /**
+         * @param pendingCaptures stored since the last sync
+         * @return true if the storage is due to be synced according to the sync mode of the storage config
+         */
+        static bool isSyncDue(const StorageConfig &storageConfig, int pendingCaptures,
+                              std::chrono::steady_clock::time_point lastSync);
+
+        /**
+         * @return name of the CSV file of a capture without extension, the metadata file gets the extension ".yaml"
+         */
+        static std::string getCSVFileStem(RecordingMode recordingMode, const std::string &sensorName,
+                                          const HostTimestamp &triggerTimestamp);
+
+        /**
+         * Stores the capture metadata as YAML file next to the data file.
+         */
+        static bool storeCaptureMetadata(const CaptureMetadata &metadata, const std::string &sensorName,
+                                         const HostTimestamp &triggerTimestamp,
+                                         const std::string &metadataFilePath);
+
+        /**
+         * Writes the step axis and the recorded axes of the vibration data as CSV file.
+         */
+        static bool writeCSVFile(const VibrationData &vibrationData, const std::string &dataFilePath);
+
+        /**
+         * Reads a CSV file written by writeCSVFile(). The recording mode is derived from the header, so AFFT is
+         * read as MFFT. Raw samples and metadata are not restored.
+         */
+        static bool readCSVFile(const std::string &dataFilePath, VibrationData &vibrationData);
+
+        /**
+         * Parses the content of a CSV file, see readCSVFile().
+         */
+        static bool parseCSV(const char *data, size_t size, VibrationData &vibrationData);
+
+        /**
+         * Reads a metadata file written next to a CSV file.
+         */
+        static bool readCaptureMetadata(const std::string &metadataFilePath, CaptureMetadata &metadata,
+                                        HostTimestamp &triggerTimestamp);
     };
 }
\ No newline at end of file
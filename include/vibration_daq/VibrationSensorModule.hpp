@@ -10,14 +10,23 @@
 #include <spi.h>
 #include <vector>
 #include <functional>
+#include <optional>
+#include <chrono>
 #include "ADcmXL3021Library.hpp"
 #include "utils/HexUtils.hpp"
+#include "ClockSync.hpp"
+#include "utils/TimeUtils.hpp"
 #include "entities/VibrationData.hpp"
+#include "entities/Axis.hpp"
 #include "entities/RecordingMode.hpp"
 #include "entities/RecordingConfig.hpp"
 #include "entities/FIRFilter.hpp"
 #include "entities/DecimationFactor.hpp"
 #include "entities/WindowSetting.hpp"
+#include "entities/SampleRateSlot.hpp"
+#include "entities/ScheduleEntry.hpp"
+#include "entities/VibrationSensorConfig.hpp"
+#include "entities/FaultCounters.hpp"
 
 namespace vibration_daq {
 
@@ -27,39 +36,135 @@ namespace vibration_daq {
     class VibrationSensorModule {
     private:
         const std::string GPIO_PATH = "/dev/gpiochip0";
+        static constexpr std::chrono::milliseconds READY_TIMEOUT{2000};
+        static constexpr std::chrono::milliseconds DEFAULT_BUSY_TIMEOUT{10000};
+        static constexpr int TRANSFER_ATTEMPTS = 3;
 
         gpio_t *gpioBusy, *gpioReset;
         spi_t *spi;
         std::string name;
 
         RecordingMode currentRecordingMode = RecordingMode::MTC; // default for sensor as well
+        std::vector<Axis> axes = ALL_AXES;
+        std::chrono::microseconds wordGap{40};
+        mutable ClockSync clockSync;
 
-        static std::vector<float> generateSteps(float stepSize, int samplesCount);
+        // cache of the filter settings on the sensor, to only rewrite them if they change
+        bool firFilterWritten = false, customFilterTapsWritten = false;
+        FIRFilter currentFIRFilter = FIRFilter::NO_FILTER;
+        std::array<int16_t, 32> currentCustomFilterTaps = {};
+        uint16_t currentRecCtrl = 0; // 0 == unknown
+        float frequencyBandMin = 0.f, frequencyBandMax = 0.f; // Hz, max == 0 means up to f_MAX
+
+        // longest time the sensor may be busy, depends on the recording duration of the active mode
+        std::chrono::milliseconds busyTimeout = DEFAULT_BUSY_TIMEOUT;
+        mutable bool faulted = false;
+        mutable FaultCounters faultCounters;
+
+        /**
+         * Marks sensor as faulted, all further transfers are skipped until reset() is called.
+         */
+        void setFault(const std::string &reason) const;
+        void updateBusyTimeout(const RecordingConfig &recordingConfig, int recordsCount);
+
+        static SpiCommand getSamplesBufferCommand(const Axis &axis);
+
+        /**
+         * @return values of AVG_CNT, FFT_AVG1 and FFT_AVG2
+         */
+        static std::array<uint16_t, 3> getSampleRateRegisters(const SampleRateSlots &sampleRateSlots);
+
+        /**
+         * @return custom taps of the first schedule entry with a custom filter, only one set fits in filter bank F
+         */
+        static std::optional<std::array<int16_t, 32>> getCustomFilterTaps(const VibrationSensorConfig &config);
+
+        /**
+         * 16bit hash of the settings programmed by configure(), never 0 (factory value of USER_SCRATCH).
+         */
+        static uint16_t computeConfigHash(const SampleRateSlots &sampleRateSlots,
+                                          const std::optional<std::array<int16_t, 32>> &customFilterTaps,
+                                          bool externalTrigger);
+
+        /**
+         * Reads back the settings programmed by configure().
+         * @return true if they match
+         */
+        bool verifyConfig(const SampleRateSlots &sampleRateSlots,
+                          const std::optional<std::array<int16_t, 32>> &customFilterTaps,
+                          bool externalTrigger) const;
+
+        void saveToFlash() const;
+
+        /**
+         * Waits until the busy pin has settled after reset and PROD_ID reads the ADcmXL3021.
+         * @return false on timeout
+         */
+        bool waitUntilReady(std::chrono::milliseconds timeout) const;
+
+        static std::vector<float> generateSteps(float stepSize, int samplesCount, int firstStep = 0);
+
+        /**
+         * Translates the configured frequency band into a range of MFFT bins.
+         * @param binSize effective FFT bin size in Hz (depends on decimation factor)
+         * @param firstBin index of the first bin to read
+         * @param binsCount number of bins to read
+         */
+        void getFrequencyBandBins(float binSize, int &firstBin, int &binsCount) const;
 
         /**
-         * Send 16bit-word over SPI and read response to the sent word.
+         * Send 16bit-word over SPI and read response to the sent word. Failed transfers are retried, if it still
+         * fails the sensor is marked as faulted.
          * @param sendBuf 16bit-word
-         * @return response word
+         * @param keepWordGap false skips the wait after the transfer, only if no word follows soon
+         * @return response word, 0 if faulted
          */
-        WordBuffer transfer(WordBuffer sendBuf) const;
+        WordBuffer transfer(WordBuffer sendBuf, bool keepWordGap = true) const;
 
         /**
-         * Transfers only when sensor is _not_ bus.
+         * Transfers only when sensor is _not_ busy. The sensor is marked as faulted if it is busy for too long.
          * @param sendBuf 16bit-word
-         * @return response word
+         * @return response word, 0 if faulted
          */
         WordBuffer transferBlocking(WordBuffer sendBuf) const;
 
         uint16_t read(SpiCommand cmd) const;
-        std::vector<float> readSamplesBuffer(SpiCommand cmd, int samplesCount,
-                                             const std::function<float(int16_t)>& convertVibrationValue) const;
-        int readRecInfoFFTAveragesCount() const;
-        int readRecInfoDecimationFactor() const;
+
+        /**
+         * Reads several registers in one pipelined sweep, the page is only selected when it changes.
+         * @return register values in order of cmds, empty if a command is not readable
+         */
+        std::vector<uint16_t> readRegisters(const std::vector<SpiCommand> &cmds) const;
+        /**
+         * Reads samplesCount words of a sample buffer, starting at bufferOffset (set over BUF_PNTR).
+         * The buffer is read again if MISO got shifted, the sensor is marked as faulted if it persists.
+         * @return register values, see SampleConversion.hpp
+         */
+        std::vector<int16_t> readSamplesBuffer(SpiCommand cmd, int bufferOffset, int samplesCount) const;
+
+        /**
+         * @return false if MISO got shifted during read-out
+         */
+        bool readRawSamplesBuffer(SpiCommand cmd, int bufferOffset, int samplesCount,
+                                  std::vector<int16_t> &samplesRaw) const;
+
+        /**
+         * Reads PROD_ID to check that MISO is not shifted by one byte.
+         */
+        bool isMISOAligned() const;
+        /**
+         * Reads the capture metadata in one register sweep, including the decimation and averages of the capture.
+         * The sensor TIME_STAMP is read together with the host clocks and added to the clock mapping.
+         * The registers are read again if MISO got shifted, the sensor is marked as faulted if it persists.
+         */
+        CaptureMetadata readCaptureMetadata() const;
 
         void write(SpiCommand cmd, uint16_t value) const;
-        bool writeRecordingControl(const RecordingMode &recordingMode, const WindowSetting &windowSetting);
+        bool writeRecordingControl(const RecordingMode &recordingMode, const WindowSetting &windowSetting,
+                                   int sampleRateSlot);
         void writeFIRFilter(FIRFilter firFilter);
         void writeCustomFIRFilterTaps(std::array<int16_t, 32> customFilterTaps);
+        void updateFIRFilter(const RecordingConfig &recordingConfig);
         bool activateMode(const RecordingConfig &recordingConfig, const RecordingMode &recordingMode, const WindowSetting &windowSetting = WindowSetting::HANNING);
     public:
         explicit VibrationSensorModule(const std::string &name);
@@ -74,14 +179,81 @@ namespace vibration_daq {
         [[nodiscard]] bool setup(unsigned int resetPin, unsigned int busyPin, std::string spiPath, uint32_t speed);
         void close();
 
+        /**
+         * @return true if a fault occurred since the last reset, the data read since then is invalid
+         */
+        bool hasFault() const;
+        const FaultCounters &getFaultCounters() const;
+
+        /**
+         * Resets the sensor over the reset pin and waits until it responds with the right PROD_ID. Clears the fault,
+         * the sensor has to be configured and the mode activated again afterwards.
+         * @return true if the sensor is ready again
+         */
+        bool reset();
+
         const std::string &getSensorName() const;
 
-        void activateExternalTrigger() const;
+        /**
+         * Only the given axes are read out, the data of the others stays empty.
+         */
+        void setAxes(const std::vector<Axis> &axes);
+
+        /**
+         * Time SPI stays disabled between two words. Shorter gaps speed up the read-out, but make a shift of MISO
+         * more likely, which is detected and corrected by reading again.
+         */
+        void setWordGap(std::chrono::microseconds wordGap);
+
+        /**
+         * Programs the persistent settings (trigger source, sample rate slots, custom FIR taps) and saves them together
+         * with their hash (in USER_SCRATCH) to flash. Skipped if the sensor already holds the same hash.
+         * @param verify if the hash matches, also read back the settings and reprogram on mismatch
+         * @return true if the sensor was programmed, false if skipped
+         */
+        bool configure(const VibrationSensorConfig &config, bool externalTrigger, bool verify);
+
+        /**
+         * @param activate true == trigger over SYNC pin, false == trigger over SPI
+         */
+        void activateExternalTrigger(bool activate = true) const;
         /**
          * Triggers autonull of sensor and saves offset settings in flash.
+         * @return new offset corrections of X_ANULL, Y_ANULL and Z_ANULL
          */
-        void triggerAutonull() const;
+        std::array<uint16_t, 3> triggerAutonull();
+
+        /**
+         * Records in statistic mode (takes ~1.2s) and reads the mean offset of every axis. With an active autonull
+         * correction, this is the remaining offset (drift).
+         * @return X_STATISTIC, Y_STATISTIC, Z_STATISTIC
+         */
+        std::array<uint16_t, 3> measureStatistics();
+
+        /**
+         * @return X_ANULL, Y_ANULL, Z_ANULL
+         */
+        std::array<uint16_t, 3> readAutonullCorrection() const;
+        uint16_t readSerialId() const;
+
+        /**
+         * @return number of flash writes (ENDUR_LWR/UPR)
+         */
+        uint32_t readFlashWriteCount() const;
         void triggerRecording() const;
+
+        /**
+         * Writes everything of the trigger command except the last byte, so that fireTrigger() takes only one
+         * transfer. Waits until the sensor is not busy.
+         */
+        void prepareTrigger() const;
+
+        /**
+         * Writes the last byte of the trigger command, without checking the busy pin. prepareTrigger() has to be
+         * called before.
+         * @return time right after the trigger was sent
+         */
+        HostTimestamp fireTrigger() const;
         void restoreFactorySettings();
 
         /**
@@ -89,7 +261,17 @@ namespace vibration_daq {
          */
         VibrationData retrieveVibrationData() const;
 
+        /**
+         * Programs decimation and FFT averaging of all four sample rate slots (AVG_CNT, FFT_AVG1, FFT_AVG2).
+         * Afterwards a mode switch between the slots only needs a write of REC_CTRL.
+         */
+        void setupSampleRateSlots(const SampleRateSlots &sampleRateSlots) const;
+
+        /**
+         * Activates mode with the sample rate slot of the config, filters are only written if they changed.
+         */
         bool activateMode(const MFFTConfig &mfftConfig);
         bool activateMode(const MTCConfig &mtcConfig);
+        bool activateMode(const ScheduleEntry &scheduleEntry);
     };
 }
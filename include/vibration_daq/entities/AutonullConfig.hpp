@@ -0,0 +1,44 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include "../utils/EnumConversion.hpp"
+
+namespace vibration_daq {
+    enum class AutonullMode {
+        AUTO, // only if there is no valid calibration on the sensor
+        FORCE, // on every start
+        OFF
+    };
+
+    struct AutonullConfig {
+        AutonullMode mode = AutonullMode::FORCE;
+        std::string calibrationFile; // calibrations are not persisted if empty
+        int driftThreshold = 0; // LSB, drift is not checked if 0
+    };
+
+    namespace Enum {
+        const std::map<AutonullMode, std::string> AUTONULL_MODE_STRING_MAP{
+                {AutonullMode::AUTO,  "AUTO"},
+                {AutonullMode::FORCE, "FORCE"},
+                {AutonullMode::OFF,   "OFF"}
+        };
+
+        inline const std::string toString(const AutonullMode &autonullMode) {
+            return toString(autonullMode, AUTONULL_MODE_STRING_MAP);
+        }
+
+        inline static const bool convert(const AutonullMode &fromAutonullMode, std::string &toAutonullModeString) {
+            return convert(fromAutonullMode, toAutonullModeString, AUTONULL_MODE_STRING_MAP);
+        }
+
+        inline static const bool convert(const std::string &fromAutonullModeString, AutonullMode &toAutonullMode) {
+            return convert(fromAutonullModeString, toAutonullMode, AUTONULL_MODE_STRING_MAP);
+        }
+    };
+}
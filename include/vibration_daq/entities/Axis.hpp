@@ -0,0 +1,40 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include "../utils/EnumConversion.hpp"
+
+namespace vibration_daq {
+    enum class Axis {
+        X = 0,
+        Y = 1,
+        Z = 2
+    };
+
+    const std::vector<Axis> ALL_AXES = {Axis::X, Axis::Y, Axis::Z};
+
+    namespace Enum {
+        const std::map<Axis, std::string> AXIS_STRING_MAP{
+                {Axis::X, "X"},
+                {Axis::Y, "Y"},
+                {Axis::Z, "Z"}
+        };
+
+        inline const std::string toString(const Axis &axis) {
+            return toString(axis, AXIS_STRING_MAP);
+        }
+
+        inline static const bool convert(const Axis &fromAxis, std::string &toAxisString) {
+            return convert(fromAxis, toAxisString, AXIS_STRING_MAP);
+        }
+
+        inline static const bool convert(const std::string &fromAxisString, Axis &toAxis) {
+            return convert(fromAxisString, toAxis, AXIS_STRING_MAP);
+        }
+    };
+}
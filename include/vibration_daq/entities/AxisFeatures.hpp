@@ -0,0 +1,25 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include "AxisStatistics.hpp"
+
+namespace vibration_daq {
+    struct SpectralPeak {
+        float frequency = 0; // Hz
+        float amplitude = 0;
+    };
+
+    /**
+     * Summary of the samples of one axis.
+     */
+    struct AxisFeatures : AxisStatistics {
+        // of spectra only, see computeSpectralFeatures()
+        std::vector<float> bandEnergies; // sum of the squared amplitudes of the bins per band
+        std::vector<SpectralPeak> spectralPeaks; // highest first
+    };
+}
@@ -0,0 +1,22 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+namespace vibration_daq {
+    /**
+     * Time-domain statistics of the samples of one axis, see computeAxisStatistics().
+     */
+    struct AxisStatistics {
+        float mean = 0;
+        float rms = 0;
+        float stdDev = 0;
+        float peak = 0; // largest absolute value
+        float peakToPeak = 0; // largest minus smallest value
+        float crestFactor = 0; // peak / rms
+        float skewness = 0; // third standardized moment
+        float kurtosis = 0; // fourth standardized moment, 3 for normally distributed samples
+    };
+}
@@ -0,0 +1,22 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace vibration_daq {
+    /**
+     * Result of an autonull of one sensor.
+     */
+    struct Calibration {
+        uint16_t serialId = 0;
+        std::array<uint16_t, 3> anull = {}; // statistics written to X_ANULL, Y_ANULL, Z_ANULL
+        std::string timestamp; // UTC
+        uint32_t flashWriteCount = 0; // ENDUR_LWR/UPR after calibration
+    };
+}
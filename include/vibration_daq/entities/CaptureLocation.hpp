@@ -0,0 +1,23 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "RecordingMode.hpp"
+
+namespace vibration_daq {
+    /**
+     * Where a stored capture can be found.
+     */
+    struct CaptureLocation {
+        std::string sensorName;
+        RecordingMode recordingMode = RecordingMode::MTC;
+        int64_t triggerRealtimeNs = 0;
+        std::string fileName; // in the storage directory, a closed segment's name for segments
+        uint64_t offset = 0; // of the capture frame in a segment, 0 for CSV files
+    };
+}
@@ -0,0 +1,38 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include "Axis.hpp"
+#include "AxisStatistics.hpp"
+#include "FIRFilter.hpp"
+#include "WindowSetting.hpp"
+#include "HostTimestamp.hpp"
+#include "ClockMapping.hpp"
+
+namespace vibration_daq {
+    /**
+     * State of the sensor at read-out of a capture. Sensor values are the raw register values, scale them according
+     * to the datasheet. The statistics are computed on the host when the capture is read out.
+     */
+    struct CaptureMetadata {
+        uint16_t serialId = 0;
+        uint16_t revDay = 0; // firmware revision day
+        uint16_t yearMon = 0; // firmware revision year and month
+        uint16_t tempOut = 0;
+        uint16_t supplyOut = 0;
+        uint16_t diagStat = 0;
+        uint32_t sensorTimestamp = 0; // TIME_STAMP_H and TIME_STAMP_L
+        int decimationFactor = 1;
+        int spectralAvgCount = 0; // only set for FFT modes
+        FIRFilter firFilter = FIRFilter::NO_FILTER;
+        WindowSetting windowSetting = WindowSetting::RECTANGULAR;
+        HostTimestamp readoutTimestamp; // when TIME_STAMP was read
+        ClockMapping clockMapping; // of the sensor TIME_STAMP to the host, including this read-out
+        std::map<Axis, AxisStatistics> statistics; // of the recorded axes, only set for MTC
+    };
+}
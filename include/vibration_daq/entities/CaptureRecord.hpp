@@ -0,0 +1,21 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <string>
+#include "VibrationData.hpp"
+#include "HostTimestamp.hpp"
+
+namespace vibration_daq {
+    /**
+     * A stored capture, as written by the binary storage formats.
+     */
+    struct CaptureRecord {
+        std::string sensorName;
+        HostTimestamp triggerTimestamp;
+        VibrationData vibrationData;
+    };
+}
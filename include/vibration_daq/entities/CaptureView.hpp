@@ -0,0 +1,46 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include "RecordingMode.hpp"
+#include "Axis.hpp"
+#include "CaptureMetadata.hpp"
+#include "HostTimestamp.hpp"
+#include "SampleCodec.hpp"
+#include "../utils/Span.hpp"
+
+namespace vibration_daq {
+    /**
+     * A stored capture read in place: sensor name and samples point into the payload, which must outlive the view.
+     */
+    struct CaptureView {
+        struct AxisSamples {
+            bool recorded = false;
+            SampleCodec codec = SampleCodec::RAW;
+            Span<const uint8_t> encoded;
+        };
+
+        std::string_view sensorName;
+        HostTimestamp triggerTimestamp;
+        RecordingMode recordingMode;
+        CaptureMetadata metadata;
+        int binOffset = 0;
+        uint32_t samplesCount = 0;
+        float stepSize = 0;
+        std::array<AxisSamples, 3> axisSamples; // per Axis
+
+        const AxisSamples &getAxisSamples(const Axis &axis) const {
+            return axisSamples[static_cast<int>(axis)];
+        }
+
+        AxisSamples &getAxisSamples(const Axis &axis) {
+            return axisSamples[static_cast<int>(axis)];
+        }
+    };
+}
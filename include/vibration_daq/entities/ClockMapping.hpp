@@ -0,0 +1,24 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdint>
+
+namespace vibration_daq {
+    /**
+     * Linear mapping of the sensor TIME_STAMP to the host CLOCK_MONOTONIC_RAW:
+     * monotonicRawNs = offsetNs + nsPerTick * (ticks - referenceTicks)
+     */
+    struct ClockMapping {
+        bool valid = false; // at least two points with different ticks
+        int pointsCount = 0;
+        int64_t referenceTicks = 0; // unwrapped sensor ticks
+        double offsetNs = 0;
+        double nsPerTick = 0; // fitted tick period of the sensor clock in host time
+        double driftPpm = 0; // change of nsPerTick since the first valid mapping
+        double residualNs = 0; // RMS of the fit residuals
+    };
+}
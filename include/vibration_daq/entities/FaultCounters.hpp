@@ -0,0 +1,33 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <ostream>
+
+namespace vibration_daq {
+    /**
+     * Number of faults per fault class of one sensor.
+     */
+    struct FaultCounters {
+        unsigned long spiTransferErrors = 0;
+        unsigned long gpioReadErrors = 0;
+        unsigned long busyTimeouts = 0;
+        unsigned long prodIdMismatches = 0;
+        unsigned long misoShifts = 0;
+        unsigned long recoveries = 0;
+        unsigned long failedRecoveries = 0;
+    };
+
+    inline std::ostream &operator<<(std::ostream &os, const FaultCounters &faultCounters) {
+        return os << "spi_transfer_errors: " << faultCounters.spiTransferErrors
+                  << ", gpio_read_errors: " << faultCounters.gpioReadErrors
+                  << ", busy_timeouts: " << faultCounters.busyTimeouts
+                  << ", prod_id_mismatches: " << faultCounters.prodIdMismatches
+                  << ", miso_shifts: " << faultCounters.misoShifts
+                  << ", recoveries: " << faultCounters.recoveries
+                  << ", failed_recoveries: " << faultCounters.failedRecoveries;
+    }
+}
@@ -0,0 +1,38 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include "RecordingMode.hpp"
+#include "SpectrumConfig.hpp"
+
+namespace vibration_daq {
+    struct FrequencyBand {
+        float min = 0; // Hz
+        float max = 0; // Hz, exclusive
+    };
+
+    /**
+     * Limits of the features of any axis, in the unit of the recording mode (g resp. mg). 0: not checked.
+     */
+    struct FeatureThresholds {
+        float rms = 0;
+        float peak = 0;
+        float crestFactor = 0;
+        float bandEnergy = 0; // of any band
+    };
+
+    struct FeatureConfig {
+        std::vector<FrequencyBand> bands; // of the band energies
+        int spectralPeaksCount = 3; // highest local maxima of the spectrum
+        int rawInterval = 0; // every rawInterval-th capture of a sensor is kept raw, 0: none
+        std::map<RecordingMode, FeatureThresholds> thresholds;
+        float baselineDeviation = 0; // standard deviations from the baseline, 0: not checked
+        int baselineCaptures = 50; // captures to learn the baseline, afterwards its time constant
+        SpectrumConfig spectrumConfig; // of the spectral features of MTC captures, always scaled to AMPLITUDE
+    };
+}
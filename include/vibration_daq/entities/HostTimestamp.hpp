@@ -0,0 +1,26 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace vibration_daq {
+    /**
+     * Point in time on the host, taken from both CLOCK_MONOTONIC_RAW (not slewed by NTP, for intervals and clock
+     * mapping) and CLOCK_REALTIME (wall clock).
+     */
+    struct HostTimestamp {
+        int64_t monotonicRawNs = 0;
+        int64_t realtimeNs = 0; // since 1970-01-01T00:00:00Z
+
+        std::chrono::system_clock::time_point getSystemTimePoint() const {
+            return std::chrono::system_clock::time_point(
+                    std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                            std::chrono::nanoseconds(realtimeNs)));
+        }
+    };
+}
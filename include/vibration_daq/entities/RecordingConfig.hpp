@@ -15,6 +15,7 @@ namespace vibration_daq {
         DecimationFactor decimationFactor = DecimationFactor::FACTOR_1;
         FIRFilter firFilter = FIRFilter::NO_FILTER;
         std::array<int16_t, 32> customFilterTaps = {};
+        int sampleRateSlot = 0; // SR0-SR3, assigned by the ConfigModule
     };
 
     struct MTCConfig : RecordingConfig {
@@ -24,6 +25,8 @@ namespace vibration_daq {
     struct MFFTConfig : RecordingConfig {
         int spectralAvgCount = 1; // 1-255
         WindowSetting windowSetting = WindowSetting::HANNING;
+        float frequencyBandMin = 0.f; // Hz
+        float frequencyBandMax = 0.f; // Hz, 0 == up to f_MAX
     };
 
 }
@@ -0,0 +1,45 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include "../utils/EnumConversion.hpp"
+
+namespace vibration_daq {
+    enum class AgedOutMode {
+        DELETE, // aged out captures are deleted
+        FEATURES, // features of every axis are appended to the sensor's features file before deletion
+        DOWNSAMPLE // a downsampled CSV file is kept instead
+    };
+
+    namespace Enum {
+        const std::map<AgedOutMode, std::string> AGED_OUT_MODE_STRING_MAP{
+                {AgedOutMode::DELETE,     "DELETE"},
+                {AgedOutMode::FEATURES,   "FEATURES"},
+                {AgedOutMode::DOWNSAMPLE, "DOWNSAMPLE"}
+        };
+
+        inline const std::string toString(const AgedOutMode &fromEnum) {
+            return toString(fromEnum, AGED_OUT_MODE_STRING_MAP);
+        }
+
+        inline static const bool convert(const AgedOutMode &fromEnum, std::string &toEnumString) {
+            return convert(fromEnum, toEnumString, AGED_OUT_MODE_STRING_MAP);
+        }
+
+        inline static const bool convert(const std::string &fromEnumString, AgedOutMode &toEnum) {
+            return convert(fromEnumString, toEnum, AGED_OUT_MODE_STRING_MAP);
+        }
+    };
+
+    struct RetentionConfig {
+        uint64_t quota = 0; // bytes, 0: no quota
+        int maxAge = 0; // days, 0: no limit
+        AgedOutMode agedOutMode = AgedOutMode::DELETE;
+        int downsampleFactor = 8;
+    };
+}
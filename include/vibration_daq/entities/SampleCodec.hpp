@@ -0,0 +1,38 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <map>
+#include "../utils/EnumConversion.hpp"
+
+namespace vibration_daq {
+    /**
+     * Encoding of the int16 samples of an axis in the binary storage formats, the value is stored in the payload.
+     */
+    enum class SampleCodec {
+        RAW = 0, // int16 samples as read from the sensor
+        DELTA_PACK = 1 // lossless, see SampleCompression.hpp
+    };
+
+    namespace Enum {
+        const std::map<SampleCodec, std::string> SAMPLE_CODEC_STRING_MAP{
+                {SampleCodec::RAW,        "RAW"},
+                {SampleCodec::DELTA_PACK, "DELTA_PACK"}
+        };
+
+        inline const std::string toString(const SampleCodec &fromEnum) {
+            return toString(fromEnum, SAMPLE_CODEC_STRING_MAP);
+        }
+
+        inline static const bool convert(const SampleCodec &fromEnum, std::string &toEnumString) {
+            return convert(fromEnum, toEnumString, SAMPLE_CODEC_STRING_MAP);
+        }
+
+        inline static const bool convert(const std::string &fromEnumString, SampleCodec &toEnum) {
+            return convert(fromEnumString, toEnum, SAMPLE_CODEC_STRING_MAP);
+        }
+    };
+}
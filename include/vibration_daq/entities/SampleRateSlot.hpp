@@ -0,0 +1,29 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <array>
+#include "DecimationFactor.hpp"
+
+namespace vibration_daq {
+    /**
+     * One of the four sample rate options (SR0-SR3) of the sensor, selected over REC_CTRL.
+     */
+    struct SampleRateSlot {
+        DecimationFactor decimationFactor = DecimationFactor::FACTOR_1;
+        int spectralAvgCount = 1; // 1-255, only used by MFFT
+    };
+
+    typedef std::array<SampleRateSlot, 4> SampleRateSlots;
+
+    // factory defaults of AVG_CNT, FFT_AVG1 and FFT_AVG2
+    const SampleRateSlots DEFAULT_SAMPLE_RATE_SLOTS = {{
+            {DecimationFactor::FACTOR_1, 1},
+            {DecimationFactor::FACTOR_4, 1},
+            {DecimationFactor::FACTOR_16, 1},
+            {DecimationFactor::FACTOR_128, 1}
+    }};
+}
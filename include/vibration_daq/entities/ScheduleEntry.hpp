@@ -0,0 +1,21 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "RecordingMode.hpp"
+#include "RecordingConfig.hpp"
+
+namespace vibration_daq {
+    /**
+     * One recording of a sensor's schedule.
+     */
+    struct ScheduleEntry {
+        RecordingMode recordingMode = RecordingMode::MTC;
+        int interval = 1; // record every n-th monitoring cycle
+        MFFTConfig mfftConfig; // only used if recordingMode == MFFT
+        MTCConfig mtcConfig; // only used if recordingMode == MTC
+    };
+}
@@ -0,0 +1,20 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdint>
+#include "RecordingMode.hpp"
+
+namespace vibration_daq {
+    /**
+     * Entry of the index in the footer of a segment, one per capture.
+     */
+    struct SegmentIndexEntry {
+        int64_t triggerRealtimeNs = 0;
+        uint64_t offset = 0; // of the capture frame in the segment file
+        RecordingMode recordingMode = RecordingMode::MTC;
+    };
+}
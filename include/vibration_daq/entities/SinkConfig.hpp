@@ -0,0 +1,60 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include "../utils/EnumConversion.hpp"
+#include "SampleCodec.hpp"
+#include "FeatureConfig.hpp"
+
+namespace vibration_daq {
+    enum class SinkType {
+        CSV, // StorageModule with StorageFormat::CSV
+        BINARY, // StorageModule with StorageFormat::SEGMENT and SampleCodec::RAW
+        SEGMENT, // StorageModule with StorageFormat::SEGMENT and the codec of the storage config
+        COMPRESSED, // StorageModule with StorageFormat::SEGMENT and SampleCodec::DELTA_PACK
+        SOCKET, // capture frames streamed to the clients of a Unix domain socket
+        NULL_SINK, // captures are discarded
+        TEE, // captures are passed to all sinks
+        FEATURES // only the features are stored, captures are passed to the sinks on anomalies
+    };
+
+    namespace Enum {
+        const std::map<SinkType, std::string> SINK_TYPE_STRING_MAP{
+                {SinkType::CSV,        "CSV"},
+                {SinkType::BINARY,     "BINARY"},
+                {SinkType::SEGMENT,    "SEGMENT"},
+                {SinkType::COMPRESSED, "COMPRESSED"},
+                {SinkType::SOCKET,     "SOCKET"},
+                {SinkType::NULL_SINK,  "NULL_SINK"},
+                {SinkType::TEE,        "TEE"},
+                {SinkType::FEATURES,   "FEATURES"}
+        };
+
+        inline const std::string toString(const SinkType &fromEnum) {
+            return toString(fromEnum, SINK_TYPE_STRING_MAP);
+        }
+
+        inline static const bool convert(const SinkType &fromEnum, std::string &toEnumString) {
+            return convert(fromEnum, toEnumString, SINK_TYPE_STRING_MAP);
+        }
+
+        inline static const bool convert(const std::string &fromEnumString, SinkType &toEnum) {
+            return convert(fromEnumString, toEnum, SINK_TYPE_STRING_MAP);
+        }
+    };
+
+    struct SinkConfig {
+        SinkType type = SinkType::CSV;
+        std::string directory; // of the StorageModule and FEATURES sinks, empty: storage_directory
+        std::string socketPath; // of SinkType::SOCKET
+        SampleCodec sampleCodec = SampleCodec::RAW; // of the frames streamed by SinkType::SOCKET
+        FeatureConfig featureConfig; // of SinkType::FEATURES
+        std::vector<SinkConfig> sinks; // of SinkType::TEE, the raw sinks of SinkType::FEATURES
+    };
+}
@@ -0,0 +1,21 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "SpectrumScaling.hpp"
+#include "WindowSetting.hpp"
+
+namespace vibration_daq {
+    /**
+     * Spectrum of MTC samples computed on the host, see SpectrumAnalyzer.
+     */
+    struct SpectrumConfig {
+        WindowSetting windowSetting = WindowSetting::HANNING;
+        int segmentLength = 0; // samples per FFT (Welch segments), power of two, 0: largest fitting the capture
+        float overlap = 0.5f; // of consecutive segments, [0, 1)
+        SpectrumScaling scaling = SpectrumScaling::AMPLITUDE;
+    };
+}
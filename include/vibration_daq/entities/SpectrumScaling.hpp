@@ -0,0 +1,38 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <map>
+#include "../utils/EnumConversion.hpp"
+
+namespace vibration_daq {
+    /**
+     * Scaling of the single-sided spectra computed on the host, see SpectrumAnalyzer.
+     */
+    enum class SpectrumScaling {
+        AMPLITUDE, // peak amplitude of a sine in the unit of the samples, e.g. g
+        PSD // power spectral density, e.g. g^2/Hz
+    };
+
+    namespace Enum {
+        const std::map<SpectrumScaling, std::string> SPECTRUM_SCALING_STRING_MAP{
+                {SpectrumScaling::AMPLITUDE, "AMPLITUDE"},
+                {SpectrumScaling::PSD,       "PSD"}
+        };
+
+        inline const std::string toString(const SpectrumScaling &fromEnum) {
+            return toString(fromEnum, SPECTRUM_SCALING_STRING_MAP);
+        }
+
+        inline static const bool convert(const SpectrumScaling &fromEnum, std::string &toEnumString) {
+            return convert(fromEnum, toEnumString, SPECTRUM_SCALING_STRING_MAP);
+        }
+
+        inline static const bool convert(const std::string &fromEnumString, SpectrumScaling &toEnum) {
+            return convert(fromEnumString, toEnum, SPECTRUM_SCALING_STRING_MAP);
+        }
+    };
+}
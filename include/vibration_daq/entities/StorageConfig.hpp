@@ -0,0 +1,28 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdint>
+#include "StorageFormat.hpp"
+#include "RetentionConfig.hpp"
+#include "SampleCodec.hpp"
+#include "SyncMode.hpp"
+
+namespace vibration_daq {
+    struct StorageConfig {
+        StorageFormat format = StorageFormat::CSV;
+        uint64_t segmentMaxSize = 64 * 1024 * 1024; // bytes, a new segment is started when exceeded
+        int segmentMaxDuration = 3600; // s, a new segment is started when exceeded
+        SampleCodec sampleCodec = SampleCodec::DELTA_PACK; // of the samples in segments
+        size_t writeBlockSize = 4 * 1024 * 1024; // bytes, multiple of 4 KiB, segments are written in these blocks
+        bool preallocate = true; // segments are allocated with their maximum size
+        bool directIO = false; // segments are written with O_DIRECT, bypassing the page cache
+        SyncMode syncMode = SyncMode::CAPTURE;
+        int syncCount = 10; // captures, for SyncMode::COUNT
+        int syncInterval = 10; // s, for SyncMode::INTERVAL
+        RetentionConfig retention;
+    };
+}
@@ -0,0 +1,35 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <map>
+#include "../utils/EnumConversion.hpp"
+
+namespace vibration_daq {
+    enum class StorageFormat {
+        CSV, // one CSV file (and metadata YAML file) per capture
+        SEGMENT // captures appended to one segment file per sensor and time window
+    };
+
+    namespace Enum {
+        const std::map<StorageFormat, std::string> STORAGE_FORMAT_STRING_MAP{
+                {StorageFormat::CSV,     "CSV"},
+                {StorageFormat::SEGMENT, "SEGMENT"}
+        };
+
+        inline const std::string toString(const StorageFormat &fromEnum) {
+            return toString(fromEnum, STORAGE_FORMAT_STRING_MAP);
+        }
+
+        inline static const bool convert(const StorageFormat &fromEnum, std::string &toEnumString) {
+            return convert(fromEnum, toEnumString, STORAGE_FORMAT_STRING_MAP);
+        }
+
+        inline static const bool convert(const std::string &fromEnumString, StorageFormat &toEnum) {
+            return convert(fromEnumString, toEnum, STORAGE_FORMAT_STRING_MAP);
+        }
+    };
+}
@@ -0,0 +1,42 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <map>
+#include "../utils/EnumConversion.hpp"
+
+namespace vibration_daq {
+    /**
+     * When stored captures are flushed to the storage device and CSV files get their final name.
+     */
+    enum class SyncMode {
+        CAPTURE, // after every capture
+        COUNT, // after every syncCount captures
+        INTERVAL, // with the first capture after syncInterval since the last sync
+        NEVER // files are renamed right away, flushing is left to the kernel
+    };
+
+    namespace Enum {
+        const std::map<SyncMode, std::string> SYNC_MODE_STRING_MAP{
+                {SyncMode::CAPTURE,  "CAPTURE"},
+                {SyncMode::COUNT,    "COUNT"},
+                {SyncMode::INTERVAL, "INTERVAL"},
+                {SyncMode::NEVER,    "NEVER"}
+        };
+
+        inline const std::string toString(const SyncMode &fromEnum) {
+            return toString(fromEnum, SYNC_MODE_STRING_MAP);
+        }
+
+        inline static const bool convert(const SyncMode &fromEnum, std::string &toEnumString) {
+            return convert(fromEnum, toEnumString, SYNC_MODE_STRING_MAP);
+        }
+
+        inline static const bool convert(const std::string &fromEnumString, SyncMode &toEnum) {
+            return convert(fromEnumString, toEnum, SYNC_MODE_STRING_MAP);
+        }
+    };
+}
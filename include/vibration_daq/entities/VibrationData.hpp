@@ -3,17 +3,60 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
 
+#include <cstdint>
 #include <vector>
 #pragma once
 
 #include "RecordingMode.hpp"
+#include "Axis.hpp"
+#include "CaptureMetadata.hpp"
 
 namespace vibration_daq {
     struct VibrationData {
         RecordingMode recordingMode;
+        int binOffset = 0; // index of the first sample in the sensor buffer
+        std::vector<Axis> axes = ALL_AXES; // recorded axes, data of the other axes is empty
+        CaptureMetadata metadata;
+        float stepSize = 0; // of stepAxis, in s resp. Hz
         std::vector<float> stepAxis; // time resp. frequency axis
         std::vector<float> xAxis;
         std::vector<float> yAxis;
         std::vector<float> zAxis;
+        // register values of the sample buffers, see SampleConversion.hpp
+        std::vector<int16_t> xAxisRaw;
+        std::vector<int16_t> yAxisRaw;
+        std::vector<int16_t> zAxisRaw;
+
+        const std::vector<float> &getAxisData(const Axis &axis) const {
+            switch (axis) {
+                case Axis::X:
+                    return xAxis;
+                case Axis::Y:
+                    return yAxis;
+                case Axis::Z:
+                default:
+                    return zAxis;
+            }
+        }
+
+        std::vector<float> &getAxisData(const Axis &axis) {
+            return const_cast<std::vector<float> &>(static_cast<const VibrationData &>(*this).getAxisData(axis));
+        }
+
+        const std::vector<int16_t> &getAxisRawData(const Axis &axis) const {
+            switch (axis) {
+                case Axis::X:
+                    return xAxisRaw;
+                case Axis::Y:
+                    return yAxisRaw;
+                case Axis::Z:
+                default:
+                    return zAxisRaw;
+            }
+        }
+
+        std::vector<int16_t> &getAxisRawData(const Axis &axis) {
+            return const_cast<std::vector<int16_t> &>(static_cast<const VibrationData &>(*this).getAxisRawData(axis));
+        }
     };
-}
\ No newline at end of file
+}
@@ -5,14 +5,22 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+#include "Axis.hpp"
+#include "RecordingConfig.hpp"
+#include "RecordingMode.hpp"
+#include "SampleRateSlot.hpp"
+#include "ScheduleEntry.hpp"
+
 namespace vibration_daq {
     struct VibrationSensorConfig {
         std::string name;
         int busyPin;
         int resetPin;
         std::string spiPath;
-        RecordingMode recordingMode;
-        MFFTConfig mfftConfig;
-        MTCConfig mtcConfig;
+        std::vector<Axis> axes = ALL_AXES;
+        std::vector<ScheduleEntry> schedule; // at least one entry
+        SampleRateSlots sampleRateSlots = DEFAULT_SAMPLE_RATE_SLOTS;
     };
-}
\ No newline at end of file
+}
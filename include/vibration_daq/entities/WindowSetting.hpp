@@ -8,14 +8,16 @@ namespace vibration_daq {
     enum class WindowSetting {
         RECTANGULAR = 0b00,
         HANNING = 0b01,
-        FLAT_TOP = 0b10
+        FLAT_TOP = 0b10,
+        BLACKMAN_HARRIS = 0b11 // host spectra only, see SpectrumAnalyzer
     };
 
     namespace Enum {
         const std::map<WindowSetting, std::string> WINDOW_SETTING_STRING_MAP{
                 {WindowSetting::RECTANGULAR, "RECTANGULAR"},
                 {WindowSetting::HANNING , "HANNING"},
-                {WindowSetting::FLAT_TOP , "FLAT_TOP"}
+                {WindowSetting::FLAT_TOP , "FLAT_TOP"},
+                {WindowSetting::BLACKMAN_HARRIS , "BLACKMAN_HARRIS"}
         };
 
         inline const std::string toString(const WindowSetting &windowSetting) {
@@ -0,0 +1,99 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace vibration_daq {
+    /**
+     * Fixed capacity byte buffer with aligned start, as needed for O_DIRECT writes.
+     */
+    class AlignedBuffer {
+    private:
+        uint8_t *data = nullptr;
+        size_t capacity = 0;
+        size_t size = 0;
+
+    public:
+        AlignedBuffer() = default;
+
+        AlignedBuffer(size_t alignment, size_t capacity) : capacity(capacity) {
+            void *memory = nullptr;
+            if (posix_memalign(&memory, alignment, capacity) != 0) {
+                throw std::bad_alloc();
+            }
+            data = static_cast<uint8_t *>(memory);
+            std::memset(data, 0, capacity);
+        }
+
+        AlignedBuffer(const AlignedBuffer &) = delete;
+
+        AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+        AlignedBuffer &operator=(AlignedBuffer &&other) noexcept {
+            std::swap(data, other.data);
+            std::swap(capacity, other.capacity);
+            std::swap(size, other.size);
+            return *this;
+        }
+
+        ~AlignedBuffer() {
+            std::free(data);
+        }
+
+        /**
+         * @return number of bytes appended, less than count if the buffer is full
+         */
+        size_t append(const void *source, size_t count) {
+            const size_t appended = count < capacity - size ? count : capacity - size;
+            std::memcpy(data + size, source, appended);
+            size += appended;
+            return appended;
+        }
+
+        /**
+         * Removes count bytes from the front.
+         */
+        void consume(size_t count) {
+            std::memmove(data, data + count, size - count);
+            size -= count;
+        }
+
+        /**
+         * Zeros the bytes after size up to the next multiple of alignment.
+         * @return the padded size
+         */
+        size_t pad(size_t alignment) {
+            const size_t paddedSize = (size + alignment - 1) / alignment * alignment;
+            std::memset(data + size, 0, paddedSize - size);
+            return paddedSize;
+        }
+
+        void clear() {
+            size = 0;
+        }
+
+        const uint8_t *getData() const {
+            return data;
+        }
+
+        size_t getSize() const {
+            return size;
+        }
+
+        size_t getCapacity() const {
+            return capacity;
+        }
+
+        bool isFull() const {
+            return size == capacity;
+        }
+    };
+}
@@ -0,0 +1,98 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// the binary formats are stored in the byte order of the host, only little-endian hosts are supported
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "binary formats require a little-endian host");
+
+namespace vibration_daq {
+    /**
+     * Appends values in their memory representation to a byte buffer.
+     */
+    class BinaryWriter {
+    private:
+        std::vector<uint8_t> &buffer;
+
+    public:
+        explicit BinaryWriter(std::vector<uint8_t> &buffer) : buffer(buffer) {}
+
+        template<typename T>
+        void write(const T &value) {
+            static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be written");
+            writeBytes(&value, sizeof(T));
+        }
+
+        void writeBytes(const void *data, size_t size) {
+            auto bytes = static_cast<const uint8_t *>(data);
+            buffer.insert(buffer.end(), bytes, bytes + size);
+        }
+
+        /**
+         * Pads with zeros up to the next multiple of alignment.
+         */
+        void align(size_t alignment) {
+            buffer.resize((buffer.size() + alignment - 1) / alignment * alignment, 0);
+        }
+
+        size_t getSize() const {
+            return buffer.size();
+        }
+    };
+
+    /**
+     * Reads values written by BinaryWriter, every read is bounds checked.
+     */
+    class BinaryReader {
+    private:
+        const uint8_t *data;
+        size_t size;
+        size_t position = 0;
+
+    public:
+        BinaryReader(const void *data, size_t size) : data(static_cast<const uint8_t *>(data)), size(size) {}
+
+        template<typename T>
+        bool read(T &value) {
+            static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be read");
+            return readBytes(&value, sizeof(T));
+        }
+
+        bool readBytes(void *destination, size_t count) {
+            const uint8_t *source = skip(count);
+            if (!source) {
+                return false;
+            }
+            std::memcpy(destination, source, count);
+            return true;
+        }
+
+        /**
+         * @return pointer to the skipped bytes, nullptr if not enough bytes left
+         */
+        const uint8_t *skip(size_t count) {
+            if (count > size - position) {
+                return nullptr;
+            }
+            const uint8_t *skipped = data + position;
+            position += count;
+            return skipped;
+        }
+
+        bool align(size_t alignment) {
+            size_t alignedPosition = (position + alignment - 1) / alignment * alignment;
+            return skip(alignedPosition - position) != nullptr;
+        }
+
+        size_t getPosition() const {
+            return position;
+        }
+    };
+}
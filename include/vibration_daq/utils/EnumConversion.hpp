@@ -5,6 +5,9 @@
 
 #pragma once
 
+#include <map>
+#include <string>
+
 namespace vibration_daq {
     namespace Enum {
         template<typename T>
@@ -0,0 +1,171 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "../entities/AxisFeatures.hpp"
+#include "../entities/FeatureConfig.hpp"
+#include "Span.hpp"
+
+namespace vibration_daq {
+    /**
+     * Computes the statistics in a single pass. The power sums of the deviations from the mean of the first block
+     * are accumulated in SIMD lanes of floats and added up in double every block. The deviations keep the sums
+     * small, so the central moments don't suffer from cancellation.
+     * @param values converted samples or raw int16 samples
+     * @param scale applied to the values, e.g. MTC_SCALE for raw samples
+     */
+    template<typename T>
+    inline static AxisStatistics computeAxisStatistics(const T *values, size_t count, float scale = 1) {
+        static_assert(std::is_same<T, float>::value || std::is_same<T, int16_t>::value, "float or int16 values");
+        constexpr size_t LANES = 4;
+        // GCC and Clang vector extensions of the size of an SSE resp. NEON register
+        typedef float FloatLanes __attribute__((vector_size(LANES * sizeof(float))));
+        typedef int16_t Int16Lanes __attribute__((vector_size(LANES * sizeof(int16_t))));
+        constexpr size_t BLOCK_SIZE = 512; // values per lane sum, bounds the rounding error of the float sums
+
+        AxisStatistics axisStatistics;
+        if (count == 0) {
+            return axisStatistics;
+        }
+
+        double firstBlockSum = 0;
+        for (size_t i = 0; i < std::min(BLOCK_SIZE, count); ++i) {
+            firstBlockSum += values[i];
+        }
+        const auto reference = static_cast<float>(firstBlockSum / std::min(BLOCK_SIZE, count));
+        double sums[4] = {}; // of the deviations from reference, to the power of 1 to 4
+        float minimum = static_cast<float>(values[0]), maximum = minimum;
+        for (size_t blockStart = 0; blockStart < count; blockStart += BLOCK_SIZE) {
+            const size_t blockEnd = std::min(blockStart + BLOCK_SIZE, count);
+            const size_t lanesEnd = blockStart + (blockEnd - blockStart) / LANES * LANES;
+            FloatLanes sums1 = {}, sums2 = {}, sums3 = {}, sums4 = {};
+            FloatLanes minima = minimum - FloatLanes{}, maxima = maximum - FloatLanes{};
+
+            for (size_t i = blockStart; i < lanesEnd; i += LANES) {
+                FloatLanes lanes;
+                if constexpr (std::is_same<T, int16_t>::value) {
+                    Int16Lanes lanesRaw;
+                    std::memcpy(&lanesRaw, values + i, sizeof(lanesRaw));
+                    lanes = __builtin_convertvector(lanesRaw, FloatLanes);
+                } else {
+                    std::memcpy(&lanes, values + i, sizeof(lanes));
+                }
+                const FloatLanes deviations = lanes - reference;
+                const FloatLanes squaredDeviations = deviations * deviations;
+                sums1 += deviations;
+                sums2 += squaredDeviations;
+                sums3 += squaredDeviations * deviations;
+                sums4 += squaredDeviations * squaredDeviations;
+                minima = lanes < minima ? lanes : minima;
+                maxima = lanes > maxima ? lanes : maxima;
+            }
+            for (size_t i = lanesEnd; i < blockEnd; ++i) {
+                const float value = static_cast<float>(values[i]);
+                const float deviation = value - reference;
+                sums1[0] += deviation;
+                sums2[0] += deviation * deviation;
+                sums3[0] += deviation * deviation * deviation;
+                sums4[0] += deviation * deviation * deviation * deviation;
+                minima[0] = std::min(minima[0], value);
+                maxima[0] = std::max(maxima[0], value);
+            }
+
+            for (size_t lane = 0; lane < LANES; ++lane) {
+                sums[0] += sums1[lane];
+                sums[1] += sums2[lane];
+                sums[2] += sums3[lane];
+                sums[3] += sums4[lane];
+                minimum = std::min(minimum, minima[lane]);
+                maximum = std::max(maximum, maxima[lane]);
+            }
+        }
+
+        // raw moments of the deviations, converted to central moments
+        const double moment1 = sums[0] / count;
+        const double moment2 = sums[1] / count;
+        const double moment3 = sums[2] / count;
+        const double moment4 = sums[3] / count;
+        const double variance = std::max(moment2 - moment1 * moment1, 0.0);
+        const double centralMoment3 = moment3 - 3 * moment1 * moment2 + 2 * moment1 * moment1 * moment1;
+        const double centralMoment4 = moment4 - 4 * moment1 * moment3 + 6 * moment1 * moment1 * moment2 -
+                                      3 * moment1 * moment1 * moment1 * moment1;
+        const double mean = reference + moment1;
+        const double meanSquare = std::max(variance + mean * mean, 0.0);
+
+        const float absoluteScale = std::abs(scale);
+        axisStatistics.mean = static_cast<float>(mean * scale);
+        axisStatistics.rms = static_cast<float>(std::sqrt(meanSquare) * absoluteScale);
+        axisStatistics.stdDev = static_cast<float>(std::sqrt(variance) * absoluteScale);
+        axisStatistics.peak = std::max(std::abs(minimum), std::abs(maximum)) * absoluteScale;
+        axisStatistics.peakToPeak = (maximum - minimum) * absoluteScale;
+        axisStatistics.crestFactor = axisStatistics.rms > 0 ? axisStatistics.peak / axisStatistics.rms : 0;
+        if (variance > 0) {
+            axisStatistics.skewness = static_cast<float>(centralMoment3 / (variance * std::sqrt(variance)));
+            axisStatistics.kurtosis = static_cast<float>(centralMoment4 / (variance * variance));
+        }
+        return axisStatistics;
+    }
+
+    inline static AxisStatistics computeAxisStatistics(Span<const float> values) {
+        return computeAxisStatistics(values.data(), values.size());
+    }
+
+    /**
+     * @param scale of the raw samples, see SampleConversion.hpp
+     */
+    inline static AxisStatistics computeAxisStatistics(Span<const int16_t> valuesRaw, float scale) {
+        return computeAxisStatistics(valuesRaw.data(), valuesRaw.size(), scale);
+    }
+
+    inline static AxisFeatures computeAxisFeatures(Span<const float> values) {
+        AxisFeatures axisFeatures;
+        static_cast<AxisStatistics &>(axisFeatures) = computeAxisStatistics(values);
+        return axisFeatures;
+    }
+
+    /**
+     * Adds the band energies and the highest local maxima of a spectrum to the features. The first bin (DC) is
+     * no peak.
+     * @param frequencies of the bins [Hz]
+     */
+    inline static void computeSpectralFeatures(const std::vector<float> &frequencies,
+                                               const std::vector<float> &amplitudes,
+                                               const std::vector<FrequencyBand> &bands, int spectralPeaksCount,
+                                               AxisFeatures &axisFeatures) {
+        const size_t binsCount = std::min(frequencies.size(), amplitudes.size());
+        axisFeatures.bandEnergies.assign(bands.size(), 0);
+        for (size_t i = 0; i < bands.size(); ++i) {
+            double energy = 0;
+            for (size_t bin = 0; bin < binsCount; ++bin) {
+                if (frequencies[bin] >= bands[i].min && frequencies[bin] < bands[i].max) {
+                    energy += static_cast<double>(amplitudes[bin]) * amplitudes[bin];
+                }
+            }
+            axisFeatures.bandEnergies[i] = static_cast<float>(energy);
+        }
+
+        axisFeatures.spectralPeaks.clear();
+        for (size_t bin = 1; bin < binsCount; ++bin) {
+            if (amplitudes[bin] > amplitudes[bin - 1] &&
+                (bin + 1 == binsCount || amplitudes[bin] >= amplitudes[bin + 1])) {
+                axisFeatures.spectralPeaks.push_back({frequencies[bin], amplitudes[bin]});
+            }
+        }
+        const size_t peaksCount = std::min(axisFeatures.spectralPeaks.size(),
+                                           static_cast<size_t>(std::max(spectralPeaksCount, 0)));
+        std::partial_sort(axisFeatures.spectralPeaks.begin(), axisFeatures.spectralPeaks.begin() + peaksCount,
+                          axisFeatures.spectralPeaks.end(), [](const SpectralPeak &a, const SpectralPeak &b) {
+                    return a.amplitude > b.amplitude;
+                });
+        axisFeatures.spectralPeaks.resize(peaksCount);
+    }
+}
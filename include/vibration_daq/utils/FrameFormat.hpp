@@ -0,0 +1,68 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "BinaryIO.hpp"
+#include "HashUtils.hpp"
+
+namespace vibration_daq {
+    /**
+     * The binary storage formats consist of frames: a header with type, payload length and CRC-32 of the payload,
+     * followed by the payload. Frames start at multiples of FRAME_ALIGNMENT, so that the samples in a payload
+     * can be accessed in place.
+     */
+    enum class FrameType : uint32_t {
+        SEGMENT_HEADER = 1,
+        CAPTURE = 2,
+        SEGMENT_INDEX = 3
+    };
+
+    struct FrameHeader {
+        uint32_t magic;
+        uint32_t type;
+        uint32_t length; // of the payload
+        uint32_t crc; // of the payload
+    };
+
+    const uint32_t FRAME_MAGIC = 0x4D524656; // "VFRM"
+    const size_t FRAME_ALIGNMENT = 8;
+    const uint32_t MAX_FRAME_LENGTH = 64 * 1024 * 1024;
+
+    /**
+     * @return bytes of a frame including header and padding
+     */
+    inline static size_t getFrameSize(uint32_t length) {
+        return (sizeof(FrameHeader) + length + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT * FRAME_ALIGNMENT;
+    }
+
+    inline static void appendFrame(FrameType type, const std::vector<uint8_t> &payload, std::vector<uint8_t> &buffer) {
+        FrameHeader header{FRAME_MAGIC, static_cast<uint32_t>(type), static_cast<uint32_t>(payload.size()),
+                           crc32(payload.data(), payload.size())};
+        BinaryWriter writer(buffer);
+        writer.write(header);
+        writer.writeBytes(payload.data(), payload.size());
+        writer.align(FRAME_ALIGNMENT);
+    }
+
+    /**
+     * Checks magic, length and CRC of the frame at data.
+     * @param available bytes from data on
+     * @return true if a complete and valid frame starts at data
+     */
+    inline static bool readFrame(const uint8_t *data, size_t available, FrameHeader &header) {
+        if (available < sizeof(FrameHeader)) {
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(FrameHeader));
+        if (header.magic != FRAME_MAGIC || header.length > MAX_FRAME_LENGTH ||
+            sizeof(FrameHeader) + header.length > available) {
+            return false;
+        }
+        return crc32(data + sizeof(FrameHeader), header.length) == header.crc;
+    }
+}
@@ -0,0 +1,55 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace vibration_daq {
+    /**
+     * 32bit FNV-1a hash, can be chained by passing the previous hash.
+     */
+    inline static uint32_t fnv1a(const void *data, size_t size, uint32_t hash = 0x811C9DC5) {
+        auto bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 0x01000193;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    inline static uint32_t fnv1aValue(const T &value, uint32_t hash = 0x811C9DC5) {
+        return fnv1a(&value, sizeof(T), hash);
+    }
+
+    constexpr std::array<uint32_t, 256> generateCrc32Table() {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+            }
+            table[i] = crc;
+        }
+        return table;
+    }
+
+    constexpr std::array<uint32_t, 256> CRC32_TABLE = generateCrc32Table();
+
+    /**
+     * CRC-32 (IEEE 802.3, as used by zlib), can be chained by passing the previous crc.
+     */
+    inline static uint32_t crc32(const void *data, size_t size, uint32_t crc = 0) {
+        auto bytes = static_cast<const uint8_t *>(data);
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) {
+            crc = CRC32_TABLE[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+}
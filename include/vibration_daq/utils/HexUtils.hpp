@@ -5,7 +5,9 @@
 
 #pragma once
 
-#include <iostream>
+#include <array>
+#include <cstdio>
+#include <string>
 
 namespace vibration_daq {
     /**
@@ -18,20 +20,20 @@ namespace vibration_daq {
     }
 
     inline static std::string getHexString(uint8_t num) {
-        char str[6];
-        sprintf(str, "0x%02X ", num);
+        char str[5];
+        snprintf(str, sizeof(str), "0x%02X", num);
         return str;
     }
 
     inline static std::string getHexString(uint16_t num) {
-        char str[6];
-        sprintf(str, "0x%04X ", num);
+        char str[7];
+        snprintf(str, sizeof(str), "0x%04X", num);
         return str;
     }
 
     inline static std::string getHexString(std::array<uint8_t, 2> num) {
-        char str[6];
-        sprintf(str, "0x%02X%02X ", num[0], num[1]);
+        char str[7];
+        snprintf(str, sizeof(str), "0x%02X%02X", num[0], num[1]);
         return str;
     }
 }
\ No newline at end of file
@@ -0,0 +1,54 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "../entities/RecordingMode.hpp"
+#include "Span.hpp"
+
+namespace vibration_daq {
+    const double MTC_SCALE = 0.001907349; // g per LSB
+    const double FFT_SCALE = 0.9535; // mg
+
+    /**
+     * Converts a raw sample of the sensor buffers to g (MTC) resp. mg (MFFT, AFFT).
+     * @param spectralAvgCount averages of the FFT record, ignored for MTC
+     */
+    inline static float convertVibrationValue(RecordingMode recordingMode, int16_t valueRaw, int spectralAvgCount) {
+        if (recordingMode == RecordingMode::MTC) {
+            return static_cast<float>(valueRaw) * MTC_SCALE;
+        }
+
+        // handle special case according to https://ez.analog.com/mems/f/q-a/162759/adcmxl3021-fft-conversion/372600#372600
+        if (valueRaw == 0 || spectralAvgCount <= 0) {
+            return 0.0;
+        }
+        return std::pow(2, static_cast<float>(valueRaw) / 2048) / spectralAvgCount * FFT_SCALE;
+    }
+
+    /**
+     * @return time between MTC samples [s] resp. width of the FFT bins [Hz]
+     */
+    inline static float getStepSize(RecordingMode recordingMode, int decimationFactor) {
+        if (recordingMode == RecordingMode::MTC) {
+            return 1.f / (220000.f / static_cast<float>(decimationFactor));
+        }
+        return 110000.f / static_cast<float>(decimationFactor) / 2048.f;
+    }
+
+    inline static std::vector<float> convertVibrationValues(RecordingMode recordingMode,
+                                                            Span<const int16_t> valuesRaw,
+                                                            int spectralAvgCount) {
+        std::vector<float> values;
+        values.reserve(valuesRaw.size());
+        for (const auto &valueRaw : valuesRaw) {
+            values.push_back(convertVibrationValue(recordingMode, valueRaw, spectralAvgCount));
+        }
+        return values;
+    }
+}
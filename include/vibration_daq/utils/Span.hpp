@@ -0,0 +1,53 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace vibration_daq {
+    /**
+     * Non-owning view of contiguous values, a subset of C++20 std::span.
+     */
+    template<typename T>
+    class Span {
+    private:
+        T *data_ = nullptr;
+        size_t size_ = 0;
+
+    public:
+        Span() = default;
+
+        Span(T *data, size_t size) : data_(data), size_(size) {}
+
+        template<typename U>
+        Span(const std::vector<U> &vector) : data_(vector.data()), size_(vector.size()) {}
+
+        T *data() const {
+            return data_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        T &operator[](size_t i) const {
+            return data_[i];
+        }
+
+        T *begin() const {
+            return data_;
+        }
+
+        T *end() const {
+            return data_ + size_;
+        }
+    };
+}
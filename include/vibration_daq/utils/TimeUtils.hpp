@@ -0,0 +1,31 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <ctime>
+#include "../entities/HostTimestamp.hpp"
+
+namespace vibration_daq {
+    inline static int64_t toNanoseconds(const timespec &time) {
+        return static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+    }
+
+    /**
+     * Reads both host clocks, the monotonic clock is read before and after the realtime clock and averaged.
+     */
+    inline static HostTimestamp getHostTimestamp() {
+        timespec monotonicRawBefore{}, realtime{}, monotonicRawAfter{};
+        clock_gettime(CLOCK_MONOTONIC_RAW, &monotonicRawBefore);
+        clock_gettime(CLOCK_REALTIME, &realtime);
+        clock_gettime(CLOCK_MONOTONIC_RAW, &monotonicRawAfter);
+
+        HostTimestamp hostTimestamp;
+        hostTimestamp.monotonicRawNs = toNanoseconds(monotonicRawBefore) +
+                                       (toNanoseconds(monotonicRawAfter) - toNanoseconds(monotonicRawBefore)) / 2;
+        hostTimestamp.realtimeNs = toNanoseconds(realtime);
+        return hostTimestamp;
+    }
+}
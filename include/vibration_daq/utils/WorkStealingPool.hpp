@@ -0,0 +1,88 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vibration_daq {
+    /**
+     * Runs a set of tasks on a fixed number of threads. The tasks are distributed round-robin to one queue per
+     * thread. A thread takes the tasks of its own queue in the order they were submitted; when it is empty, it steals
+     * the next task of the other queues. So tasks of very different duration, e.g. files of different size, keep all
+     * threads busy, and tasks submitted largest first are run largest first, which keeps the makespan short.
+     */
+    class WorkStealingPool {
+    private:
+        struct TaskQueue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<TaskQueue>> queues;
+        size_t nextQueue = 0;
+
+        bool takeTask(size_t threadIndex, std::function<void()> &task) {
+            {
+                TaskQueue &ownQueue = *queues[threadIndex];
+                std::lock_guard<std::mutex> lock(ownQueue.mutex);
+                if (!ownQueue.tasks.empty()) {
+                    task = std::move(ownQueue.tasks.front());
+                    ownQueue.tasks.pop_front();
+                    return true;
+                }
+            }
+            for (size_t i = 1; i < queues.size(); ++i) {
+                TaskQueue &otherQueue = *queues[(threadIndex + i) % queues.size()];
+                std::lock_guard<std::mutex> lock(otherQueue.mutex);
+                if (!otherQueue.tasks.empty()) {
+                    task = std::move(otherQueue.tasks.front());
+                    otherQueue.tasks.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    public:
+        explicit WorkStealingPool(int threadsCount) {
+            for (int i = 0; i < std::max(threadsCount, 1); ++i) {
+                queues.push_back(std::make_unique<TaskQueue>());
+            }
+        }
+
+        /**
+         * Adds a task, tasks can't be added while run() is running.
+         */
+        void submit(std::function<void()> task) {
+            queues[nextQueue]->tasks.push_back(std::move(task));
+            nextQueue = (nextQueue + 1) % queues.size();
+        }
+
+        /**
+         * Runs all submitted tasks and returns when they are done.
+         */
+        void run() {
+            std::vector<std::thread> threads;
+            for (size_t threadIndex = 0; threadIndex < queues.size(); ++threadIndex) {
+                threads.emplace_back([this, threadIndex]() {
+                    std::function<void()> task;
+                    while (takeTask(threadIndex, task)) {
+                        task();
+                    }
+                });
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+        }
+    };
+}
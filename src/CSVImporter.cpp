@@ -0,0 +1,169 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vibration_daq/CSVImporter.hpp>
+#include <vibration_daq/CaptureIndex.hpp>
+#include <vibration_daq/StorageModule.hpp>
+#include <vibration_daq/utils/FeatureUtils.hpp>
+#include <vibration_daq/utils/SampleConversion.hpp>
+#include "loguru/loguru.hpp"
+
+namespace vibration_daq {
+    bool CSVImporter::recoverMTCSamples(VibrationData &vibrationData) {
+        for (const auto &axis : vibrationData.axes) {
+            const std::vector<float> &values = vibrationData.getAxisData(axis);
+            std::vector<int16_t> &samples = vibrationData.getAxisRawData(axis);
+            samples.resize(values.size());
+            for (size_t i = 0; i < values.size(); ++i) {
+                const double sample = values[i] / MTC_SCALE;
+                const double roundedSample = std::round(sample);
+                if (std::abs(sample - roundedSample) > MAX_MTC_ERROR ||
+                    roundedSample < std::numeric_limits<int16_t>::min() ||
+                    roundedSample > std::numeric_limits<int16_t>::max()) {
+                    return false;
+                }
+                samples[i] = static_cast<int16_t>(roundedSample);
+            }
+        }
+        return true;
+    }
+
+    bool CSVImporter::recoverFFTSamples(VibrationData &vibrationData, bool spectralAvgCountKnown) {
+        // value = 2^(sample / 2048) / spectralAvgCount * FFT_SCALE, 0 is stored as 0
+        std::vector<double> exponents; // 2048 * log2(value / FFT_SCALE) of the non-zero values
+        for (const auto &axis : vibrationData.axes) {
+            for (const auto &value : vibrationData.getAxisData(axis)) {
+                if (value < 0) {
+                    return false;
+                }
+                if (value > 0) {
+                    exponents.push_back(2048 * std::log2(value / FFT_SCALE));
+                }
+            }
+        }
+
+        // mean squared distance of the first count samples to an integer, infinite if a sample is further than
+        // MAX_FFT_ERROR or out of range
+        const auto getError = [&exponents](int spectralAvgCount, size_t count) {
+            const double offset = 2048 * std::log2(static_cast<double>(spectralAvgCount));
+            count = std::min(count, exponents.size());
+            double error = 0;
+            for (size_t i = 0; i < count; ++i) {
+                const double sample = exponents[i] + offset;
+                const double roundedSample = std::round(sample);
+                const double distance = std::abs(sample - roundedSample);
+                if (distance > MAX_FFT_ERROR || roundedSample == 0 ||
+                    roundedSample < std::numeric_limits<int16_t>::min() ||
+                    roundedSample > std::numeric_limits<int16_t>::max()) {
+                    return std::numeric_limits<double>::infinity();
+                }
+                error += distance * distance;
+            }
+            return count > 0 ? error / count : 0;
+        };
+
+        CaptureMetadata &metadata = vibrationData.metadata;
+        if (spectralAvgCountKnown) {
+            if (std::isinf(getError(metadata.spectralAvgCount, exponents.size()))) {
+                return false;
+            }
+        } else {
+            // A wrong count shifts all samples by the same fraction, the count with the smallest error is taken.
+            // Counts with a ratio of a power of 2 fit alike and give the same values, the smallest is taken. The
+            // counts are searched on a few samples and the remaining candidates compared on all.
+            double smallestError = std::numeric_limits<double>::infinity();
+            int bestSpectralAvgCount = 0;
+            for (int spectralAvgCount = 1; spectralAvgCount <= MAX_SPECTRAL_AVG_COUNT; ++spectralAvgCount) {
+                if (std::isinf(getError(spectralAvgCount, SEARCH_SAMPLES_COUNT))) {
+                    continue;
+                }
+                const double error = getError(spectralAvgCount, exponents.size());
+                if (error < smallestError - 1e-9) {
+                    smallestError = error;
+                    bestSpectralAvgCount = spectralAvgCount;
+                }
+            }
+            if (bestSpectralAvgCount == 0) {
+                return false;
+            }
+            metadata.spectralAvgCount = bestSpectralAvgCount;
+        }
+
+        const double offset = 2048 * std::log2(static_cast<double>(metadata.spectralAvgCount));
+        for (const auto &axis : vibrationData.axes) {
+            const std::vector<float> &values = vibrationData.getAxisData(axis);
+            std::vector<int16_t> &samples = vibrationData.getAxisRawData(axis);
+            samples.resize(values.size());
+            for (size_t i = 0; i < values.size(); ++i) {
+                samples[i] = values[i] == 0 ? 0 : static_cast<int16_t>(
+                        std::round(2048 * std::log2(values[i] / FFT_SCALE) + offset));
+            }
+        }
+        return true;
+    }
+
+    bool CSVImporter::importFile(const fs::path &dataFilePath, CaptureRecord &captureRecord) {
+        CaptureLocation captureLocation;
+        if (!CaptureIndex::parseCSVFileName(dataFilePath.filename().string(), captureLocation)) {
+            LOG_S(WARNING) << "Not a CSV file of the StorageModule: " << dataFilePath;
+            return false;
+        }
+
+        VibrationData &vibrationData = captureRecord.vibrationData;
+        vibrationData.metadata = CaptureMetadata();
+        if (!StorageModule::readCSVFile(dataFilePath.string(), vibrationData)) {
+            LOG_S(WARNING) << "Could not read CSV file: " << dataFilePath;
+            return false;
+        }
+        if ((vibrationData.recordingMode == RecordingMode::MTC) !=
+            (captureLocation.recordingMode == RecordingMode::MTC)) {
+            LOG_S(WARNING) << "Recording mode of file name and header differ: " << dataFilePath;
+            return false;
+        }
+        // the header doesn't distinguish MFFT and AFFT
+        vibrationData.recordingMode = captureLocation.recordingMode;
+        captureRecord.sensorName = captureLocation.sensorName;
+        captureRecord.triggerTimestamp = HostTimestamp();
+        captureRecord.triggerTimestamp.realtimeNs = captureLocation.triggerRealtimeNs;
+
+        fs::path metadataFilePath = dataFilePath;
+        metadataFilePath.replace_extension(".yaml");
+        std::error_code errorCode;
+        CaptureMetadata &metadata = vibrationData.metadata;
+        const bool hasMetadata = fs::exists(metadataFilePath, errorCode) &&
+                                 StorageModule::readCaptureMetadata(metadataFilePath.string(), metadata,
+                                                                    captureRecord.triggerTimestamp);
+        if (!hasMetadata && vibrationData.stepSize > 0) {
+            metadata.decimationFactor = static_cast<int>(std::lround(
+                    vibrationData.recordingMode == RecordingMode::MTC ? vibrationData.stepSize * 220000.f
+                                                                      : 110000.f / vibrationData.stepSize / 2048.f));
+        }
+        // the steps in the file have 6 significant digits, the step size of the sensor module is exact
+        if (metadata.decimationFactor > 0 && !vibrationData.stepAxis.empty()) {
+            vibrationData.stepSize = getStepSize(vibrationData.recordingMode, metadata.decimationFactor);
+            vibrationData.binOffset = static_cast<int>(std::lround(vibrationData.stepAxis.front() /
+                                                                   vibrationData.stepSize));
+        }
+
+        const bool recovered = vibrationData.recordingMode == RecordingMode::MTC
+                               ? recoverMTCSamples(vibrationData)
+                               : recoverFFTSamples(vibrationData, hasMetadata && metadata.spectralAvgCount > 0);
+        if (!recovered) {
+            LOG_S(WARNING) << "Could not recover the raw samples of " << dataFilePath;
+            return false;
+        }
+        // metadata files written before the statistics were computed on read-out
+        if (vibrationData.recordingMode == RecordingMode::MTC && vibrationData.metadata.statistics.empty()) {
+            for (const auto &axis : vibrationData.axes) {
+                vibrationData.metadata.statistics[axis] = computeAxisStatistics(vibrationData.getAxisRawData(axis),
+                                                                                MTC_SCALE);
+            }
+        }
+        return true;
+    }
+}
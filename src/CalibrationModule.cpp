@@ -0,0 +1,150 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <date/date.h>
+#include "vibration_daq/CalibrationModule.hpp"
+#include "loguru/loguru.hpp"
+
+namespace vibration_daq {
+    std::string CalibrationModule::getSerialIdKey(uint16_t serialId) {
+        char key[7];
+        sprintf(key, "0x%04X", serialId);
+        return key;
+    }
+
+    bool CalibrationModule::setup(const AutonullConfig &autonullConfig) {
+        this->autonullConfig = autonullConfig;
+
+        if (autonullConfig.calibrationFile.empty() || !fs::exists(autonullConfig.calibrationFile)) {
+            calibrationsNode = YAML::Node(YAML::NodeType::Map);
+            return true;
+        }
+
+        // a damaged file only costs an autonull, so the sensors are still started
+        try {
+            calibrationsNode = YAML::LoadFile(autonullConfig.calibrationFile);
+        } catch (const YAML::Exception &e) {
+            LOG_S(ERROR) << "Could not parse calibration file, starting without calibrations: " << e.what();
+            calibrationsNode = YAML::Node(YAML::NodeType::Null);
+        }
+        if (!calibrationsNode.IsMap()) {
+            LOG_IF_S(ERROR, !calibrationsNode.IsNull()) << "Calibration file is no map, starting without calibrations.";
+            calibrationsNode = YAML::Node(YAML::NodeType::Map);
+        }
+        return true;
+    }
+
+    bool CalibrationModule::readCalibration(uint16_t serialId, Calibration &calibration) const {
+        std::lock_guard<std::mutex> lock(calibrationsMutex);
+        const YAML::Node node = calibrationsNode[getSerialIdKey(serialId)];
+        if (!node.IsMap()) {
+            return false;
+        }
+
+        calibration.serialId = serialId;
+        return YAML::convert<uint16_t>::decode(node["x_anull"], calibration.anull[0]) &&
+               YAML::convert<uint16_t>::decode(node["y_anull"], calibration.anull[1]) &&
+               YAML::convert<uint16_t>::decode(node["z_anull"], calibration.anull[2]) &&
+               YAML::convert<std::string>::decode(node["timestamp"], calibration.timestamp) &&
+               YAML::convert<uint32_t>::decode(node["flash_write_count"], calibration.flashWriteCount);
+    }
+
+    bool CalibrationModule::storeCalibration(const Calibration &calibration) {
+        if (autonullConfig.calibrationFile.empty()) {
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(calibrationsMutex);
+
+        YAML::Node node;
+        node["x_anull"] = calibration.anull[0];
+        node["y_anull"] = calibration.anull[1];
+        node["z_anull"] = calibration.anull[2];
+        node["timestamp"] = calibration.timestamp;
+        node["flash_write_count"] = calibration.flashWriteCount;
+        calibrationsNode[getSerialIdKey(calibration.serialId)] = node;
+
+        YAML::Emitter emitter;
+        emitter << calibrationsNode;
+        const std::string content = std::string(emitter.c_str()) + "\n";
+
+        // replaced by rename, so a power loss leaves either the old or the new file
+        const fs::path calibrationPath = autonullConfig.calibrationFile;
+        const std::string temporaryPath = autonullConfig.calibrationFile + ".tmp";
+        int fd = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            LOG_S(ERROR) << "Could not create calibration file " << temporaryPath << ": " << std::strerror(errno);
+            return false;
+        }
+        const bool written = ::write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size()) &&
+                             ::fsync(fd) == 0;
+        ::close(fd);
+
+        std::error_code errorCode;
+        if (written) {
+            fs::rename(temporaryPath, calibrationPath, errorCode);
+        }
+        if (!written || errorCode) {
+            LOG_S(ERROR) << "Could not write calibration file: " << autonullConfig.calibrationFile;
+            fs::remove(temporaryPath, errorCode);
+            return false;
+        }
+
+        const fs::path directory = calibrationPath.has_parent_path() ? calibrationPath.parent_path() : ".";
+        int directoryFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (directoryFd >= 0) {
+            ::fsync(directoryFd);
+            ::close(directoryFd);
+        }
+        return true;
+    }
+
+    bool CalibrationModule::calibrate(VibrationSensorModule &vibrationSensorModule) {
+        const std::string &sensorName = vibrationSensorModule.getSensorName();
+        if (autonullConfig.mode == AutonullMode::OFF) {
+            return true;
+        }
+
+        Calibration calibration;
+        calibration.serialId = vibrationSensorModule.readSerialId();
+
+        if (autonullConfig.mode == AutonullMode::AUTO) {
+            Calibration storedCalibration;
+            bool valid = readCalibration(calibration.serialId, storedCalibration) &&
+                         storedCalibration.anull == vibrationSensorModule.readAutonullCorrection();
+
+            if (valid && autonullConfig.driftThreshold > 0) {
+                for (const auto &drift : vibrationSensorModule.measureStatistics()) {
+                    if (std::abs(static_cast<int16_t>(drift)) > autonullConfig.driftThreshold) {
+                        LOG_S(INFO) << sensorName << ": drift " << static_cast<int16_t>(drift)
+                                    << " exceeds threshold, recalibrating.";
+                        valid = false;
+                    }
+                }
+            }
+
+            if (valid) {
+                LOG_S(INFO) << sensorName << ": valid calibration from " << storedCalibration.timestamp
+                            << ", skipping autonull.";
+                return true;
+            }
+        }
+
+        LOG_S(INFO) << sensorName << ": triggering autonull.";
+        calibration.anull = vibrationSensorModule.triggerAutonull();
+        calibration.timestamp = date::format("%FT%TZ", date::floor<std::chrono::seconds>(std::chrono::system_clock::now()));
+        calibration.flashWriteCount = vibrationSensorModule.readFlashWriteCount();
+
+        if (!storeCalibration(calibration)) {
+            LOG_S(WARNING) << sensorName << ": could not persist calibration, autonull will run again on next start.";
+        }
+        return true;
+    }
+}
@@ -0,0 +1,538 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <date/date.h>
+#include "vibration_daq/CaptureIndex.hpp"
+#include "vibration_daq/SegmentArchive.hpp"
+#include "vibration_daq/StorageModule.hpp"
+#include "loguru/loguru.hpp"
+
+namespace vibration_daq {
+    namespace {
+        const std::string RECORDS_EXTENSION = ".vidx";
+        const std::string FILES_EXTENSION = ".files";
+
+        /**
+         * flock of the index directory, released when destroyed.
+         */
+        class IndexLock {
+        private:
+            int fd;
+
+        public:
+            IndexLock(const fs::path &indexDirectory, int operation) {
+                fd = ::open(indexDirectory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                if (fd >= 0 && ::flock(fd, operation) != 0) {
+                    ::close(fd);
+                    fd = -1;
+                }
+            }
+
+            IndexLock(const IndexLock &) = delete;
+
+            IndexLock &operator=(const IndexLock &) = delete;
+
+            ~IndexLock() {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+            }
+
+            bool isLocked() const {
+                return fd >= 0;
+            }
+        };
+    }
+
+    fs::path CaptureIndex::getRecordsPath(const std::string &sensorName) const {
+        return indexDirectory / (sensorName + RECORDS_EXTENSION);
+    }
+
+    fs::path CaptureIndex::getFilesPath(const std::string &sensorName) const {
+        return indexDirectory / (sensorName + FILES_EXTENSION);
+    }
+
+    bool CaptureIndex::setup(const fs::path &storageDirectory) {
+        this->storageDirectory = storageDirectory;
+        indexDirectory = storageDirectory / INDEX_DIRECTORY;
+        sensorIndices.clear();
+
+        if (!fs::is_directory(indexDirectory)) {
+            LOG_S(INFO) << "No capture index found, building it.";
+            return rebuild();
+        }
+        bool loaded;
+        {
+            IndexLock indexLock(indexDirectory, LOCK_SH);
+            loaded = indexLock.isLocked();
+            for (const auto &sensorName : getSensorNames()) {
+                SensorIndex sensorIndex;
+                loaded = loaded && loadSensorIndex(sensorName, sensorIndex);
+            }
+        }
+        if (!loaded) {
+            LOG_S(INFO) << "Capture index is damaged or of an older version, rebuilding it.";
+            return rebuild();
+        }
+        return true;
+    }
+
+    CaptureIndex::FileState CaptureIndex::getFileState(const fs::path &path) {
+        struct stat fileStat{};
+        if (::stat(path.c_str(), &fileStat) != 0) {
+            return FileState();
+        }
+        return {static_cast<uint64_t>(fileStat.st_ino), static_cast<uint64_t>(fileStat.st_size),
+                static_cast<int64_t>(fileStat.st_mtim.tv_sec) * 1000000000 + fileStat.st_mtim.tv_nsec};
+    }
+
+    void CaptureIndex::updateFileStates(const std::string &sensorName, SensorIndex &sensorIndex) const {
+        sensorIndex.recordsFileState = getFileState(getRecordsPath(sensorName));
+        sensorIndex.filesFileState = getFileState(getFilesPath(sensorName));
+    }
+
+    bool CaptureIndex::readFileName(int fd, uint32_t fileId, std::string &fileName) {
+        char name[FILE_NAME_SIZE];
+        if (::pread(fd, name, sizeof(name), static_cast<off_t>(fileId) * FILE_NAME_SIZE) != sizeof(name)) {
+            return false;
+        }
+        fileName.assign(name, strnlen(name, sizeof(name)));
+        return true;
+    }
+
+    std::string CaptureIndex::getCSVFileName(const std::string &sensorName, RecordingMode recordingMode,
+                                             int64_t triggerRealtimeNs) {
+        HostTimestamp triggerTimestamp;
+        triggerTimestamp.realtimeNs = triggerRealtimeNs;
+        return StorageModule::getCSVFileStem(recordingMode, sensorName, triggerTimestamp) + ".csv";
+    }
+
+    bool CaptureIndex::loadSensorIndex(const std::string &sensorName, SensorIndex &sensorIndex) const {
+        sensorIndex = SensorIndex();
+        updateFileStates(sensorName, sensorIndex);
+
+        int filesFd = ::open(getFilesPath(sensorName).c_str(), O_RDONLY | O_CLOEXEC);
+        if (filesFd >= 0) {
+            // a torn file record at the end is ignored
+            sensorIndex.filesCount = static_cast<uint32_t>(::lseek(filesFd, 0, SEEK_END) / FILE_NAME_SIZE);
+            const bool read = sensorIndex.filesCount == 0 ||
+                              readFileName(filesFd, sensorIndex.filesCount - 1, sensorIndex.lastFileName);
+            ::close(filesFd);
+            if (!read) {
+                return false;
+            }
+        } else if (errno != ENOENT) {
+            return false;
+        }
+
+        int fd = ::open(getRecordsPath(sensorName).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return errno == ENOENT;
+        }
+        const off_t fileSize = ::lseek(fd, 0, SEEK_END);
+        IndexFileHeader header{};
+        bool loaded = fileSize >= static_cast<off_t>(sizeof(header)) &&
+                      ::pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+                      header.magic == MAGIC && header.version == VERSION && header.recordSize == sizeof(IndexRecord);
+        if (loaded) {
+            // a torn record at the end is ignored
+            sensorIndex.recordsCount = (fileSize - sizeof(header)) / sizeof(IndexRecord);
+            IndexRecord lastRecord{};
+            if (sensorIndex.recordsCount > 0) {
+                loaded = ::pread(fd, &lastRecord, sizeof(lastRecord),
+                                 sizeof(header) + (sensorIndex.recordsCount - 1) * sizeof(IndexRecord)) ==
+                         sizeof(lastRecord);
+                sensorIndex.lastTriggerRealtimeNs = lastRecord.triggerRealtimeNs;
+            }
+        }
+        ::close(fd);
+        return loaded;
+    }
+
+    std::optional<uint32_t> CaptureIndex::getFileId(SensorIndex &sensorIndex, const CaptureLocation &captureLocation) {
+        const std::string &fileName = captureLocation.fileName;
+        if (fileName == getCSVFileName(captureLocation.sensorName, captureLocation.recordingMode,
+                                       captureLocation.triggerRealtimeNs)) {
+            return CSV_FILE_ID;
+        }
+        // a file is added again if it recurs later, its captures are still found by either id
+        if (sensorIndex.filesCount > 0 && fileName == sensorIndex.lastFileName) {
+            return sensorIndex.filesCount - 1;
+        }
+        if (fileName.empty() || fileName.size() >= FILE_NAME_SIZE || sensorIndex.filesCount >= CSV_FILE_ID) {
+            return std::nullopt;
+        }
+
+        int fd = ::open(getFilesPath(captureLocation.sensorName).c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return std::nullopt;
+        }
+        char name[FILE_NAME_SIZE] = {};
+        fileName.copy(name, fileName.size());
+        // overwrites a torn record of a previous crash
+        const off_t offset = static_cast<off_t>(sensorIndex.filesCount) * FILE_NAME_SIZE;
+        const bool added = ::pwrite(fd, name, sizeof(name), offset) == sizeof(name) &&
+                           ::ftruncate(fd, offset + sizeof(name)) == 0;
+        ::close(fd);
+        if (!added) {
+            return std::nullopt;
+        }
+        sensorIndex.lastFileName = fileName;
+        return sensorIndex.filesCount++;
+    }
+
+    bool CaptureIndex::writeRecords(const std::string &sensorName, std::vector<IndexRecord> &records) const {
+        std::stable_sort(records.begin(), records.end(), [](const IndexRecord &a, const IndexRecord &b) {
+            return a.triggerRealtimeNs < b.triggerRealtimeNs;
+        });
+
+        const fs::path recordsPath = getRecordsPath(sensorName);
+        const fs::path temporaryPath = recordsPath.string() + ".tmp";
+        std::ofstream recordsFile(temporaryPath, std::ios::binary | std::ios::trunc);
+        IndexFileHeader header{MAGIC, VERSION, sizeof(IndexRecord)};
+        recordsFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        recordsFile.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(IndexRecord));
+        recordsFile.close();
+        if (!recordsFile) {
+            LOG_S(ERROR) << "Could not write capture index: " << temporaryPath;
+            return false;
+        }
+
+        std::error_code errorCode;
+        fs::rename(temporaryPath, recordsPath, errorCode);
+        return !errorCode;
+    }
+
+    bool CaptureIndex::add(const CaptureLocation &captureLocation) {
+        IndexLock indexLock(indexDirectory, LOCK_EX);
+        if (!indexLock.isLocked()) {
+            LOG_S(WARNING) << "Could not lock capture index, rebuilding it.";
+            return rebuild();
+        }
+
+        const std::string &sensorName = captureLocation.sensorName;
+        auto sensorIndexIt = sensorIndices.find(sensorName);
+        // e.g. rebuilt by vibration_daq_query
+        if (sensorIndexIt != sensorIndices.end() &&
+            (!(getFileState(getRecordsPath(sensorName)) == sensorIndexIt->second.recordsFileState) ||
+             !(getFileState(getFilesPath(sensorName)) == sensorIndexIt->second.filesFileState))) {
+            LOG_S(INFO) << "Capture index of " << sensorName << " was changed by another process, reloading it.";
+            sensorIndices.erase(sensorIndexIt);
+            sensorIndexIt = sensorIndices.end();
+        }
+        if (sensorIndexIt == sensorIndices.end()) {
+            SensorIndex sensorIndex;
+            if (!loadSensorIndex(sensorName, sensorIndex)) {
+                LOG_S(WARNING) << "Capture index of " << sensorName << " is damaged, rebuilding it.";
+                return rebuildLocked();
+            }
+            sensorIndexIt = sensorIndices.emplace(sensorName, sensorIndex).first;
+        }
+        SensorIndex &sensorIndex = sensorIndexIt->second;
+
+        const auto fileId = getFileId(sensorIndex, captureLocation);
+        if (!fileId) {
+            LOG_S(ERROR) << "Could not add file to capture index: " << captureLocation.fileName;
+            return false;
+        }
+        IndexRecord record{captureLocation.triggerRealtimeNs, captureLocation.offset, *fileId,
+                           static_cast<uint8_t>(captureLocation.recordingMode), {}};
+
+        if (sensorIndex.recordsCount > 0 && record.triggerRealtimeNs < sensorIndex.lastTriggerRealtimeNs) {
+            // e.g. the wall clock was set back, rare enough to rewrite the index
+            std::vector<IndexRecord> records(sensorIndex.recordsCount);
+            std::ifstream recordsFile(getRecordsPath(sensorName), std::ios::binary);
+            recordsFile.seekg(sizeof(IndexFileHeader));
+            recordsFile.read(reinterpret_cast<char *>(records.data()), records.size() * sizeof(IndexRecord));
+            if (!recordsFile) {
+                return false;
+            }
+            records.push_back(record);
+            if (!writeRecords(sensorName, records)) {
+                return false;
+            }
+            sensorIndex.recordsCount = records.size();
+            sensorIndex.lastTriggerRealtimeNs = records.back().triggerRealtimeNs;
+            updateFileStates(sensorName, sensorIndex);
+            return true;
+        }
+
+        int fd = ::open(getRecordsPath(sensorName).c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            LOG_S(ERROR) << "Could not open capture index of " << sensorName << ": " << std::strerror(errno);
+            return false;
+        }
+        bool added = true;
+        if (sensorIndex.recordsCount == 0) {
+            IndexFileHeader header{MAGIC, VERSION, sizeof(IndexRecord)};
+            added = ::pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+        }
+        // overwrites a torn record of a previous crash
+        const off_t offset = sizeof(IndexFileHeader) + sensorIndex.recordsCount * sizeof(IndexRecord);
+        added = added && ::pwrite(fd, &record, sizeof(record), offset) == sizeof(record) &&
+                ::ftruncate(fd, offset + sizeof(record)) == 0;
+        ::close(fd);
+        if (!added) {
+            LOG_S(ERROR) << "Could not add capture to index of " << sensorName;
+            return false;
+        }
+
+        sensorIndex.recordsCount++;
+        sensorIndex.lastTriggerRealtimeNs = record.triggerRealtimeNs;
+        updateFileStates(sensorName, sensorIndex);
+        return true;
+    }
+
+    bool CaptureIndex::query(const std::string &sensorName, int64_t fromRealtimeNs, int64_t toRealtimeNs,
+                             const std::optional<RecordingMode> &recordingMode,
+                             std::vector<CaptureLocation> &captureLocations) const {
+        if (sensorName.empty()) {
+            for (const auto &name : getSensorNames()) {
+                if (!query(name, fromRealtimeNs, toRealtimeNs, recordingMode, captureLocations)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        IndexLock indexLock(indexDirectory, LOCK_SH);
+        SensorIndex sensorIndex;
+        if (!indexLock.isLocked() || !loadSensorIndex(sensorName, sensorIndex)) {
+            return false;
+        }
+
+        int fd = ::open(getRecordsPath(sensorName).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return sensorIndex.recordsCount == 0;
+        }
+        auto readRecord = [fd](uint64_t i, IndexRecord &record) {
+            return ::pread(fd, &record, sizeof(record), sizeof(IndexFileHeader) + i * sizeof(IndexRecord)) ==
+                   sizeof(record);
+        };
+
+        // lower bound of fromRealtimeNs
+        uint64_t first = 0;
+        uint64_t count = sensorIndex.recordsCount;
+        IndexRecord record{};
+        while (count > 0) {
+            const uint64_t step = count / 2;
+            if (!readRecord(first + step, record)) {
+                ::close(fd);
+                return false;
+            }
+            if (record.triggerRealtimeNs < fromRealtimeNs) {
+                first += step + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+
+        // only the file records of the found captures are read, files removed by the retention manager are
+        // skipped, checked once per file
+        int filesFd = ::open(getFilesPath(sensorName).c_str(), O_RDONLY | O_CLOEXEC);
+        std::map<uint32_t, std::optional<std::string>> existingFileNames;
+        for (uint64_t i = first; i < sensorIndex.recordsCount && readRecord(i, record); ++i) {
+            if (record.triggerRealtimeNs >= toRealtimeNs) {
+                break;
+            }
+            const auto recordRecordingMode = static_cast<RecordingMode>(record.recordingMode);
+            if (recordingMode && recordRecordingMode != *recordingMode) {
+                continue;
+            }
+
+            std::string fileName;
+            if (record.fileId == CSV_FILE_ID) {
+                fileName = getCSVFileName(sensorName, recordRecordingMode, record.triggerRealtimeNs);
+                if (!fs::exists(storageDirectory / fileName)) {
+                    continue;
+                }
+            } else {
+                auto fileNameIt = existingFileNames.find(record.fileId);
+                if (fileNameIt == existingFileNames.end()) {
+                    std::optional<std::string> existingFileName;
+                    if (record.fileId < sensorIndex.filesCount && readFileName(filesFd, record.fileId, fileName)) {
+                        const fs::path filePath = storageDirectory / fileName;
+                        if (fs::exists(filePath) || fs::exists(filePath.string() + SegmentArchive::OPEN_EXTENSION)) {
+                            existingFileName = fileName;
+                        }
+                    }
+                    fileNameIt = existingFileNames.emplace(record.fileId, existingFileName).first;
+                }
+                if (!fileNameIt->second) {
+                    continue;
+                }
+                fileName = *fileNameIt->second;
+            }
+
+            CaptureLocation captureLocation;
+            captureLocation.sensorName = sensorName;
+            captureLocation.recordingMode = recordRecordingMode;
+            captureLocation.triggerRealtimeNs = record.triggerRealtimeNs;
+            captureLocation.fileName = fileName;
+            captureLocation.offset = record.offset;
+            captureLocations.push_back(captureLocation);
+        }
+        if (filesFd >= 0) {
+            ::close(filesFd);
+        }
+        ::close(fd);
+        return true;
+    }
+
+    bool CaptureIndex::rebuild() {
+        std::error_code errorCode;
+        fs::create_directories(indexDirectory, errorCode);
+        // the directory is kept, as the lock is taken on it
+        IndexLock indexLock(indexDirectory, LOCK_EX);
+        if (!indexLock.isLocked()) {
+            LOG_S(ERROR) << "Could not lock index directory " << indexDirectory << ": " << std::strerror(errno);
+            return false;
+        }
+        return rebuildLocked();
+    }
+
+    bool CaptureIndex::rebuildLocked() {
+        std::error_code errorCode;
+        for (const auto &entry : fs::directory_iterator(indexDirectory, errorCode)) {
+            fs::remove_all(entry.path(), errorCode);
+        }
+        sensorIndices.clear();
+
+        std::map<std::string, std::vector<CaptureLocation>> captureLocations; // per sensor
+        for (const auto &entry : fs::directory_iterator(storageDirectory)) {
+            if (!entry.is_regular_file()) {
+                continue;
+            }
+            const fs::path &path = entry.path();
+            CaptureLocation captureLocation;
+
+            // CSV files not yet renamed by a batched sync are indexed with their final name
+            fs::path csvPath = path;
+            if (path.extension() == StorageModule::TEMPORARY_EXTENSION) {
+                csvPath.replace_extension();
+            }
+            if (csvPath.extension() == ".csv" && parseCSVFileName(csvPath.filename().string(), captureLocation)) {
+                captureLocations[captureLocation.sensorName].push_back(captureLocation);
+                continue;
+            }
+
+            fs::path segmentPath = path;
+            if (path.extension() == SegmentArchive::OPEN_EXTENSION) {
+                segmentPath.replace_extension();
+            }
+            if (segmentPath.extension() != SegmentArchive::SEGMENT_EXTENSION) {
+                continue;
+            }
+            std::vector<SegmentIndexEntry> segmentIndex;
+            if (!SegmentArchive::readHeader(path, captureLocation.sensorName) ||
+                !SegmentArchive::readIndex(path, segmentIndex)) {
+                LOG_S(WARNING) << "Skipping unreadable segment: " << path;
+                continue;
+            }
+            captureLocation.fileName = segmentPath.filename().string();
+            for (const auto &indexEntry : segmentIndex) {
+                captureLocation.recordingMode = indexEntry.recordingMode;
+                captureLocation.triggerRealtimeNs = indexEntry.triggerRealtimeNs;
+                captureLocation.offset = indexEntry.offset;
+                captureLocations[captureLocation.sensorName].push_back(captureLocation);
+            }
+        }
+
+        size_t capturesCount = 0;
+        for (auto &[sensorName, sensorCaptureLocations] : captureLocations) {
+            // a CSV file renamed while listing is seen twice
+            const auto key = [](const CaptureLocation &captureLocation) {
+                return std::tie(captureLocation.triggerRealtimeNs, captureLocation.fileName, captureLocation.offset);
+            };
+            std::sort(sensorCaptureLocations.begin(), sensorCaptureLocations.end(),
+                      [&key](const CaptureLocation &a, const CaptureLocation &b) { return key(a) < key(b); });
+            sensorCaptureLocations.erase(std::unique(sensorCaptureLocations.begin(), sensorCaptureLocations.end(),
+                                                     [&key](const CaptureLocation &a, const CaptureLocation &b) {
+                                                         return key(a) == key(b);
+                                                     }), sensorCaptureLocations.end());
+
+            SensorIndex &sensorIndex = sensorIndices[sensorName];
+            std::vector<IndexRecord> records;
+            records.reserve(sensorCaptureLocations.size());
+            for (const auto &captureLocation : sensorCaptureLocations) {
+                const auto fileId = getFileId(sensorIndex, captureLocation);
+                if (!fileId) {
+                    return false;
+                }
+                records.push_back({captureLocation.triggerRealtimeNs, captureLocation.offset, *fileId,
+                                   static_cast<uint8_t>(captureLocation.recordingMode), {}});
+            }
+            if (!writeRecords(sensorName, records)) {
+                return false;
+            }
+            sensorIndex.recordsCount = records.size();
+            sensorIndex.lastTriggerRealtimeNs = records.empty() ? 0 : records.back().triggerRealtimeNs;
+            updateFileStates(sensorName, sensorIndex);
+            capturesCount += records.size();
+        }
+
+        LOG_S(INFO) << "Built capture index of " << capturesCount << " captures.";
+        return true;
+    }
+
+    std::vector<std::string> CaptureIndex::getSensorNames() const {
+        std::vector<std::string> sensorNames;
+        std::error_code errorCode;
+        for (const auto &entry : fs::directory_iterator(indexDirectory, errorCode)) {
+            if (entry.path().extension() == RECORDS_EXTENSION) {
+                sensorNames.push_back(entry.path().stem().string());
+            }
+        }
+        std::sort(sensorNames.begin(), sensorNames.end());
+        return sensorNames;
+    }
+
+    bool CaptureIndex::parseCSVFileName(const std::string &fileName, CaptureLocation &captureLocation) {
+        // vibration_data_<mode>_<%FT%H_%M_%S with ms>_<sensor>.csv
+        const std::string prefix = "vibration_data_";
+        const std::string extension = ".csv";
+        const size_t timestampLength = 23;
+        if (fileName.size() <= prefix.size() + extension.size() || fileName.compare(0, prefix.size(), prefix) != 0 ||
+            fileName.compare(fileName.size() - extension.size(), extension.size(), extension) != 0) {
+            return false;
+        }
+
+        const size_t modeEnd = fileName.find('_', prefix.size());
+        if (modeEnd == std::string::npos ||
+            !Enum::convert(fileName.substr(prefix.size(), modeEnd - prefix.size()), captureLocation.recordingMode)) {
+            return false;
+        }
+
+        const size_t sensorStart = modeEnd + 1 + timestampLength + 1;
+        if (sensorStart >= fileName.size() - extension.size() || fileName[sensorStart - 1] != '_') {
+            return false;
+        }
+
+        std::istringstream timestampStream(fileName.substr(modeEnd + 1, timestampLength));
+        date::sys_time<std::chrono::milliseconds> timestamp;
+        timestampStream >> date::parse("%FT%H_%M_%S", timestamp);
+        if (timestampStream.fail()) {
+            return false;
+        }
+
+        captureLocation.sensorName = fileName.substr(sensorStart, fileName.size() - extension.size() - sensorStart);
+        captureLocation.triggerRealtimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                timestamp.time_since_epoch()).count();
+        captureLocation.fileName = fileName;
+        captureLocation.offset = 0;
+        return true;
+    }
+}
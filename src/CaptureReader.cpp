@@ -0,0 +1,151 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vibration_daq/CaptureReader.hpp>
+#include <vibration_daq/CaptureSerializer.hpp>
+#include <vibration_daq/SegmentArchive.hpp>
+#include <vibration_daq/utils/FrameFormat.hpp>
+#include <vibration_daq/utils/SampleConversion.hpp>
+#include "loguru/loguru.hpp"
+
+namespace vibration_daq {
+    CaptureReader::~CaptureReader() {
+        close();
+    }
+
+    bool CaptureReader::open(const fs::path &segmentPath, bool verifyChecksums_) {
+        close();
+        verifyChecksums = verifyChecksums_;
+
+        if (!SegmentArchive::readIndex(segmentPath, index)) {
+            LOG_S(ERROR) << "Could not read index of segment " << segmentPath;
+            return false;
+        }
+
+        fd = ::open(segmentPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            LOG_S(ERROR) << "Could not open segment " << segmentPath << ": " << std::strerror(errno);
+            return false;
+        }
+        const off_t fileSize = ::lseek(fd, 0, SEEK_END);
+        if (fileSize <= 0) {
+            LOG_S(ERROR) << "Could not get size of segment " << segmentPath;
+            close();
+            return false;
+        }
+
+        void *address = ::mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            LOG_S(ERROR) << "Could not map segment " << segmentPath << ": " << std::strerror(errno);
+            close();
+            return false;
+        }
+        mapping = static_cast<const uint8_t *>(address);
+        mappingSize = fileSize;
+        // captures are mostly read in order, the kernel reads ahead
+        ::madvise(address, mappingSize, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    void CaptureReader::close() {
+        if (mapping) {
+            ::munmap(const_cast<uint8_t *>(mapping), mappingSize);
+            mapping = nullptr;
+            mappingSize = 0;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+        index.clear();
+    }
+
+    size_t CaptureReader::getCapturesCount() const {
+        return index.size();
+    }
+
+    const std::vector<SegmentIndexEntry> &CaptureReader::getIndex() const {
+        return index;
+    }
+
+    bool CaptureReader::readCapture(size_t i, CaptureView &captureView) const {
+        return i < index.size() && readCaptureAt(index[i].offset, captureView);
+    }
+
+    const uint8_t *CaptureReader::getCapturePayload(uint64_t offset, uint32_t &length) const {
+        if (!mapping || offset % FRAME_ALIGNMENT != 0 || offset >= mappingSize) {
+            return nullptr;
+        }
+
+        const uint8_t *frame = mapping + offset;
+        const size_t available = mappingSize - offset;
+        FrameHeader header{};
+        if (verifyChecksums) {
+            if (!readFrame(frame, available, header)) {
+                return nullptr;
+            }
+        } else {
+            if (available < sizeof(FrameHeader)) {
+                return nullptr;
+            }
+            std::memcpy(&header, frame, sizeof(FrameHeader));
+            if (header.magic != FRAME_MAGIC || sizeof(FrameHeader) + header.length > available) {
+                return nullptr;
+            }
+        }
+        if (static_cast<FrameType>(header.type) != FrameType::CAPTURE) {
+            return nullptr;
+        }
+        length = header.length;
+        return frame + sizeof(FrameHeader);
+    }
+
+    bool CaptureReader::readCaptureAt(uint64_t offset, CaptureView &captureView) const {
+        uint32_t length;
+        const uint8_t *payload = getCapturePayload(offset, length);
+        return payload && CaptureSerializer::readView(payload, length, captureView);
+    }
+
+    bool CaptureReader::readCapture(size_t i, CaptureRecord &captureRecord) const {
+        uint32_t length;
+        const uint8_t *payload = i < index.size() ? getCapturePayload(index[i].offset, length) : nullptr;
+        return payload && CaptureSerializer::deserialize(payload, length, captureRecord);
+    }
+
+    Span<const int16_t> CaptureReader::getAxisRawData(const CaptureView &captureView, const Axis &axis,
+                                                      std::vector<int16_t> &buffer) {
+        const CaptureView::AxisSamples &axisSamples = captureView.getAxisSamples(axis);
+        if (!axisSamples.recorded) {
+            return {};
+        }
+
+        if (axisSamples.codec == SampleCodec::RAW) {
+            // frames and samples are aligned to 8 bytes, the samples can be accessed in place
+            if (axisSamples.encoded.size() != captureView.samplesCount * sizeof(int16_t)) {
+                return {};
+            }
+            return {reinterpret_cast<const int16_t *>(axisSamples.encoded.data()), captureView.samplesCount};
+        }
+
+        if (!CaptureSerializer::decodeSamples(axisSamples, captureView.samplesCount, buffer)) {
+            return {};
+        }
+        return buffer;
+    }
+
+    bool CaptureReader::getAxisData(const CaptureView &captureView, const Axis &axis, std::vector<float> &data) {
+        std::vector<int16_t> buffer;
+        const Span<const int16_t> samples = getAxisRawData(captureView, axis, buffer);
+        if (samples.empty()) {
+            return false;
+        }
+        data = convertVibrationValues(captureView.recordingMode, samples, captureView.metadata.spectralAvgCount);
+        return true;
+    }
+}
@@ -0,0 +1,277 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <algorithm>
+#include <cstring>
+#include "vibration_daq/CaptureSerializer.hpp"
+#include "vibration_daq/SampleCompression.hpp"
+#include "vibration_daq/utils/BinaryIO.hpp"
+#include "vibration_daq/utils/SampleConversion.hpp"
+
+namespace vibration_daq {
+    namespace {
+        const size_t SAMPLES_ALIGNMENT = 8;
+
+        uint8_t getAxesMask(const std::vector<Axis> &axes) {
+            uint8_t axesMask = 0;
+            for (const auto &axis : axes) {
+                axesMask |= 1u << static_cast<int>(axis);
+            }
+            return axesMask;
+        }
+    }
+
+    // Payload layout, all values in host byte order:
+    // u16 version, u8 recording mode, u8 axes mask (bit 0: X), u8 FIR filter, u8 window setting, u8 name length, u8 0,
+    // i64 trigger realtime ns, i64 trigger monotonic raw ns, i64 read-out realtime ns, i64 read-out monotonic raw ns,
+    // u32 TIME_STAMP, u16 SERIAL_ID, REV_DAY, YEAR_MON, TEMP_OUT, SUPPLY_OUT, DIAG_STAT,
+    // i32 decimation factor, i32 spectral avg count, i32 bin offset, u32 samples count, f32 step size,
+    // u8 clock mapping valid, u8[3] 0, i32 points count, i64 reference ticks,
+    // f64 offset ns, f64 ns per tick, f64 drift ppm, f64 residual ns,
+    // since version 2: u32 statistics count, u32 0, per statistics: u32 axis, f32 mean, rms, std dev, peak,
+    // peak to peak, crest factor, skewness, kurtosis, u32 0,
+    // sensor name, padding to 8 bytes,
+    // per recorded axis (X, Y, Z): u32 codec (SampleCodec), u32 bytes, encoded samples, padding to 8 bytes
+    void CaptureSerializer::serialize(const VibrationData &vibrationData, const std::string &sensorName,
+                                      const HostTimestamp &triggerTimestamp, std::vector<uint8_t> &payload,
+                                      SampleCodec sampleCodec) {
+        const CaptureMetadata &metadata = vibrationData.metadata;
+        const uint8_t sensorNameLength = static_cast<uint8_t>(std::min<size_t>(sensorName.size(), 255));
+        const uint32_t samplesCount = vibrationData.stepAxis.size();
+
+        payload.clear();
+        BinaryWriter writer(payload);
+        writer.write(VERSION);
+        writer.write(static_cast<uint8_t>(vibrationData.recordingMode));
+        writer.write(getAxesMask(vibrationData.axes));
+        writer.write(static_cast<uint8_t>(metadata.firFilter));
+        writer.write(static_cast<uint8_t>(metadata.windowSetting));
+        writer.write(sensorNameLength);
+        writer.write(static_cast<uint8_t>(0));
+
+        writer.write(triggerTimestamp.realtimeNs);
+        writer.write(triggerTimestamp.monotonicRawNs);
+        writer.write(metadata.readoutTimestamp.realtimeNs);
+        writer.write(metadata.readoutTimestamp.monotonicRawNs);
+
+        writer.write(metadata.sensorTimestamp);
+        writer.write(metadata.serialId);
+        writer.write(metadata.revDay);
+        writer.write(metadata.yearMon);
+        writer.write(metadata.tempOut);
+        writer.write(metadata.supplyOut);
+        writer.write(metadata.diagStat);
+
+        writer.write(static_cast<int32_t>(metadata.decimationFactor));
+        writer.write(static_cast<int32_t>(metadata.spectralAvgCount));
+        writer.write(static_cast<int32_t>(vibrationData.binOffset));
+        writer.write(samplesCount);
+        writer.write(vibrationData.stepSize);
+
+        const ClockMapping &clockMapping = metadata.clockMapping;
+        writer.write(static_cast<uint8_t>(clockMapping.valid));
+        writer.writeBytes("\0\0\0", 3);
+        writer.write(static_cast<int32_t>(clockMapping.pointsCount));
+        writer.write(clockMapping.referenceTicks);
+        writer.write(clockMapping.offsetNs);
+        writer.write(clockMapping.nsPerTick);
+        writer.write(clockMapping.driftPpm);
+        writer.write(clockMapping.residualNs);
+
+        writer.write(static_cast<uint32_t>(metadata.statistics.size()));
+        writer.write(static_cast<uint32_t>(0));
+        for (const auto &statistics : metadata.statistics) {
+            const AxisStatistics &axisStatistics = statistics.second;
+            writer.write(static_cast<uint32_t>(statistics.first));
+            writer.write(axisStatistics.mean);
+            writer.write(axisStatistics.rms);
+            writer.write(axisStatistics.stdDev);
+            writer.write(axisStatistics.peak);
+            writer.write(axisStatistics.peakToPeak);
+            writer.write(axisStatistics.crestFactor);
+            writer.write(axisStatistics.skewness);
+            writer.write(axisStatistics.kurtosis);
+            writer.write(static_cast<uint32_t>(0));
+        }
+
+        writer.writeBytes(sensorName.data(), sensorNameLength);
+        writer.align(SAMPLES_ALIGNMENT);
+
+        for (const auto &axis : ALL_AXES) {
+            if (!(getAxesMask(vibrationData.axes) & (1u << static_cast<int>(axis)))) {
+                continue;
+            }
+            const std::vector<int16_t> &samples = vibrationData.getAxisRawData(axis);
+            writer.write(static_cast<uint32_t>(sampleCodec));
+            if (sampleCodec == SampleCodec::DELTA_PACK) {
+                // bytes are known after encoding
+                const size_t bytesPosition = writer.getSize();
+                writer.write(static_cast<uint32_t>(0));
+                SampleCompression::encode(samples, payload);
+                const auto bytes = static_cast<uint32_t>(payload.size() - bytesPosition - sizeof(uint32_t));
+                std::memcpy(payload.data() + bytesPosition, &bytes, sizeof(bytes));
+            } else {
+                writer.write(static_cast<uint32_t>(samples.size() * sizeof(int16_t)));
+                writer.writeBytes(samples.data(), samples.size() * sizeof(int16_t));
+            }
+            writer.align(SAMPLES_ALIGNMENT);
+        }
+    }
+
+    bool CaptureSerializer::readIndexEntry(const uint8_t *payload, size_t length, SegmentIndexEntry &indexEntry) {
+        BinaryReader reader(payload, length);
+        uint16_t version;
+        uint8_t recordingMode;
+        if (!reader.read(version) || version < 1 || version > VERSION || !reader.read(recordingMode) ||
+            !reader.skip(5) || !reader.read(indexEntry.triggerRealtimeNs)) {
+            return false;
+        }
+        indexEntry.recordingMode = static_cast<RecordingMode>(recordingMode);
+        return true;
+    }
+
+    bool CaptureSerializer::readView(const uint8_t *payload, size_t length, CaptureView &captureView) {
+        BinaryReader reader(payload, length);
+        CaptureMetadata &metadata = captureView.metadata;
+
+        uint16_t version;
+        uint8_t recordingMode, axesMask, firFilter, windowSetting, sensorNameLength, reserved;
+        if (!reader.read(version) || version < 1 || version > VERSION ||
+            !reader.read(recordingMode) || !reader.read(axesMask) || !reader.read(firFilter) ||
+            !reader.read(windowSetting) || !reader.read(sensorNameLength) || !reader.read(reserved)) {
+            return false;
+        }
+        captureView.recordingMode = static_cast<RecordingMode>(recordingMode);
+        metadata.firFilter = static_cast<FIRFilter>(firFilter);
+        metadata.windowSetting = static_cast<WindowSetting>(windowSetting);
+
+        int32_t decimationFactor, spectralAvgCount, binOffset, pointsCount;
+        uint8_t clockMappingValid;
+        ClockMapping &clockMapping = metadata.clockMapping;
+        if (!reader.read(captureView.triggerTimestamp.realtimeNs) ||
+            !reader.read(captureView.triggerTimestamp.monotonicRawNs) ||
+            !reader.read(metadata.readoutTimestamp.realtimeNs) ||
+            !reader.read(metadata.readoutTimestamp.monotonicRawNs) ||
+            !reader.read(metadata.sensorTimestamp) || !reader.read(metadata.serialId) ||
+            !reader.read(metadata.revDay) || !reader.read(metadata.yearMon) || !reader.read(metadata.tempOut) ||
+            !reader.read(metadata.supplyOut) || !reader.read(metadata.diagStat) ||
+            !reader.read(decimationFactor) || !reader.read(spectralAvgCount) || !reader.read(binOffset) ||
+            !reader.read(captureView.samplesCount) || !reader.read(captureView.stepSize) ||
+            !reader.read(clockMappingValid) || !reader.skip(3) || !reader.read(pointsCount) ||
+            !reader.read(clockMapping.referenceTicks) || !reader.read(clockMapping.offsetNs) ||
+            !reader.read(clockMapping.nsPerTick) || !reader.read(clockMapping.driftPpm) ||
+            !reader.read(clockMapping.residualNs)) {
+            return false;
+        }
+        metadata.decimationFactor = decimationFactor;
+        metadata.spectralAvgCount = spectralAvgCount;
+        captureView.binOffset = binOffset;
+        clockMapping.valid = clockMappingValid != 0;
+        clockMapping.pointsCount = pointsCount;
+
+        metadata.statistics.clear();
+        uint32_t statisticsCount = 0;
+        if (version >= 2 && (!reader.read(statisticsCount) || !reader.skip(sizeof(uint32_t)))) {
+            return false;
+        }
+        for (uint32_t i = 0; i < statisticsCount; ++i) {
+            uint32_t axis;
+            AxisStatistics axisStatistics;
+            if (!reader.read(axis) || axis > static_cast<uint32_t>(Axis::Z) ||
+                !reader.read(axisStatistics.mean) || !reader.read(axisStatistics.rms) ||
+                !reader.read(axisStatistics.stdDev) || !reader.read(axisStatistics.peak) ||
+                !reader.read(axisStatistics.peakToPeak) || !reader.read(axisStatistics.crestFactor) ||
+                !reader.read(axisStatistics.skewness) || !reader.read(axisStatistics.kurtosis) ||
+                !reader.skip(sizeof(uint32_t))) {
+                return false;
+            }
+            metadata.statistics[static_cast<Axis>(axis)] = axisStatistics;
+        }
+
+        const auto sensorName = reinterpret_cast<const char *>(reader.skip(sensorNameLength));
+        if (!sensorName || !reader.align(SAMPLES_ALIGNMENT)) {
+            return false;
+        }
+        captureView.sensorName = std::string_view(sensorName, sensorNameLength);
+
+        for (const auto &axis : ALL_AXES) {
+            CaptureView::AxisSamples &axisSamples = captureView.getAxisSamples(axis);
+            axisSamples.recorded = axesMask & (1u << static_cast<int>(axis));
+            axisSamples.encoded = Span<const uint8_t>();
+            if (!axisSamples.recorded) {
+                continue;
+            }
+
+            uint32_t codec, bytes;
+            if (!reader.read(codec) || !reader.read(bytes)) {
+                return false;
+            }
+            const uint8_t *encoded = reader.skip(bytes);
+            if (!encoded || !reader.align(SAMPLES_ALIGNMENT)) {
+                return false;
+            }
+            axisSamples.codec = static_cast<SampleCodec>(codec);
+            axisSamples.encoded = Span<const uint8_t>(encoded, bytes);
+        }
+        return true;
+    }
+
+    bool CaptureSerializer::decodeSamples(const CaptureView::AxisSamples &axisSamples, uint32_t samplesCount,
+                                          std::vector<int16_t> &samples) {
+        switch (axisSamples.codec) {
+            case SampleCodec::RAW:
+                if (axisSamples.encoded.size() != samplesCount * sizeof(int16_t)) {
+                    return false;
+                }
+                samples.resize(samplesCount);
+                std::memcpy(samples.data(), axisSamples.encoded.data(), axisSamples.encoded.size());
+                return true;
+            case SampleCodec::DELTA_PACK:
+                return SampleCompression::decode(axisSamples.encoded.data(), axisSamples.encoded.size(),
+                                                 samplesCount, samples);
+            default:
+                return false;
+        }
+    }
+
+    bool CaptureSerializer::deserialize(const uint8_t *payload, size_t length, CaptureRecord &captureRecord) {
+        CaptureView captureView;
+        if (!readView(payload, length, captureView)) {
+            return false;
+        }
+
+        VibrationData &vibrationData = captureRecord.vibrationData;
+        captureRecord.sensorName = std::string(captureView.sensorName);
+        captureRecord.triggerTimestamp = captureView.triggerTimestamp;
+        vibrationData.recordingMode = captureView.recordingMode;
+        vibrationData.metadata = captureView.metadata;
+        vibrationData.binOffset = captureView.binOffset;
+        vibrationData.stepSize = captureView.stepSize;
+
+        vibrationData.stepAxis.clear();
+        vibrationData.stepAxis.reserve(captureView.samplesCount);
+        for (uint32_t i = 0; i < captureView.samplesCount; ++i) {
+            vibrationData.stepAxis.push_back(vibrationData.stepSize * (vibrationData.binOffset + i));
+        }
+
+        vibrationData.axes.clear();
+        for (const auto &axis : ALL_AXES) {
+            const CaptureView::AxisSamples &axisSamples = captureView.getAxisSamples(axis);
+            if (!axisSamples.recorded) {
+                continue;
+            }
+            vibrationData.axes.push_back(axis);
+
+            std::vector<int16_t> &samples = vibrationData.getAxisRawData(axis);
+            if (!decodeSamples(axisSamples, captureView.samplesCount, samples)) {
+                return false;
+            }
+            vibrationData.getAxisData(axis) = convertVibrationValues(vibrationData.recordingMode, samples,
+                                                                     vibrationData.metadata.spectralAvgCount);
+        }
+
+        return true;
+    }
+}
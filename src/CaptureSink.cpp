@@ -0,0 +1,129 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "vibration_daq/CaptureSink.hpp"
+#include "vibration_daq/FeatureSink.hpp"
+#include "vibration_daq/SocketSink.hpp"
+#include "vibration_daq/StorageModule.hpp"
+#include "loguru/loguru.hpp"
+
+namespace vibration_daq {
+    std::unique_ptr<CaptureSink> CaptureSink::create(const SinkConfig &sinkConfig, const fs::path &storageDirectory,
+                                                     const StorageConfig &storageConfig) {
+        std::set<fs::path> directories;
+        return create(sinkConfig, storageDirectory, storageConfig, directories);
+    }
+
+    std::unique_ptr<CaptureSink> CaptureSink::create(const SinkConfig &sinkConfig, const fs::path &storageDirectory,
+                                                     const StorageConfig &storageConfig,
+                                                     std::set<fs::path> &directories) {
+        switch (sinkConfig.type) {
+            case SinkType::NULL_SINK:
+                LOG_S(WARNING) << "Captures are discarded by the NULL_SINK sink.";
+                return std::make_unique<NullSink>();
+            case SinkType::SOCKET: {
+                auto socketSink = std::make_unique<SocketSink>();
+                if (!socketSink->setup(sinkConfig.socketPath, sinkConfig.sampleCodec)) {
+                    return nullptr;
+                }
+                return socketSink;
+            }
+            case SinkType::TEE: {
+                std::vector<std::unique_ptr<CaptureSink>> sinks;
+                for (const auto &childConfig : sinkConfig.sinks) {
+                    auto sink = create(childConfig, storageDirectory, storageConfig, directories);
+                    if (!sink) {
+                        return nullptr;
+                    }
+                    sinks.push_back(std::move(sink));
+                }
+                return std::make_unique<TeeSink>(std::move(sinks));
+            }
+            case SinkType::FEATURES: {
+                std::unique_ptr<CaptureSink> rawSink;
+                if (sinkConfig.sinks.size() == 1) {
+                    rawSink = create(sinkConfig.sinks.front(), storageDirectory, storageConfig, directories);
+                } else if (!sinkConfig.sinks.empty()) {
+                    SinkConfig teeConfig;
+                    teeConfig.type = SinkType::TEE;
+                    teeConfig.sinks = sinkConfig.sinks;
+                    rawSink = create(teeConfig, storageDirectory, storageConfig, directories);
+                }
+                if (!sinkConfig.sinks.empty() && !rawSink) {
+                    return nullptr;
+                }
+                auto featureSink = std::make_unique<FeatureSink>();
+                const fs::path directory =
+                        sinkConfig.directory.empty() ? storageDirectory : fs::path(sinkConfig.directory);
+                if (!featureSink->setup(directory, sinkConfig.featureConfig, storageConfig, std::move(rawSink))) {
+                    return nullptr;
+                }
+                return featureSink;
+            }
+            default:
+                break;
+        }
+
+        StorageConfig sinkStorageConfig = storageConfig;
+        sinkStorageConfig.format = sinkConfig.type == SinkType::CSV ? StorageFormat::CSV : StorageFormat::SEGMENT;
+        if (sinkConfig.type == SinkType::BINARY) {
+            sinkStorageConfig.sampleCodec = SampleCodec::RAW;
+        } else if (sinkConfig.type == SinkType::COMPRESSED) {
+            sinkStorageConfig.sampleCodec = SampleCodec::DELTA_PACK;
+        }
+
+        // the StorageModule concatenates the directory and the file name
+        const fs::path directory =
+                (sinkConfig.directory.empty() ? storageDirectory : fs::path(sinkConfig.directory)) / "";
+        std::error_code errorCode;
+        // two StorageModules in one directory would clean up and index each other's files
+        if (!directories.insert(fs::weakly_canonical(directory, errorCode)).second) {
+            LOG_S(ERROR) << "Storage directory is used by more than one sink: " << directory;
+            return nullptr;
+        }
+
+        auto storageModule = std::make_unique<StorageModule>();
+        if (!storageModule->setup(directory, sinkStorageConfig)) {
+            return nullptr;
+        }
+        return storageModule;
+    }
+
+    bool NullSink::storeVibrationData(const VibrationData &, const std::string &, const HostTimestamp &) {
+        lastCapture = std::chrono::steady_clock::now();
+        if (capturesCount++ == 0) {
+            firstCapture = lastCapture;
+        }
+        return true;
+    }
+
+    void NullSink::close() {
+        if (capturesCount == 0) {
+            return;
+        }
+        const double elapsed = std::chrono::duration<double>(lastCapture - firstCapture).count();
+        LOG_S(INFO) << "NULL_SINK discarded " << capturesCount << " captures in " << elapsed << " s"
+                    << (elapsed > 0 ? ", " + std::to_string((capturesCount - 1) / elapsed) + " captures/s" : "");
+        capturesCount = 0;
+    }
+
+    TeeSink::TeeSink(std::vector<std::unique_ptr<CaptureSink>> sinks) : sinks(std::move(sinks)) {
+    }
+
+    bool TeeSink::storeVibrationData(const VibrationData &vibrationData, const std::string &sensorName,
+                                     const HostTimestamp &triggerTimestamp) {
+        bool stored = true;
+        for (auto &sink : sinks) {
+            stored = sink->storeVibrationData(vibrationData, sensorName, triggerTimestamp) && stored;
+        }
+        return stored;
+    }
+
+    void TeeSink::close() {
+        for (auto &sink : sinks) {
+            sink->close();
+        }
+    }
+}
@@ -0,0 +1,97 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <cmath>
+#include "vibration_daq/ClockSync.hpp"
+
+namespace vibration_daq {
+    void ClockSync::addPoint(uint32_t ticks, int64_t monotonicRawNs) {
+        if (!points.empty() && ticks < lastTicks) {
+            wrapOffset += static_cast<int64_t>(1) << 32;
+        }
+        lastTicks = ticks;
+
+        points.emplace_back(wrapOffset + ticks, monotonicRawNs);
+        if (points.size() > WINDOW_SIZE) {
+            points.pop_front();
+        }
+        fit();
+    }
+
+    void ClockSync::clear() {
+        points.clear();
+        lastTicks = 0;
+        wrapOffset = 0;
+        // the drift refers to the rate at the first mapping, which is still valid after a restart
+        mapping = ClockMapping();
+    }
+
+    void ClockSync::fit() {
+        mapping.pointsCount = static_cast<int>(points.size());
+        mapping.referenceTicks = points.front().first;
+        const int64_t referenceNs = points.front().second;
+
+        // least squares fit, relative to the first point to keep the precision of double
+        double meanTicks = 0;
+        double meanNs = 0;
+        for (const auto &point : points) {
+            meanTicks += static_cast<double>(point.first - mapping.referenceTicks);
+            meanNs += static_cast<double>(point.second - referenceNs);
+        }
+        meanTicks /= points.size();
+        meanNs /= points.size();
+
+        double covariance = 0;
+        double varianceTicks = 0;
+        for (const auto &point : points) {
+            const double ticks = static_cast<double>(point.first - mapping.referenceTicks) - meanTicks;
+            const double ns = static_cast<double>(point.second - referenceNs) - meanNs;
+            covariance += ticks * ns;
+            varianceTicks += ticks * ticks;
+        }
+        if (varianceTicks == 0) {
+            mapping.valid = false;
+            return;
+        }
+
+        mapping.valid = true;
+        mapping.nsPerTick = covariance / varianceTicks;
+        mapping.offsetNs = static_cast<double>(referenceNs) + meanNs - mapping.nsPerTick * meanTicks;
+
+        double squaredResiduals = 0;
+        for (const auto &point : points) {
+            const double predictedNs = mapping.offsetNs + mapping.nsPerTick *
+                                                          static_cast<double>(point.first - mapping.referenceTicks);
+            const double residual = static_cast<double>(point.second) - predictedNs;
+            squaredResiduals += residual * residual;
+        }
+        mapping.residualNs = std::sqrt(squaredResiduals / points.size());
+
+        // a fit of only a few points is dominated by the jitter of the read-out
+        if (initialNsPerTick == 0 && points.size() >= MIN_DRIFT_POINTS) {
+            initialNsPerTick = mapping.nsPerTick;
+        }
+        if (initialNsPerTick != 0) {
+            mapping.driftPpm = (mapping.nsPerTick / initialNsPerTick - 1) * 1e6;
+        }
+    }
+
+    const ClockMapping &ClockSync::getMapping() const {
+        return mapping;
+    }
+
+    int64_t ClockSync::toMonotonicRawNs(uint32_t ticks) const {
+        if (!mapping.valid) {
+            return 0;
+        }
+        // ticks behind the last point are assumed to be from before the last wrap
+        int64_t unwrappedTicks = wrapOffset + ticks;
+        if (ticks > lastTicks && wrapOffset > 0 && ticks - lastTicks > (1u << 31)) {
+            unwrappedTicks -= static_cast<int64_t>(1) << 32;
+        }
+        return static_cast<int64_t>(std::llround(
+                mapping.offsetNs + mapping.nsPerTick * static_cast<double>(unwrappedTicks - mapping.referenceTicks)));
+    }
+}
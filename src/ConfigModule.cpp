@@ -4,6 +4,7 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
 
 #include <iostream>
+#include <algorithm>
 #include "vibration_daq/ConfigModule.hpp"
 #include "loguru/loguru.hpp"
 
@@ -39,29 +40,114 @@ namespace vibration_daq {
             return false;
         }
 
+        // optional, record all axes if not set
+        if (node["axes"]) {
+            std::vector<std::string> axesStrings;
+            if (!convertNode(node["axes"], axesStrings) || axesStrings.empty()) {
+                LOG_S(WARNING) << "could not read axes from config";
+                return false;
+            }
+
+            vibrationSensor.axes.clear();
+            for (const auto &axisString : axesStrings) {
+                Axis axis;
+                if (!Enum::convert(axisString, axis)) {
+                    LOG_S(WARNING) << "could not convert axis to enum: " << axisString;
+                    return false;
+                }
+                if (std::find(vibrationSensor.axes.begin(), vibrationSensor.axes.end(), axis) != vibrationSensor.axes.end()) {
+                    LOG_S(WARNING) << "axis is listed twice: " << axisString;
+                    return false;
+                }
+                vibrationSensor.axes.push_back(axis);
+            }
+            // keep buffer order X, Y, Z independent of config order
+            std::sort(vibrationSensor.axes.begin(), vibrationSensor.axes.end());
+        }
+
+        // without schedule, the sensor records with its recording_mode in every cycle
+        if (node["schedule"]) {
+            if (!node["schedule"].IsSequence() || node["schedule"].size() == 0) {
+                LOG_S(WARNING) << "schedule is not a non-empty sequence";
+                return false;
+            }
+            for (const auto &entryNode : node["schedule"]) {
+                ScheduleEntry scheduleEntry;
+                if (!readScheduleEntry(entryNode, node, scheduleEntry)) {
+                    return false;
+                }
+                vibrationSensor.schedule.push_back(scheduleEntry);
+            }
+        } else {
+            ScheduleEntry scheduleEntry;
+            if (!readScheduleEntry(node, node, scheduleEntry)) {
+                return false;
+            }
+            vibrationSensor.schedule.push_back(scheduleEntry);
+        }
+
+        std::vector<RecordingConfig *> recordingConfigs;
+        std::vector<int> spectralAvgCounts;
+        for (auto &scheduleEntry : vibrationSensor.schedule) {
+            if (scheduleEntry.recordingMode == RecordingMode::MFFT) {
+                recordingConfigs.push_back(&scheduleEntry.mfftConfig);
+                spectralAvgCounts.push_back(scheduleEntry.mfftConfig.spectralAvgCount);
+            } else {
+                recordingConfigs.push_back(&scheduleEntry.mtcConfig);
+                spectralAvgCounts.push_back(0);
+            }
+        }
+
+        return assignSampleRateSlots(recordingConfigs, spectralAvgCounts, vibrationSensor.sampleRateSlots);
+    }
+
+    bool ConfigModule::readScheduleEntry(const YAML::Node &node, const YAML::Node &sensorNode,
+                                         ScheduleEntry &scheduleEntry) {
+        if (!node.IsMap()) {
+            LOG_S(WARNING) << "schedule node is not a map";
+            return false;
+        }
+
         std::string recordingModeString;
         if (!convertNode(node["recording_mode"], recordingModeString)) {
-            LOG_S(WARNING) << "could not read decimation_factor from config";
+            LOG_S(WARNING) << "could not read recording_mode from config";
             return false;
         }
-        if (!Enum::convert(recordingModeString, vibrationSensor.recordingMode)) {
-            LOG_S(WARNING) << "could not convert decimation_factor to enum: " << recordingModeString;
+        if (!Enum::convert(recordingModeString, scheduleEntry.recordingMode)) {
+            LOG_S(WARNING) << "could not convert recording_mode to enum: " << recordingModeString;
             return false;
         }
 
-        switch (vibrationSensor.recordingMode) {
-            case RecordingMode::MFFT:
-                if (!readMFFTConfig(node["MFFT_config"], vibrationSensor.mfftConfig)) {
+        // optional, record in every cycle if not set
+        if (node["every"]) {
+            if (!convertNode(node["every"], scheduleEntry.interval)) {
+                LOG_S(WARNING) << "could not read every from config";
+                return false;
+            }
+            if (scheduleEntry.interval < 1) {
+                LOG_S(WARNING) << "every has to be at least 1: " << scheduleEntry.interval;
+                return false;
+            }
+        }
+
+        // an entry can have its own config, otherwise the config of the sensor is used
+        switch (scheduleEntry.recordingMode) {
+            case RecordingMode::MFFT: {
+                const YAML::Node mfftNode = node["MFFT_config"] ? node["MFFT_config"] : sensorNode["MFFT_config"];
+                if (!readMFFTConfig(mfftNode, scheduleEntry.mfftConfig)) {
                     LOG_S(WARNING) << "could not read MFFT_config from config";
                     return false;
                 }
                 return true;
-            case RecordingMode::MTC:
-                if (!readMTCConfig(node["MTC_config"], vibrationSensor.mtcConfig)) {
+            }
+            case RecordingMode::MTC: {
+                const YAML::Node mtcNode = node["MTC_config"] ? node["MTC_config"] : sensorNode["MTC_config"];
+                if (!readMTCConfig(mtcNode, scheduleEntry.mtcConfig)) {
                     LOG_S(WARNING) << "could not read MTC_config from config";
                     return false;
                 }
                 return true;
+            }
             case RecordingMode::AFFT:
             case RecordingMode::RTS:
             default:
@@ -70,6 +156,52 @@ namespace vibration_daq {
         }
     }
 
+    bool ConfigModule::assignSampleRateSlots(const std::vector<RecordingConfig *> &recordingConfigs,
+                                             const std::vector<int> &spectralAvgCounts,
+                                             SampleRateSlots &sampleRateSlots) {
+        sampleRateSlots = DEFAULT_SAMPLE_RATE_SLOTS;
+        // slots only used by MTC configs accept any spectral average count
+        std::array<bool, 4> spectralAvgCountFixed = {};
+        int usedSlotsCount = 0;
+
+        for (int i = 0; i < recordingConfigs.size(); ++i) {
+            RecordingConfig &recordingConfig = *recordingConfigs[i];
+            const int spectralAvgCount = spectralAvgCounts[i];
+
+            int slot = 0;
+            for (; slot < usedSlotsCount; ++slot) {
+                auto &sampleRateSlot = sampleRateSlots[slot];
+                if (sampleRateSlot.decimationFactor != recordingConfig.decimationFactor) {
+                    continue;
+                }
+                if (spectralAvgCount == 0 || sampleRateSlot.spectralAvgCount == spectralAvgCount) {
+                    break;
+                }
+                if (!spectralAvgCountFixed[slot]) {
+                    sampleRateSlot.spectralAvgCount = spectralAvgCount;
+                    spectralAvgCountFixed[slot] = true;
+                    break;
+                }
+            }
+
+            if (slot == usedSlotsCount) {
+                if (usedSlotsCount == sampleRateSlots.size()) {
+                    LOG_S(WARNING) << "more than " << sampleRateSlots.size()
+                                   << " different decimation_factor and spectral_avg_count combinations per sensor";
+                    return false;
+                }
+                sampleRateSlots[slot].decimationFactor = recordingConfig.decimationFactor;
+                sampleRateSlots[slot].spectralAvgCount = spectralAvgCount == 0 ? 1 : spectralAvgCount;
+                spectralAvgCountFixed[slot] = spectralAvgCount != 0;
+                usedSlotsCount++;
+            }
+
+            recordingConfig.sampleRateSlot = slot;
+        }
+
+        return true;
+    }
+
     bool ConfigModule::readRecordingConfig(const YAML::Node &node, RecordingConfig &recordingConfig) {
         if (!node.IsMap()) {
             LOG_S(WARNING) << "recording node is not a map";
@@ -134,6 +266,26 @@ namespace vibration_daq {
             LOG_S(WARNING) << "could not convert window_setting to enum: " << windowSettingString;
             return false;
         }
+        if (mfftConfig.windowSetting == WindowSetting::BLACKMAN_HARRIS) {
+            LOG_S(WARNING) << "window_setting BLACKMAN_HARRIS is only supported for host spectra";
+            return false;
+        }
+
+        // optional, read all bins if not set
+        if (node["frequency_band"]) {
+            std::array<float, 2> frequencyBand = {};
+            if (!convertNode(node["frequency_band"], frequencyBand)) {
+                LOG_S(WARNING) << "could not read frequency_band from config";
+                return false;
+            }
+            if (frequencyBand[0] < 0 || frequencyBand[1] <= frequencyBand[0]) {
+                LOG_S(WARNING) << "frequency_band is not a valid range [min, max]: [" << frequencyBand[0] << ", "
+                               << frequencyBand[1] << "]";
+                return false;
+            }
+            mfftConfig.frequencyBandMin = frequencyBand[0];
+            mfftConfig.frequencyBandMax = frequencyBand[1];
+        }
 
         return true;
     }
@@ -194,6 +346,405 @@ namespace vibration_daq {
         return true;
     }
 
+    bool ConfigModule::readVerifySensorConfig(bool &verifySensorConfig) const {
+        // a missing key of the const config node is invalid and can't be converted
+        const YAML::Node node = configNode["verify_sensor_config"];
+        if (!node) {
+            return false;
+        }
+        return convertNode(node, verifySensorConfig);
+    }
+
+    bool ConfigModule::readSpiWordGap(int &spiWordGap) const {
+        const YAML::Node node = configNode["spi_word_gap_us"];
+        if (!node) {
+            return false;
+        }
+        return convertNode(node, spiWordGap) && spiWordGap >= 0;
+    }
+
+    bool ConfigModule::readStorageConfig(StorageConfig &storageConfig) const {
+        const YAML::Node node = configNode["storage"];
+        if (!node) {
+            return true;
+        }
+        if (!node.IsMap()) {
+            LOG_S(WARNING) << "storage node is not a map";
+            return false;
+        }
+
+        if (node["format"]) {
+            std::string formatString;
+            if (!convertNode(node["format"], formatString)) {
+                LOG_S(WARNING) << "could not read storage format from config";
+                return false;
+            }
+            if (!Enum::convert(formatString, storageConfig.format)) {
+                LOG_S(WARNING) << "could not convert storage format to enum: " << formatString;
+                return false;
+            }
+        }
+
+        if (node["segment_max_size_mb"]) {
+            int segmentMaxSizeMB;
+            if (!convertNode(node["segment_max_size_mb"], segmentMaxSizeMB) || segmentMaxSizeMB <= 0) {
+                LOG_S(WARNING) << "could not read segment_max_size_mb from config";
+                return false;
+            }
+            storageConfig.segmentMaxSize = static_cast<uint64_t>(segmentMaxSizeMB) * 1024 * 1024;
+        }
+
+        if (node["segment_max_duration_s"] &&
+            (!convertNode(node["segment_max_duration_s"], storageConfig.segmentMaxDuration) ||
+             storageConfig.segmentMaxDuration <= 0)) {
+            LOG_S(WARNING) << "could not read segment_max_duration_s from config";
+            return false;
+        }
+
+        if (node["codec"]) {
+            std::string codecString;
+            if (!convertNode(node["codec"], codecString)) {
+                LOG_S(WARNING) << "could not read storage codec from config";
+                return false;
+            }
+            if (!Enum::convert(codecString, storageConfig.sampleCodec)) {
+                LOG_S(WARNING) << "could not convert storage codec to enum: " << codecString;
+                return false;
+            }
+        }
+
+        if (node["write_block_kb"]) {
+            int writeBlockKB;
+            if (!convertNode(node["write_block_kb"], writeBlockKB) || writeBlockKB <= 0 || writeBlockKB % 4 != 0) {
+                LOG_S(WARNING) << "could not read write_block_kb from config, must be a multiple of 4";
+                return false;
+            }
+            storageConfig.writeBlockSize = static_cast<size_t>(writeBlockKB) * 1024;
+        }
+
+        if (node["preallocate"] && !convertNode(node["preallocate"], storageConfig.preallocate)) {
+            LOG_S(WARNING) << "could not read preallocate from config";
+            return false;
+        }
+
+        if (node["direct_io"] && !convertNode(node["direct_io"], storageConfig.directIO)) {
+            LOG_S(WARNING) << "could not read direct_io from config";
+            return false;
+        }
+
+        if (node["sync"]) {
+            std::string syncString;
+            if (!convertNode(node["sync"], syncString)) {
+                LOG_S(WARNING) << "could not read storage sync from config";
+                return false;
+            }
+            if (!Enum::convert(syncString, storageConfig.syncMode)) {
+                LOG_S(WARNING) << "could not convert storage sync to enum: " << syncString;
+                return false;
+            }
+        }
+
+        if (node["sync_count"] &&
+            (!convertNode(node["sync_count"], storageConfig.syncCount) || storageConfig.syncCount <= 0)) {
+            LOG_S(WARNING) << "could not read sync_count from config";
+            return false;
+        }
+
+        if (node["sync_interval_s"] &&
+            (!convertNode(node["sync_interval_s"], storageConfig.syncInterval) || storageConfig.syncInterval <= 0)) {
+            LOG_S(WARNING) << "could not read sync_interval_s from config";
+            return false;
+        }
+
+        if (node["retention"] && !readRetentionConfig(node["retention"], storageConfig.retention)) {
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ConfigModule::readRetentionConfig(const YAML::Node &node, RetentionConfig &retentionConfig) {
+        if (!node.IsMap()) {
+            LOG_S(WARNING) << "retention node is not a map";
+            return false;
+        }
+
+        if (node["quota_mb"]) {
+            int quotaMB;
+            if (!convertNode(node["quota_mb"], quotaMB) || quotaMB < 0) {
+                LOG_S(WARNING) << "could not read retention quota_mb from config";
+                return false;
+            }
+            retentionConfig.quota = static_cast<uint64_t>(quotaMB) * 1024 * 1024;
+        }
+
+        if (node["max_age_days"] &&
+            (!convertNode(node["max_age_days"], retentionConfig.maxAge) || retentionConfig.maxAge < 0)) {
+            LOG_S(WARNING) << "could not read retention max_age_days from config";
+            return false;
+        }
+
+        if (node["aged_out"]) {
+            std::string agedOutString;
+            if (!convertNode(node["aged_out"], agedOutString)) {
+                LOG_S(WARNING) << "could not read retention aged_out from config";
+                return false;
+            }
+            if (!Enum::convert(agedOutString, retentionConfig.agedOutMode)) {
+                LOG_S(WARNING) << "could not convert retention aged_out to enum: " << agedOutString;
+                return false;
+            }
+        }
+
+        if (node["downsample_factor"] &&
+            (!convertNode(node["downsample_factor"], retentionConfig.downsampleFactor) ||
+             retentionConfig.downsampleFactor < 2)) {
+            LOG_S(WARNING) << "could not read retention downsample_factor from config, must be at least 2";
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ConfigModule::readSinkConfig(const StorageConfig &storageConfig, SinkConfig &sinkConfig) const {
+        // without a storage node, its sinks can't be looked up on the const config node
+        const YAML::Node storageNode = configNode["storage"];
+        if (!storageNode || !storageNode.IsMap() || !storageNode["sinks"]) {
+            sinkConfig = SinkConfig();
+            sinkConfig.type = storageConfig.format == StorageFormat::CSV ? SinkType::CSV : SinkType::SEGMENT;
+            return true;
+        }
+        const YAML::Node node = storageNode["sinks"];
+        if (!node.IsSequence() || node.size() == 0) {
+            LOG_S(WARNING) << "storage sinks node is not a non-empty list";
+            return false;
+        }
+        if (node.size() == 1) {
+            return readSinkConfig(node[0], sinkConfig);
+        }
+
+        sinkConfig = SinkConfig();
+        sinkConfig.type = SinkType::TEE;
+        sinkConfig.sinks.resize(node.size());
+        for (size_t i = 0; i < node.size(); ++i) {
+            if (!readSinkConfig(node[i], sinkConfig.sinks[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ConfigModule::readSinkConfig(const YAML::Node &node, SinkConfig &sinkConfig) {
+        if (!node.IsMap()) {
+            LOG_S(WARNING) << "sink node is not a map";
+            return false;
+        }
+
+        std::string typeString;
+        if (!convertNode(node["type"], typeString)) {
+            LOG_S(WARNING) << "could not read sink type from config";
+            return false;
+        }
+        if (!Enum::convert(typeString, sinkConfig.type)) {
+            LOG_S(WARNING) << "could not convert sink type to enum: " << typeString;
+            return false;
+        }
+
+        if (node["directory"] && !convertNode(node["directory"], sinkConfig.directory)) {
+            LOG_S(WARNING) << "could not read sink directory from config";
+            return false;
+        }
+
+        if (sinkConfig.type == SinkType::SOCKET && !convertNode(node["path"], sinkConfig.socketPath)) {
+            LOG_S(WARNING) << "could not read socket sink path from config";
+            return false;
+        }
+
+        if (node["codec"]) {
+            std::string codecString;
+            if (!convertNode(node["codec"], codecString)) {
+                LOG_S(WARNING) << "could not read sink codec from config";
+                return false;
+            }
+            if (!Enum::convert(codecString, sinkConfig.sampleCodec)) {
+                LOG_S(WARNING) << "could not convert sink codec to enum: " << codecString;
+                return false;
+            }
+        }
+
+        if (sinkConfig.type == SinkType::FEATURES && !readFeatureConfig(node, sinkConfig.featureConfig)) {
+            return false;
+        }
+
+        // the raw sinks of FEATURES are optional
+        const YAML::Node sinksNode = node["sinks"];
+        if (sinkConfig.type == SinkType::TEE || (sinkConfig.type == SinkType::FEATURES && sinksNode)) {
+            if (!sinksNode.IsSequence() || sinksNode.size() == 0) {
+                LOG_S(WARNING) << Enum::toString(sinkConfig.type) << " sink needs a non-empty sinks list";
+                return false;
+            }
+            sinkConfig.sinks.resize(sinksNode.size());
+            for (size_t i = 0; i < sinksNode.size(); ++i) {
+                if (!readSinkConfig(sinksNode[i], sinkConfig.sinks[i])) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool ConfigModule::readFeatureConfig(const YAML::Node &node, FeatureConfig &featureConfig) {
+        if (node["bands"]) {
+            std::vector<std::array<float, 2>> bands;
+            if (!convertNode(node["bands"], bands)) {
+                LOG_S(WARNING) << "could not read feature bands from config";
+                return false;
+            }
+            for (const auto &band : bands) {
+                if (band[0] < 0 || band[1] <= band[0]) {
+                    LOG_S(WARNING) << "feature band is not a valid range [min, max]: [" << band[0] << ", " << band[1]
+                                   << "]";
+                    return false;
+                }
+                featureConfig.bands.push_back({band[0], band[1]});
+            }
+        }
+
+        if (node["spectral_peaks"] &&
+            (!convertNode(node["spectral_peaks"], featureConfig.spectralPeaksCount) ||
+             featureConfig.spectralPeaksCount < 0)) {
+            LOG_S(WARNING) << "could not read spectral_peaks from config";
+            return false;
+        }
+
+        if (node["raw_interval"] &&
+            (!convertNode(node["raw_interval"], featureConfig.rawInterval) || featureConfig.rawInterval < 0)) {
+            LOG_S(WARNING) << "could not read raw_interval from config";
+            return false;
+        }
+
+        if (node["baseline_deviation"] &&
+            (!convertNode(node["baseline_deviation"], featureConfig.baselineDeviation) ||
+             featureConfig.baselineDeviation < 0)) {
+            LOG_S(WARNING) << "could not read baseline_deviation from config";
+            return false;
+        }
+
+        if (node["baseline_captures"] &&
+            (!convertNode(node["baseline_captures"], featureConfig.baselineCaptures) ||
+             featureConfig.baselineCaptures < 2)) {
+            LOG_S(WARNING) << "could not read baseline_captures from config, must be at least 2";
+            return false;
+        }
+
+        const YAML::Node thresholdsNode = node["thresholds"];
+        if (thresholdsNode) {
+            if (!thresholdsNode.IsMap()) {
+                LOG_S(WARNING) << "thresholds node is not a map";
+                return false;
+            }
+            for (const auto &modeThresholds : thresholdsNode) {
+                std::string recordingModeString;
+                RecordingMode recordingMode;
+                if (!convertNode(modeThresholds.first, recordingModeString) ||
+                    !Enum::convert(recordingModeString, recordingMode) || !modeThresholds.second.IsMap()) {
+                    LOG_S(WARNING) << "could not read thresholds of recording mode from config";
+                    return false;
+                }
+                FeatureThresholds &thresholds = featureConfig.thresholds[recordingMode];
+                const YAML::Node &thresholdNode = modeThresholds.second;
+                if ((thresholdNode["rms"] && !convertNode(thresholdNode["rms"], thresholds.rms)) ||
+                    (thresholdNode["peak"] && !convertNode(thresholdNode["peak"], thresholds.peak)) ||
+                    (thresholdNode["crest_factor"] &&
+                     !convertNode(thresholdNode["crest_factor"], thresholds.crestFactor)) ||
+                    (thresholdNode["band_energy"] &&
+                     !convertNode(thresholdNode["band_energy"], thresholds.bandEnergy))) {
+                    LOG_S(WARNING) << "could not read " << recordingModeString << " thresholds from config";
+                    return false;
+                }
+            }
+        }
+
+        if (node["spectrum"] && !readSpectrumConfig(node["spectrum"], featureConfig.spectrumConfig)) {
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ConfigModule::readSpectrumConfig(const YAML::Node &node, SpectrumConfig &spectrumConfig) {
+        if (!node.IsMap()) {
+            LOG_S(WARNING) << "spectrum node is not a map";
+            return false;
+        }
+
+        if (node["window"]) {
+            std::string windowString;
+            if (!convertNode(node["window"], windowString) ||
+                !Enum::convert(windowString, spectrumConfig.windowSetting)) {
+                LOG_S(WARNING) << "could not read spectrum window from config";
+                return false;
+            }
+        }
+
+        if (node["segment_length"]) {
+            int segmentLength;
+            if (!convertNode(node["segment_length"], segmentLength) || segmentLength < 0 ||
+                (segmentLength > 0 && (segmentLength < 4 || (segmentLength & (segmentLength - 1)) != 0))) {
+                LOG_S(WARNING) << "could not read segment_length from config, must be 0 or a power of two";
+                return false;
+            }
+            spectrumConfig.segmentLength = segmentLength;
+        }
+
+        if (node["overlap"] &&
+            (!convertNode(node["overlap"], spectrumConfig.overlap) || spectrumConfig.overlap < 0 ||
+             spectrumConfig.overlap >= 1)) {
+            LOG_S(WARNING) << "could not read overlap from config, must be in [0, 1)";
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ConfigModule::readAutonullConfig(AutonullConfig &autonullConfig) const {
+        const YAML::Node node = configNode["autonull"];
+        if (!node) {
+            return true;
+        }
+        if (!node.IsMap()) {
+            LOG_S(WARNING) << "autonull node is not a map";
+            return false;
+        }
+
+        std::string modeString;
+        if (!convertNode(node["mode"], modeString)) {
+            LOG_S(WARNING) << "could not read autonull mode from config";
+            return false;
+        }
+        if (!Enum::convert(modeString, autonullConfig.mode)) {
+            LOG_S(WARNING) << "could not convert autonull mode to enum: " << modeString;
+            return false;
+        }
+
+        if (node["calibration_file"] && !convertNode(node["calibration_file"], autonullConfig.calibrationFile)) {
+            LOG_S(WARNING) << "could not read calibration_file from config";
+            return false;
+        }
+        if (autonullConfig.mode == AutonullMode::AUTO && autonullConfig.calibrationFile.empty()) {
+            LOG_S(WARNING) << "autonull mode AUTO needs a calibration_file";
+            return false;
+        }
+
+        if (node["drift_threshold"] && !convertNode(node["drift_threshold"], autonullConfig.driftThreshold)) {
+            LOG_S(WARNING) << "could not read drift_threshold from config";
+            return false;
+        }
+
+        return true;
+    }
+
     bool ConfigModule::readStatusLedConfig(bool &statusLedActivated, int &statusLedPin) const {
         if (!convertNode(configNode["status_led"], statusLedActivated)) {
             LOG_S(WARNING) << "could not read status_led from config";
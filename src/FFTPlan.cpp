@@ -0,0 +1,315 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include "vibration_daq/FFTPlan.hpp"
+
+namespace vibration_daq {
+    namespace {
+        constexpr size_t LANES = 4;
+        // GCC and Clang vector extensions of the size of an SSE resp. NEON register
+        typedef float FloatLanes __attribute__((vector_size(LANES * sizeof(float))));
+
+        typedef int32_t IntLanes __attribute__((vector_size(LANES * sizeof(int32_t))));
+
+        inline FloatLanes load(const float *values) {
+            FloatLanes lanes;
+            std::memcpy(&lanes, values, sizeof(lanes));
+            return lanes;
+        }
+
+        inline void store(float *values, const FloatLanes &lanes) {
+            std::memcpy(values, &lanes, sizeof(lanes));
+        }
+
+        /**
+         * @return lanes I0 to I3 of the concatenation of a and b
+         */
+        template<int I0, int I1, int I2, int I3>
+        inline FloatLanes shuffle(const FloatLanes &a, const FloatLanes &b) {
+#if defined(__clang__)
+            return __builtin_shufflevector(a, b, I0, I1, I2, I3);
+#else
+            return __builtin_shuffle(a, b, IntLanes{I0, I1, I2, I3});
+#endif
+        }
+
+        /**
+         * Transposes the 4x4 matrix of which a to d are the rows.
+         */
+        inline void transpose(FloatLanes &a, FloatLanes &b, FloatLanes &c, FloatLanes &d) {
+            const FloatLanes ab01 = shuffle<0, 4, 1, 5>(a, b), ab23 = shuffle<2, 6, 3, 7>(a, b);
+            const FloatLanes cd01 = shuffle<0, 4, 1, 5>(c, d), cd23 = shuffle<2, 6, 3, 7>(c, d);
+            a = shuffle<0, 1, 4, 5>(ab01, cd01);
+            b = shuffle<2, 3, 6, 7>(ab01, cd01);
+            c = shuffle<0, 1, 4, 5>(ab23, cd23);
+            d = shuffle<2, 3, 6, 7>(ab23, cd23);
+        }
+
+        /**
+         * Complex values of float or FloatLanes.
+         */
+        template<typename V>
+        struct Complex {
+            V real;
+            V imaginary;
+        };
+
+        template<typename V>
+        inline Complex<V> operator+(const Complex<V> &a, const Complex<V> &b) {
+            return {a.real + b.real, a.imaginary + b.imaginary};
+        }
+
+        template<typename V>
+        inline Complex<V> operator-(const Complex<V> &a, const Complex<V> &b) {
+            return {a.real - b.real, a.imaginary - b.imaginary};
+        }
+
+        template<typename V>
+        inline Complex<V> operator*(const Complex<V> &a, const Complex<V> &b) {
+            return {a.real * b.real - a.imaginary * b.imaginary, a.real * b.imaginary + a.imaginary * b.real};
+        }
+
+        /**
+         * Radix-4 decimation in frequency butterfly, a to d are replaced by the outputs 0 to 3.
+         * @param w1, w2, w3 twiddle factors w^p, w^2p, w^3p
+         */
+        template<typename V>
+        inline void butterfly(Complex<V> &a, Complex<V> &b, Complex<V> &c, Complex<V> &d, const Complex<V> &w1,
+                              const Complex<V> &w2, const Complex<V> &w3) {
+            const Complex<V> sumAC = a + c, differenceAC = a - c, sumBD = b + d;
+            const Complex<V> rotatedBD = {d.imaginary - b.imaginary, b.real - d.real}; // j * (b - d)
+            a = sumAC + sumBD;
+            b = (differenceAC - rotatedBD) * w1;
+            c = (sumAC - sumBD) * w2;
+            d = (differenceAC + rotatedBD) * w3;
+        }
+
+        /**
+         * Bin k of the real samples from bins k and n - k of the packed transform (Z), n = size / 2.
+         * @param mirrored conj(Z[n - k])
+         * @param w w_size^k
+         */
+        template<typename V>
+        inline Complex<V> splitBin(const Complex<V> &bin, const Complex<V> &mirrored, const Complex<V> &w) {
+            const Complex<V> even = {(bin.real + mirrored.real) * 0.5f, (bin.imaginary + mirrored.imaginary) * 0.5f};
+            // (Z[k] - conj(Z[n - k])) / 2j
+            const Complex<V> odd = {(bin.imaginary - mirrored.imaginary) * 0.5f,
+                                    (mirrored.real - bin.real) * 0.5f};
+            return even + odd * w;
+        }
+
+        inline Complex<FloatLanes> load(const float *real, const float *imaginary) {
+            Complex<FloatLanes> lanes;
+            std::memcpy(&lanes.real, real, sizeof(FloatLanes));
+            std::memcpy(&lanes.imaginary, imaginary, sizeof(FloatLanes));
+            return lanes;
+        }
+
+        inline void store(float *real, float *imaginary, const Complex<FloatLanes> &lanes) {
+            std::memcpy(real, &lanes.real, sizeof(FloatLanes));
+            std::memcpy(imaginary, &lanes.imaginary, sizeof(FloatLanes));
+        }
+    }
+
+    FFTPlan::FFTPlan(size_t size) : size(size) {
+        const size_t complexSize = size / 2;
+        size_t length = complexSize, stride = 1;
+        for (; length >= 4; length /= 4, stride *= 4) {
+            stages.push_back({length, stride, twiddles.size()});
+            const size_t quarter = length / 4;
+            twiddles.resize(twiddles.size() + 6 * quarter);
+            float *stageTwiddles = twiddles.data() + stages.back().twiddlesOffset;
+            for (size_t p = 0; p < quarter; ++p) {
+                for (size_t power = 1; power <= 3; ++power) {
+                    const double angle = -2 * M_PI * static_cast<double>(power * p) / static_cast<double>(length);
+                    stageTwiddles[(2 * power - 2) * quarter + p] = static_cast<float>(std::cos(angle));
+                    stageTwiddles[(2 * power - 1) * quarter + p] = static_cast<float>(std::sin(angle));
+                }
+            }
+        }
+        radix2Stage = length == 2;
+
+        splitTwiddles.resize(size);
+        for (size_t k = 0; k < complexSize; ++k) {
+            const double angle = -2 * M_PI * static_cast<double>(k) / static_cast<double>(size);
+            splitTwiddles[k] = static_cast<float>(std::cos(angle));
+            splitTwiddles[complexSize + k] = static_cast<float>(std::sin(angle));
+        }
+    }
+
+    std::shared_ptr<const FFTPlan> FFTPlan::get(size_t size) {
+        if (size < 4 || (size & (size - 1)) != 0) {
+            return nullptr;
+        }
+        static std::mutex mutex;
+        static std::map<size_t, std::shared_ptr<const FFTPlan>> plans; // per size
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<const FFTPlan> &plan = plans[size];
+        if (!plan) {
+            plan = std::shared_ptr<const FFTPlan>(new FFTPlan(size));
+        }
+        return plan;
+    }
+
+    size_t FFTPlan::getSize() const {
+        return size;
+    }
+
+    // out[q + stride * (4p + k)] = butterfly k of in[q + stride * (p + k * length / 4)]
+    void FFTPlan::radix4Stage(const Stage &stage, const float *inReal, const float *inImaginary, float *outReal,
+                              float *outImaginary) const {
+        const size_t quarter = stage.length / 4;
+        const size_t stride = stage.stride;
+        const float *stageTwiddles = twiddles.data() + stage.twiddlesOffset;
+
+        if (stride >= LANES) {
+            // the lanes run along q, the twiddles are the same for all lanes
+            for (size_t p = 0; p < quarter; ++p) {
+                const Complex<FloatLanes> w1 = {stageTwiddles[p] - FloatLanes{},
+                                                stageTwiddles[quarter + p] - FloatLanes{}};
+                const Complex<FloatLanes> w2 = {stageTwiddles[2 * quarter + p] - FloatLanes{},
+                                                stageTwiddles[3 * quarter + p] - FloatLanes{}};
+                const Complex<FloatLanes> w3 = {stageTwiddles[4 * quarter + p] - FloatLanes{},
+                                                stageTwiddles[5 * quarter + p] - FloatLanes{}};
+                const size_t inOffset = stride * p, inDistance = stride * quarter, outOffset = stride * 4 * p;
+                for (size_t q = 0; q < stride; q += LANES) {
+                    const size_t in = inOffset + q, out = outOffset + q;
+                    Complex<FloatLanes> a = load(inReal + in, inImaginary + in);
+                    Complex<FloatLanes> b = load(inReal + in + inDistance, inImaginary + in + inDistance);
+                    Complex<FloatLanes> c = load(inReal + in + 2 * inDistance, inImaginary + in + 2 * inDistance);
+                    Complex<FloatLanes> d = load(inReal + in + 3 * inDistance, inImaginary + in + 3 * inDistance);
+                    butterfly(a, b, c, d, w1, w2, w3);
+                    store(outReal + out, outImaginary + out, a);
+                    store(outReal + out + stride, outImaginary + out + stride, b);
+                    store(outReal + out + 2 * stride, outImaginary + out + 2 * stride, c);
+                    store(outReal + out + 3 * stride, outImaginary + out + 3 * stride, d);
+                }
+            }
+            return;
+        }
+
+        if (stride == 1 && quarter >= LANES) {
+            // first stage: the lanes run along p, the outputs of a butterfly are adjacent
+            for (size_t p = 0; p < quarter; p += LANES) {
+                Complex<FloatLanes> a = load(inReal + p, inImaginary + p);
+                Complex<FloatLanes> b = load(inReal + quarter + p, inImaginary + quarter + p);
+                Complex<FloatLanes> c = load(inReal + 2 * quarter + p, inImaginary + 2 * quarter + p);
+                Complex<FloatLanes> d = load(inReal + 3 * quarter + p, inImaginary + 3 * quarter + p);
+                butterfly(a, b, c, d, load(stageTwiddles + p, stageTwiddles + quarter + p),
+                          load(stageTwiddles + 2 * quarter + p, stageTwiddles + 3 * quarter + p),
+                          load(stageTwiddles + 4 * quarter + p, stageTwiddles + 5 * quarter + p));
+                // lane i of a to d are the outputs 4 (p + i) to 4 (p + i) + 3
+                transpose(a.real, b.real, c.real, d.real);
+                transpose(a.imaginary, b.imaginary, c.imaginary, d.imaginary);
+                store(outReal + 4 * p, outImaginary + 4 * p, a);
+                store(outReal + 4 * p + 4, outImaginary + 4 * p + 4, b);
+                store(outReal + 4 * p + 8, outImaginary + 4 * p + 8, c);
+                store(outReal + 4 * p + 12, outImaginary + 4 * p + 12, d);
+            }
+            return;
+        }
+
+        for (size_t p = 0; p < quarter; ++p) {
+            const Complex<float> w1 = {stageTwiddles[p], stageTwiddles[quarter + p]};
+            const Complex<float> w2 = {stageTwiddles[2 * quarter + p], stageTwiddles[3 * quarter + p]};
+            const Complex<float> w3 = {stageTwiddles[4 * quarter + p], stageTwiddles[5 * quarter + p]};
+            for (size_t q = 0; q < stride; ++q) {
+                Complex<float> values[4];
+                for (size_t k = 0; k < 4; ++k) {
+                    values[k] = {inReal[q + stride * (p + k * quarter)], inImaginary[q + stride * (p + k * quarter)]};
+                }
+                butterfly(values[0], values[1], values[2], values[3], w1, w2, w3);
+                for (size_t k = 0; k < 4; ++k) {
+                    outReal[q + stride * (4 * p + k)] = values[k].real;
+                    outImaginary[q + stride * (4 * p + k)] = values[k].imaginary;
+                }
+            }
+        }
+    }
+
+    int FFTPlan::transformComplex(float *real[2], float *imaginary[2]) const {
+        int in = 0;
+        for (const auto &stage : stages) {
+            radix4Stage(stage, real[in], imaginary[in], real[1 - in], imaginary[1 - in]);
+            in = 1 - in;
+        }
+        if (radix2Stage) {
+            const size_t stride = size / 4;
+            const float *inReal = real[in], *inImaginary = imaginary[in];
+            float *outReal = real[1 - in], *outImaginary = imaginary[1 - in];
+            size_t q = 0;
+            for (; q + LANES <= stride; q += LANES) {
+                const Complex<FloatLanes> a = load(inReal + q, inImaginary + q);
+                const Complex<FloatLanes> b = load(inReal + q + stride, inImaginary + q + stride);
+                store(outReal + q, outImaginary + q, a + b);
+                store(outReal + q + stride, outImaginary + q + stride, a - b);
+            }
+            for (; q < stride; ++q) {
+                const Complex<float> a = {inReal[q], inImaginary[q]};
+                const Complex<float> b = {inReal[q + stride], inImaginary[q + stride]};
+                const Complex<float> sum = a + b, difference = a - b;
+                outReal[q] = sum.real;
+                outImaginary[q] = sum.imaginary;
+                outReal[q + stride] = difference.real;
+                outImaginary[q + stride] = difference.imaginary;
+            }
+            in = 1 - in;
+        }
+        return in;
+    }
+
+    void FFTPlan::transform(const float *samples, std::vector<float> &real, std::vector<float> &imaginary) const {
+        const size_t complexSize = size / 2;
+        thread_local std::vector<float> buffers;
+        buffers.resize(4 * complexSize);
+        float *bufferReal[2] = {buffers.data(), buffers.data() + complexSize};
+        float *bufferImaginary[2] = {buffers.data() + 2 * complexSize, buffers.data() + 3 * complexSize};
+
+        // even samples are the real, odd samples the imaginary part
+        size_t k = 0;
+        for (; k + LANES <= complexSize; k += LANES) {
+            const FloatLanes first = load(samples + 2 * k), second = load(samples + 2 * k + LANES);
+            store(bufferReal[0] + k, shuffle<0, 2, 4, 6>(first, second));
+            store(bufferImaginary[0] + k, shuffle<1, 3, 5, 7>(first, second));
+        }
+        for (; k < complexSize; ++k) {
+            bufferReal[0][k] = samples[2 * k];
+            bufferImaginary[0][k] = samples[2 * k + 1];
+        }
+        const int result = transformComplex(bufferReal, bufferImaginary);
+        const float *transformedReal = bufferReal[result], *transformedImaginary = bufferImaginary[result];
+
+        real.resize(complexSize + 1);
+        imaginary.resize(complexSize + 1);
+        real[0] = transformedReal[0] + transformedImaginary[0];
+        imaginary[0] = 0;
+        real[complexSize] = transformedReal[0] - transformedImaginary[0];
+        imaginary[complexSize] = 0;
+        const float *twiddlesReal = splitTwiddles.data(), *twiddlesImaginary = splitTwiddles.data() + complexSize;
+        for (k = 1; k + LANES <= complexSize; k += LANES) {
+            // lanes of bins n - k - 3 to n - k, reversed
+            const size_t mirroredK = complexSize - k - (LANES - 1);
+            const FloatLanes mirroredReal = load(transformedReal + mirroredK);
+            const FloatLanes mirroredImaginary = load(transformedImaginary + mirroredK);
+            const Complex<FloatLanes> mirrored = {shuffle<3, 2, 1, 0>(mirroredReal, mirroredReal),
+                                                  -shuffle<3, 2, 1, 0>(mirroredImaginary, mirroredImaginary)};
+            store(real.data() + k, imaginary.data() + k,
+                  splitBin(load(transformedReal + k, transformedImaginary + k), mirrored,
+                           load(twiddlesReal + k, twiddlesImaginary + k)));
+        }
+        for (; k < complexSize; ++k) {
+            const Complex<float> bin = splitBin<float>(
+                    {transformedReal[k], transformedImaginary[k]},
+                    {transformedReal[complexSize - k], -transformedImaginary[complexSize - k]},
+                    {twiddlesReal[k], twiddlesImaginary[k]});
+            real[k] = bin.real;
+            imaginary[k] = bin.imaginary;
+        }
+    }
+}
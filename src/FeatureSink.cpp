@@ -0,0 +1,298 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <date/date.h>
+#include "vibration_daq/FeatureSink.hpp"
+#include "vibration_daq/RetentionManager.hpp"
+#include "vibration_daq/StorageModule.hpp"
+#include "vibration_daq/SpectrumAnalyzer.hpp"
+#include "vibration_daq/utils/FeatureUtils.hpp"
+#include "loguru/loguru.hpp"
+
+namespace vibration_daq {
+    // a feature which hardly varies still needs to change by this fraction of its mean to deviate
+    static const double MIN_RELATIVE_DEVIATION = 0.01;
+
+    FeatureSink::~FeatureSink() {
+        close();
+    }
+
+    bool FeatureSink::setup(const fs::path &directory, const FeatureConfig &featureConfig,
+                            const StorageConfig &storageConfig, std::unique_ptr<CaptureSink> rawSink) {
+        if (!fs::is_directory(directory)) {
+            LOG_S(ERROR) << "Features directory does not exist: " << directory;
+            return false;
+        }
+        this->directory = directory;
+        this->featureConfig = featureConfig;
+        this->storageConfig = storageConfig;
+        this->rawSink = std::move(rawSink);
+        return true;
+    }
+
+    std::vector<AxisFeatures> FeatureSink::computeFeatures(const VibrationData &vibrationData,
+                                                           const FeatureConfig &featureConfig) {
+        std::vector<AxisFeatures> axesFeatures;
+        const std::map<Axis, AxisStatistics> &statistics = vibrationData.metadata.statistics;
+        std::vector<float> frequencies, spectrum;
+        for (const auto &axis : vibrationData.axes) {
+            // statistics computed on read-out are reused
+            const auto axisStatistics = statistics.find(axis);
+            if (axisStatistics != statistics.end()) {
+                axesFeatures.emplace_back();
+                static_cast<AxisStatistics &>(axesFeatures.back()) = axisStatistics->second;
+            } else {
+                axesFeatures.push_back(computeAxisFeatures(vibrationData.getAxisData(axis)));
+            }
+            if (vibrationData.recordingMode != RecordingMode::MTC) {
+                computeSpectralFeatures(vibrationData.stepAxis, vibrationData.getAxisData(axis), featureConfig.bands,
+                                        featureConfig.spectralPeaksCount, axesFeatures.back());
+            } else if ((!featureConfig.bands.empty() || featureConfig.spectralPeaksCount > 0) &&
+                       SpectrumAnalyzer::computeSpectrum(vibrationData.getAxisData(axis), vibrationData.stepSize,
+                                                         featureConfig.spectrumConfig, frequencies, spectrum)) {
+                // the spectrum of the waveform computed on the host
+                computeSpectralFeatures(frequencies, spectrum, featureConfig.bands, featureConfig.spectralPeaksCount,
+                                        axesFeatures.back());
+            }
+        }
+        return axesFeatures;
+    }
+
+    std::vector<float> FeatureSink::getMonitoredFeatures(const AxisFeatures &axisFeatures) {
+        std::vector<float> features{axisFeatures.rms, axisFeatures.peak, axisFeatures.crestFactor};
+        features.insert(features.end(), axisFeatures.bandEnergies.begin(), axisFeatures.bandEnergies.end());
+        return features;
+    }
+
+    std::string FeatureSink::checkThresholds(RecordingMode recordingMode,
+                                             const std::vector<AxisFeatures> &axesFeatures) const {
+        const auto thresholds = featureConfig.thresholds.find(recordingMode);
+        if (thresholds == featureConfig.thresholds.end()) {
+            return "";
+        }
+        const FeatureThresholds &limits = thresholds->second;
+        const auto exceeds = [](float value, float limit) {
+            return limit > 0 && value > limit;
+        };
+        for (const auto &axisFeatures : axesFeatures) {
+            bool exceeded = exceeds(axisFeatures.rms, limits.rms) || exceeds(axisFeatures.peak, limits.peak) ||
+                            exceeds(axisFeatures.crestFactor, limits.crestFactor);
+            for (const auto &bandEnergy : axisFeatures.bandEnergies) {
+                exceeded = exceeded || exceeds(bandEnergy, limits.bandEnergy);
+            }
+            if (exceeded) {
+                return THRESHOLD_REASON;
+            }
+        }
+        return "";
+    }
+
+    std::string FeatureSink::checkBaselines(const std::string &sensorName, RecordingMode recordingMode,
+                                            const std::vector<Axis> &axes,
+                                            const std::vector<AxisFeatures> &axesFeatures) {
+        if (featureConfig.baselineDeviation <= 0) {
+            return "";
+        }
+
+        std::vector<std::vector<Baseline> *> axesBaselines;
+        std::vector<std::vector<float>> axesMonitoredFeatures;
+        bool deviates = false;
+        for (size_t i = 0; i < axes.size(); ++i) {
+            auto &axisBaselines = baselines[{sensorName, recordingMode, axes[i]}];
+            const std::vector<float> monitoredFeatures = getMonitoredFeatures(axesFeatures[i]);
+            axisBaselines.resize(monitoredFeatures.size());
+            for (size_t j = 0; j < monitoredFeatures.size(); ++j) {
+                const Baseline &baseline = axisBaselines[j];
+                if (baseline.count < featureConfig.baselineCaptures) {
+                    continue;
+                }
+                const double allowed = featureConfig.baselineDeviation *
+                                       std::max(std::sqrt(baseline.variance),
+                                                MIN_RELATIVE_DEVIATION * std::abs(baseline.mean));
+                deviates = deviates || std::abs(monitoredFeatures[j] - baseline.mean) > allowed;
+            }
+            axesBaselines.push_back(&axisBaselines);
+            axesMonitoredFeatures.push_back(monitoredFeatures);
+        }
+        if (deviates) {
+            // the baseline doesn't learn from anomalies
+            return DEVIATION_REASON;
+        }
+
+        for (size_t i = 0; i < axesBaselines.size(); ++i) {
+            for (size_t j = 0; j < axesMonitoredFeatures[i].size(); ++j) {
+                Baseline &baseline = (*axesBaselines[i])[j];
+                // the plain mean and variance while learning, exponentially weighted afterwards
+                const double weight = 1.0 / std::min(baseline.count + 1, featureConfig.baselineCaptures);
+                const double difference = axesMonitoredFeatures[i][j] - baseline.mean;
+                baseline.mean += weight * difference;
+                baseline.variance = (1 - weight) * (baseline.variance + weight * difference * difference);
+                ++baseline.count;
+            }
+        }
+        return "";
+    }
+
+    static bool writeAll(int fd, const std::string &data) {
+        size_t written = 0;
+        while (written < data.size()) {
+            const ssize_t result = ::write(fd, data.data() + written, data.size() - written);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                return false;
+            }
+            written += result;
+        }
+        return true;
+    }
+
+    bool FeatureSink::openFeaturesFile(const std::string &sensorName, const HostTimestamp &triggerTimestamp,
+                                       FeaturesFile &featuresFile) const {
+        const std::string startString = date::format("%FT%H_%M_%S", date::floor<std::chrono::milliseconds>(
+                triggerTimestamp.getSystemTimePoint()));
+        const fs::path featuresPath = directory / (RetentionManager::FEATURES_PREFIX + sensorName + "_" +
+                                                   startString + ".csv");
+        featuresFile.fd = ::open(featuresPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (featuresFile.fd < 0) {
+            LOG_S(ERROR) << "Could not open features file " << featuresPath << ": " << std::strerror(errno);
+            return false;
+        }
+        featuresFile.lastSync = std::chrono::steady_clock::now();
+
+        std::ostringstream header;
+        header << "Trigger Timestamp,Recording Mode,Axis,Mean,RMS,Std Dev,Peak,Peak To Peak,Crest Factor,"
+                            "Skewness,Kurtosis";
+        for (const auto &band : featureConfig.bands) {
+            header << ",Band " << band.min << "-" << band.max << " Hz";
+        }
+        for (int i = 1; i <= featureConfig.spectralPeaksCount; ++i) {
+            header << ",Peak " << i << " Frequency,Peak " << i << " Amplitude";
+        }
+        header << ",Raw" << '\n';
+        if (!writeAll(featuresFile.fd, header.str())) {
+            LOG_S(ERROR) << "Could not write features file " << featuresPath << ": " << std::strerror(errno);
+            ::close(featuresFile.fd);
+            featuresFile.fd = -1;
+            return false;
+        }
+
+        // the directory entry of the new file is persisted once
+        if (storageConfig.syncMode != SyncMode::NEVER) {
+            int directoryFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (directoryFd >= 0) {
+                ::fsync(directoryFd);
+                ::close(directoryFd);
+            }
+        }
+        LOG_S(INFO) << "Opened features file: " << featuresPath;
+        return true;
+    }
+
+    bool FeatureSink::appendFeatures(const VibrationData &vibrationData, const std::string &sensorName,
+                                     const HostTimestamp &triggerTimestamp,
+                                     const std::vector<AxisFeatures> &axesFeatures, const std::string &rawReason) {
+        FeaturesFile &featuresFile = featuresFiles[sensorName];
+        if (featuresFile.fd < 0 && !openFeaturesFile(sensorName, triggerTimestamp, featuresFile)) {
+            featuresFiles.erase(sensorName);
+            return false;
+        }
+
+        std::ostringstream lines;
+        const std::string triggerTimestampString = date::format(
+                "%FT%TZ", date::floor<std::chrono::milliseconds>(triggerTimestamp.getSystemTimePoint()));
+        for (size_t i = 0; i < axesFeatures.size(); ++i) {
+            const AxisFeatures &axisFeatures = axesFeatures[i];
+            lines << triggerTimestampString << "," << Enum::toString(vibrationData.recordingMode) << ","
+                  << Enum::toString(vibrationData.axes[i]) << "," << axisFeatures.mean << ","
+                  << axisFeatures.rms << "," << axisFeatures.stdDev << "," << axisFeatures.peak << ","
+                  << axisFeatures.peakToPeak << "," << axisFeatures.crestFactor << ","
+                  << axisFeatures.skewness << "," << axisFeatures.kurtosis;
+            // the spectral columns are empty if the spectrum could not be computed
+            for (size_t band = 0; band < featureConfig.bands.size(); ++band) {
+                lines << ",";
+                if (band < axisFeatures.bandEnergies.size()) {
+                    lines << axisFeatures.bandEnergies[band];
+                }
+            }
+            for (size_t peak = 0; peak < static_cast<size_t>(featureConfig.spectralPeaksCount); ++peak) {
+                lines << ",";
+                if (peak < axisFeatures.spectralPeaks.size()) {
+                    lines << axisFeatures.spectralPeaks[peak].frequency << ","
+                          << axisFeatures.spectralPeaks[peak].amplitude;
+                } else {
+                    lines << ",";
+                }
+            }
+            lines << "," << rawReason << '\n';
+        }
+        if (!writeAll(featuresFile.fd, lines.str())) {
+            LOG_S(ERROR) << "Could not write features file of " << sensorName << ": " << std::strerror(errno);
+            ::close(featuresFile.fd);
+            featuresFiles.erase(sensorName);
+            return false;
+        }
+
+        ++featuresFile.pendingCaptures;
+        if (storageConfig.syncMode == SyncMode::NEVER ||
+            !StorageModule::isSyncDue(storageConfig, featuresFile.pendingCaptures, featuresFile.lastSync)) {
+            return true;
+        }
+        featuresFile.pendingCaptures = 0;
+        featuresFile.lastSync = std::chrono::steady_clock::now();
+        if (::fsync(featuresFile.fd) != 0) {
+            LOG_S(ERROR) << "Could not sync features file of " << sensorName << ": " << std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    bool FeatureSink::storeVibrationData(const VibrationData &vibrationData, const std::string &sensorName,
+                                         const HostTimestamp &triggerTimestamp) {
+        const std::vector<AxisFeatures> axesFeatures = computeFeatures(vibrationData, featureConfig);
+
+        std::string rawReason = checkThresholds(vibrationData.recordingMode, axesFeatures);
+        // the baseline is checked and learned in any case
+        const std::string deviationReason = checkBaselines(sensorName, vibrationData.recordingMode,
+                                                           vibrationData.axes, axesFeatures);
+        if (rawReason.empty()) {
+            rawReason = deviationReason;
+        }
+        const int capturesCount = capturesCounts[sensorName]++;
+        if (rawReason.empty() && featureConfig.rawInterval > 0 && capturesCount % featureConfig.rawInterval == 0) {
+            rawReason = INTERVAL_REASON;
+        }
+        if (!rawSink) {
+            rawReason.clear();
+        }
+
+        bool stored = appendFeatures(vibrationData, sensorName, triggerTimestamp, axesFeatures, rawReason);
+        if (!rawReason.empty()) {
+            LOG_S(INFO) << sensorName << ": Keeping raw capture, reason: " << rawReason;
+            stored = rawSink->storeVibrationData(vibrationData, sensorName, triggerTimestamp) && stored;
+        }
+        return stored;
+    }
+
+    void FeatureSink::close() {
+        for (auto &featuresFile : featuresFiles) {
+            if (featuresFile.second.pendingCaptures > 0 && storageConfig.syncMode != SyncMode::NEVER) {
+                ::fsync(featuresFile.second.fd);
+            }
+            ::close(featuresFile.second.fd);
+        }
+        featuresFiles.clear();
+        if (rawSink) {
+            rawSink->close();
+        }
+    }
+}
@@ -0,0 +1,48 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <algorithm>
+#include "vibration_daq/RecordingScheduler.hpp"
+
+namespace vibration_daq {
+    void RecordingScheduler::addSchedule(const std::vector<ScheduleEntry> &schedule) {
+        schedules.push_back(schedule);
+        // the first entry is activated on setup
+        lastEntryIndices.push_back(0);
+    }
+
+    std::vector<std::vector<const ScheduleEntry *>> RecordingScheduler::planCycle(unsigned long cycle) {
+        std::vector<std::vector<const ScheduleEntry *>> rounds;
+
+        for (int sensor = 0; sensor < schedules.size(); ++sensor) {
+            const auto &schedule = schedules[sensor];
+
+            std::vector<int> dueEntryIndices;
+            for (int i = 0; i < schedule.size(); ++i) {
+                if (cycle % schedule[i].interval == 0) {
+                    dueEntryIndices.push_back(i);
+                }
+            }
+            if (dueEntryIndices.empty()) {
+                continue;
+            }
+
+            auto lastEntryIt = std::find(dueEntryIndices.begin(), dueEntryIndices.end(), lastEntryIndices[sensor]);
+            if (lastEntryIt != dueEntryIndices.end()) {
+                std::rotate(dueEntryIndices.begin(), lastEntryIt, dueEntryIndices.end());
+            }
+
+            for (int round = 0; round < dueEntryIndices.size(); ++round) {
+                if (rounds.size() <= round) {
+                    rounds.emplace_back(schedules.size(), nullptr);
+                }
+                rounds[round][sensor] = &schedule[dueEntryIndices[round]];
+            }
+            lastEntryIndices[sensor] = dueEntryIndices.back();
+        }
+
+        return rounds;
+    }
+}
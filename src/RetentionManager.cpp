@@ -0,0 +1,418 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sys/stat.h>
+#include <date/date.h>
+#include "vibration_daq/RetentionManager.hpp"
+#include "vibration_daq/StorageModule.hpp"
+#include "vibration_daq/SegmentArchive.hpp"
+#include "vibration_daq/CaptureIndex.hpp"
+#include "vibration_daq/utils/FeatureUtils.hpp"
+#include "vibration_daq/utils/TimeUtils.hpp"
+#include "loguru/loguru.hpp"
+
+namespace vibration_daq {
+    static bool startsWith(const std::string &string, const std::string &prefix) {
+        return string.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    static bool endsWith(const std::string &string, const std::string &suffix) {
+        return string.size() >= suffix.size() &&
+               string.compare(string.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    static fs::path getMetadataPath(const fs::path &dataFilePath) {
+        return fs::path(dataFilePath).replace_extension(".yaml");
+    }
+
+    RetentionManager::~RetentionManager() {
+        stop();
+    }
+
+    bool RetentionManager::start(const fs::path &storageDirectory, const RetentionConfig &retentionConfig) {
+        stop();
+        if (retentionConfig.quota == 0 && retentionConfig.maxAge == 0) {
+            return true;
+        }
+        this->storageDirectory = storageDirectory;
+        this->retentionConfig = retentionConfig;
+        stopRequested = false;
+        enforceRequested = false;
+        worker = std::thread(&RetentionManager::run, this);
+        LOG_S(INFO) << "Retention started, quota: " << retentionConfig.quota / (1024 * 1024) << " MiB, max age: "
+                    << retentionConfig.maxAge << " days, aged out: " << Enum::toString(retentionConfig.agedOutMode);
+        return true;
+    }
+
+    void RetentionManager::stop() {
+        if (!worker.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopRequested = true;
+        }
+        condition.notify_one();
+        worker.join();
+    }
+
+    bool RetentionManager::isStopRequested() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stopRequested;
+    }
+
+    void RetentionManager::notifyStored(const std::string &fileName, uint64_t size, int64_t newestRealtimeNs) {
+        if (!worker.joinable()) {
+            return;
+        }
+        bool quotaExceeded;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            track(fileName, size, newestRealtimeNs, FileTier::RAW);
+            quotaExceeded = retentionConfig.quota > 0 && usage > retentionConfig.quota;
+            enforceRequested = enforceRequested || quotaExceeded;
+        }
+        if (quotaExceeded) {
+            condition.notify_one();
+        }
+    }
+
+    void RetentionManager::track(const std::string &fileName, uint64_t size, int64_t newestRealtimeNs,
+                                 FileTier tier) {
+        untrack(fileName);
+
+        StoredFile storedFile;
+        storedFile.size = size;
+        storedFile.newestRealtimeNs = newestRealtimeNs;
+        storedFile.tier = tier;
+        storedFiles[fileName] = storedFile;
+        usage += size;
+
+        if (tier == FileTier::RAW) {
+            rawByAge.emplace(newestRealtimeNs, fileName);
+        }
+        if (tier != FileTier::FEATURES) {
+            removableByAge.emplace(newestRealtimeNs, fileName);
+        }
+    }
+
+    void RetentionManager::untrack(const std::string &fileName) {
+        auto storedFileIt = storedFiles.find(fileName);
+        if (storedFileIt == storedFiles.end()) {
+            return;
+        }
+        const AgeKey ageKey(storedFileIt->second.newestRealtimeNs, fileName);
+        rawByAge.erase(ageKey);
+        removableByAge.erase(ageKey);
+        usage -= std::min(usage, storedFileIt->second.size);
+        storedFiles.erase(storedFileIt);
+    }
+
+    void RetentionManager::scan() {
+        std::error_code errorCode;
+        for (const auto &entry : fs::directory_iterator(storageDirectory, errorCode)) {
+            if (!entry.is_regular_file()) {
+                continue;
+            }
+            std::string fileName = entry.path().filename().string();
+            std::error_code sizeErrorCode;
+            uint64_t size = entry.file_size(sizeErrorCode);
+            if (sizeErrorCode) {
+                continue;
+            }
+
+            // the time of the newest capture, the modification time if it is not known from the file name
+            struct stat fileStat{};
+            int64_t newestRealtimeNs = ::stat(entry.path().c_str(), &fileStat) == 0 ?
+                                       toNanoseconds(fileStat.st_mtim) : 0;
+
+            FileTier tier;
+            CaptureLocation captureLocation;
+            if (startsWith(fileName, FEATURES_PREFIX) || startsWith(fileName, AGED_FEATURES_PREFIX)) {
+                tier = FileTier::FEATURES;
+            } else if (startsWith(fileName, DOWNSAMPLED_PREFIX) && endsWith(fileName, ".csv")) {
+                tier = FileTier::DOWNSAMPLED;
+                if (CaptureIndex::parseCSVFileName(fileName.substr(std::string(DOWNSAMPLED_PREFIX).size()),
+                                                   captureLocation)) {
+                    newestRealtimeNs = captureLocation.triggerRealtimeNs;
+                }
+            } else if (CaptureIndex::parseCSVFileName(fileName, captureLocation)) {
+                tier = FileTier::RAW;
+                newestRealtimeNs = captureLocation.triggerRealtimeNs;
+                const uint64_t metadataSize = fs::file_size(getMetadataPath(entry.path()), sizeErrorCode);
+                size += sizeErrorCode ? 0 : metadataSize;
+            } else if (endsWith(fileName, SegmentArchive::SEGMENT_EXTENSION) ||
+                       endsWith(fileName, std::string(SegmentArchive::SEGMENT_EXTENSION) +
+                                          SegmentArchive::OPEN_EXTENSION)) {
+                tier = FileTier::RAW;
+                if (entry.path().extension() == SegmentArchive::OPEN_EXTENSION) {
+                    fileName = entry.path().stem().string();
+                }
+                std::vector<SegmentIndexEntry> index;
+                if (SegmentArchive::readIndex(entry.path(), index) && !index.empty()) {
+                    newestRealtimeNs = index.back().triggerRealtimeNs;
+                }
+            } else {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            // captures stored since the start are tracked already
+            if (storedFiles.count(fileName) == 0) {
+                track(fileName, size, newestRealtimeNs, tier);
+            }
+        }
+        if (errorCode) {
+            LOG_S(ERROR) << "Could not scan storage directory " << storageDirectory << ": " << errorCode.message();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        LOG_S(INFO) << "Retention tracks " << storedFiles.size() << " files, " << usage / (1024 * 1024) << " MiB";
+    }
+
+    void RetentionManager::run() {
+        loguru::set_thread_name("retention");
+        scan();
+        while (true) {
+            enforce();
+
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait_for(lock, CHECK_INTERVAL, [this] { return stopRequested || enforceRequested; });
+            if (stopRequested) {
+                return;
+            }
+            enforceRequested = false;
+        }
+    }
+
+    bool RetentionManager::findOldest(const std::set<AgeKey> &byAge, int64_t beforeRealtimeNs,
+                                      const std::set<std::string> &skipped, std::string &fileName) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &ageKey : byAge) {
+            if (ageKey.first >= beforeRealtimeNs) {
+                return false;
+            }
+            const std::string openPath = (storageDirectory / ageKey.second).string() + SegmentArchive::OPEN_EXTENSION;
+            if (skipped.count(ageKey.second) == 0 && !fs::exists(openPath)) {
+                fileName = ageKey.second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void RetentionManager::enforce() {
+        // files which could not be processed are retried on the next check
+        std::set<std::string> skipped;
+        std::string fileName;
+
+        if (retentionConfig.maxAge > 0) {
+            const int64_t maxAgeNs = static_cast<int64_t>(retentionConfig.maxAge) * 24 * 3600 * 1000000000;
+            const int64_t cutoffRealtimeNs = getHostTimestamp().realtimeNs - maxAgeNs;
+            while (!isStopRequested() && findOldest(rawByAge, cutoffRealtimeNs, skipped, fileName)) {
+                if (!ageOut(fileName, retentionConfig.agedOutMode)) {
+                    skipped.insert(fileName);
+                }
+            }
+        }
+
+        if (retentionConfig.quota > 0) {
+            while (!isStopRequested()) {
+                FileTier tier;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (usage <= retentionConfig.quota) {
+                        break;
+                    }
+                }
+                if (!findOldest(removableByAge, std::numeric_limits<int64_t>::max(), skipped, fileName)) {
+                    LOG_S(WARNING) << "Storage quota exceeded, but no file can be removed.";
+                    break;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    tier = storedFiles[fileName].tier;
+                }
+                // downsampling would grow the usage, only features are kept
+                const AgedOutMode agedOutMode = tier == FileTier::RAW &&
+                                                retentionConfig.agedOutMode == AgedOutMode::FEATURES ?
+                                                AgedOutMode::FEATURES : AgedOutMode::DELETE;
+                if (!ageOut(fileName, agedOutMode)) {
+                    skipped.insert(fileName);
+                }
+            }
+        }
+    }
+
+    bool RetentionManager::ageOut(const std::string &fileName, AgedOutMode agedOutMode) {
+        switch (agedOutMode) {
+            case AgedOutMode::FEATURES:
+                if (!forEachCapture(fileName, [this](CaptureRecord &captureRecord) {
+                    return appendFeatures(captureRecord);
+                })) {
+                    LOG_S(ERROR) << "Could not store features of " << fileName;
+                    return false;
+                }
+                break;
+            case AgedOutMode::DOWNSAMPLE:
+                if (!forEachCapture(fileName, [this](CaptureRecord &captureRecord) {
+                    return storeDownsampled(captureRecord);
+                })) {
+                    LOG_S(ERROR) << "Could not downsample " << fileName;
+                    return false;
+                }
+                break;
+            case AgedOutMode::DELETE:
+                break;
+        }
+        return removeFile(fileName);
+    }
+
+    bool RetentionManager::removeFile(const std::string &fileName) {
+        const fs::path filePath = storageDirectory / fileName;
+        std::error_code errorCode;
+        fs::remove(filePath, errorCode);
+        if (errorCode) {
+            LOG_S(ERROR) << "Could not remove " << filePath << ": " << errorCode.message();
+            return false;
+        }
+        if (filePath.extension() == ".csv") {
+            fs::remove(getMetadataPath(filePath), errorCode);
+        }
+        LOG_S(INFO) << "Retention removed " << fileName;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        untrack(fileName);
+        return true;
+    }
+
+    bool RetentionManager::forEachCapture(const std::string &fileName,
+                                          const std::function<bool(CaptureRecord &)> &callback) const {
+        const fs::path filePath = storageDirectory / fileName;
+        CaptureRecord captureRecord;
+
+        if (filePath.extension() == SegmentArchive::SEGMENT_EXTENSION) {
+            std::vector<SegmentIndexEntry> index;
+            if (!SegmentArchive::readIndex(filePath, index)) {
+                return false;
+            }
+            for (const auto &indexEntry : index) {
+                if (!SegmentArchive::readCapture(filePath, indexEntry.offset, captureRecord) ||
+                    !callback(captureRecord)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        CaptureLocation captureLocation;
+        if (!CaptureIndex::parseCSVFileName(fileName, captureLocation) ||
+            !StorageModule::readCSVFile(filePath.string(), captureRecord.vibrationData)) {
+            return false;
+        }
+        captureRecord.sensorName = captureLocation.sensorName;
+        captureRecord.triggerTimestamp.realtimeNs = captureLocation.triggerRealtimeNs;
+        // the header doesn't distinguish MFFT and AFFT
+        captureRecord.vibrationData.recordingMode = captureLocation.recordingMode;
+        return callback(captureRecord);
+    }
+
+    bool RetentionManager::appendFeatures(const CaptureRecord &captureRecord) {
+        const std::string featuresFileName = AGED_FEATURES_PREFIX + captureRecord.sensorName + ".csv";
+        const fs::path featuresPath = storageDirectory / featuresFileName;
+        const bool newFile = !fs::exists(featuresPath);
+
+        std::ofstream featuresFile(featuresPath, std::ios::app);
+        if (!featuresFile) {
+            LOG_S(ERROR) << "Could not open features file: " << featuresPath;
+            return false;
+        }
+        if (newFile) {
+            featuresFile << "Trigger Timestamp,Recording Mode,Axis,Mean,RMS,Std Dev,Peak,Crest Factor" << std::endl;
+        }
+
+        const VibrationData &vibrationData = captureRecord.vibrationData;
+        const std::string triggerTimestamp = date::format(
+                "%FT%TZ", date::floor<std::chrono::milliseconds>(captureRecord.triggerTimestamp.getSystemTimePoint()));
+        for (const auto &axis : vibrationData.axes) {
+            const AxisFeatures axisFeatures = computeAxisFeatures(vibrationData.getAxisData(axis));
+            featuresFile << triggerTimestamp << "," << Enum::toString(vibrationData.recordingMode) << ","
+                         << Enum::toString(axis) << "," << axisFeatures.mean << "," << axisFeatures.rms << ","
+                         << axisFeatures.stdDev << "," << axisFeatures.peak << "," << axisFeatures.crestFactor
+                         << std::endl;
+        }
+        featuresFile.close();
+        if (!featuresFile.good()) {
+            LOG_S(ERROR) << "Could not write features file: " << featuresPath;
+            return false;
+        }
+
+        std::error_code errorCode;
+        const uint64_t size = fs::file_size(featuresPath, errorCode);
+        std::lock_guard<std::mutex> lock(mutex);
+        track(featuresFileName, errorCode ? 0 : size, captureRecord.triggerTimestamp.realtimeNs, FileTier::FEATURES);
+        return true;
+    }
+
+    bool RetentionManager::storeDownsampled(const CaptureRecord &captureRecord) {
+        const VibrationData &vibrationData = captureRecord.vibrationData;
+        const std::string downsampledFileName =
+                DOWNSAMPLED_PREFIX + std::string("vibration_data_") + Enum::toString(vibrationData.recordingMode) +
+                "_" + date::format("%FT%H_%M_%S", date::floor<std::chrono::milliseconds>(
+                        captureRecord.triggerTimestamp.getSystemTimePoint())) +
+                "_" + captureRecord.sensorName + ".csv";
+        const fs::path downsampledPath = storageDirectory / downsampledFileName;
+
+        if (!StorageModule::writeCSVFile(downsample(vibrationData, retentionConfig.downsampleFactor),
+                                         downsampledPath.string())) {
+            return false;
+        }
+
+        std::error_code errorCode;
+        const uint64_t size = fs::file_size(downsampledPath, errorCode);
+        std::lock_guard<std::mutex> lock(mutex);
+        track(downsampledFileName, errorCode ? 0 : size, captureRecord.triggerTimestamp.realtimeNs,
+              FileTier::DOWNSAMPLED);
+        return true;
+    }
+
+    VibrationData RetentionManager::downsample(const VibrationData &vibrationData, int factor) {
+        VibrationData downsampled;
+        downsampled.recordingMode = vibrationData.recordingMode;
+        downsampled.binOffset = vibrationData.binOffset;
+        downsampled.axes = vibrationData.axes;
+        downsampled.metadata = vibrationData.metadata;
+        downsampled.stepSize = vibrationData.stepSize * factor;
+
+        const bool keepMaximum = vibrationData.recordingMode != RecordingMode::MTC;
+        const size_t samplesCount = vibrationData.stepAxis.size();
+        for (size_t blockStart = 0; blockStart < samplesCount; blockStart += factor) {
+            const size_t blockEnd = std::min(samplesCount, blockStart + factor);
+            const float blockSize = blockEnd - blockStart;
+
+            float stepSum = 0;
+            for (size_t i = blockStart; i < blockEnd; ++i) {
+                stepSum += vibrationData.stepAxis[i];
+            }
+            downsampled.stepAxis.push_back(stepSum / blockSize);
+
+            for (const auto &axis : vibrationData.axes) {
+                const std::vector<float> &values = vibrationData.getAxisData(axis);
+                if (values.size() < blockEnd) {
+                    continue;
+                }
+                float blockValue = keepMaximum ? values[blockStart] : 0;
+                for (size_t i = blockStart; i < blockEnd; ++i) {
+                    blockValue = keepMaximum ? std::max(blockValue, values[i]) : blockValue + values[i];
+                }
+                downsampled.getAxisData(axis).push_back(keepMaximum ? blockValue : blockValue / blockSize);
+            }
+        }
+        return downsampled;
+    }
+}
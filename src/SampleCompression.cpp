@@ -0,0 +1,203 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <algorithm>
+#include <cstring>
+#include "vibration_daq/SampleCompression.hpp"
+#include "vibration_daq/utils/BinaryIO.hpp"
+
+namespace vibration_daq {
+    namespace {
+        enum BlockMode : uint8_t {
+            PREDICTOR_NONE = 0,
+            PREDICTOR_DELTA = 1,
+            PREDICTOR_LINEAR = 2,
+            DICTIONARY = 3
+        };
+
+        inline uint32_t zigzagEncode(int32_t value) {
+            return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+        }
+
+        inline int32_t zigzagDecode(uint32_t value) {
+            return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+        }
+
+        inline int32_t predict(uint8_t predictor, int32_t previous, int32_t beforePrevious) {
+            switch (predictor) {
+                case PREDICTOR_DELTA:
+                    return previous;
+                case PREDICTOR_LINEAR:
+                    return 2 * previous - beforePrevious;
+                default:
+                    return 0;
+            }
+        }
+
+        inline unsigned getWidth(uint32_t value) {
+            return value == 0 ? 0 : 32 - __builtin_clz(value);
+        }
+
+        inline size_t getPackedSize(size_t count, unsigned width) {
+            return (count * width + 7) / 8;
+        }
+
+        void pack(const uint32_t *values, size_t count, unsigned width, std::vector<uint8_t> &data) {
+            uint64_t bitBuffer = 0;
+            unsigned bitCount = 0;
+            for (size_t i = 0; i < count; ++i) {
+                bitBuffer |= static_cast<uint64_t>(values[i]) << bitCount;
+                bitCount += width;
+                while (bitCount >= 8) {
+                    data.push_back(static_cast<uint8_t>(bitBuffer));
+                    bitBuffer >>= 8;
+                    bitCount -= 8;
+                }
+            }
+            if (bitCount > 0) {
+                data.push_back(static_cast<uint8_t>(bitBuffer));
+            }
+        }
+    }
+
+    void SampleCompression::encode(const std::vector<int16_t> &samples, std::vector<uint8_t> &data) {
+        uint32_t residuals[BLOCK_SIZE];
+        int16_t dictionary[BLOCK_SIZE];
+        int32_t previous = 0, beforePrevious = 0;
+
+        for (size_t blockStart = 0; blockStart < samples.size(); blockStart += BLOCK_SIZE) {
+            const size_t count = std::min(BLOCK_SIZE, samples.size() - blockStart);
+            const int16_t *block = samples.data() + blockStart;
+
+            // the predictor with the smallest largest residual
+            uint8_t bestPredictor = PREDICTOR_NONE;
+            unsigned bestWidth = MAX_WIDTH + 1;
+            for (uint8_t predictor : {PREDICTOR_NONE, PREDICTOR_DELTA, PREDICTOR_LINEAR}) {
+                uint32_t combined = 0;
+                int32_t p1 = previous, p2 = beforePrevious;
+                for (size_t i = 0; i < count; ++i) {
+                    combined |= zigzagEncode(block[i] - predict(predictor, p1, p2));
+                    p2 = p1;
+                    p1 = block[i];
+                }
+                if (getWidth(combined) < bestWidth) {
+                    bestWidth = getWidth(combined);
+                    bestPredictor = predictor;
+                }
+            }
+
+            std::copy(block, block + count, dictionary);
+            std::sort(dictionary, dictionary + count);
+            const size_t dictionarySize = std::unique(dictionary, dictionary + count) - dictionary;
+            const unsigned indexWidth = getWidth(dictionarySize - 1);
+
+            if (dictionarySize <= MAX_DICTIONARY_SIZE &&
+                2 + dictionarySize * sizeof(int16_t) + getPackedSize(count, indexWidth) <
+                1 + getPackedSize(count, bestWidth)) {
+                for (size_t i = 0; i < count; ++i) {
+                    residuals[i] = std::lower_bound(dictionary, dictionary + dictionarySize, block[i]) - dictionary;
+                }
+                data.push_back(static_cast<uint8_t>(DICTIONARY << 6 | indexWidth));
+                data.push_back(static_cast<uint8_t>(dictionarySize - 1));
+                BinaryWriter(data).writeBytes(dictionary, dictionarySize * sizeof(int16_t));
+                pack(residuals, count, indexWidth, data);
+            } else {
+                int32_t p1 = previous, p2 = beforePrevious;
+                for (size_t i = 0; i < count; ++i) {
+                    residuals[i] = zigzagEncode(block[i] - predict(bestPredictor, p1, p2));
+                    p2 = p1;
+                    p1 = block[i];
+                }
+                data.push_back(static_cast<uint8_t>(bestPredictor << 6 | bestWidth));
+                pack(residuals, count, bestWidth, data);
+            }
+
+            beforePrevious = count >= 2 ? block[count - 2] : previous;
+            previous = block[count - 1];
+        }
+    }
+
+    void SampleCompression::unpackBlock(const uint8_t *data, size_t count, unsigned width, uint32_t *values) {
+        // zero padded copy, so every value is one unaligned 64 bit load without bounds checks
+        uint8_t padded[BLOCK_SIZE * MAX_WIDTH / 8 + sizeof(uint64_t)] = {};
+        std::memcpy(padded, data, getPackedSize(count, width));
+
+        const uint32_t mask = (1u << width) - 1;
+        for (size_t i = 0; i < count; ++i) {
+            const size_t bit = i * width;
+            uint64_t word;
+            std::memcpy(&word, padded + bit / 8, sizeof(word));
+            values[i] = static_cast<uint32_t>(word >> (bit % 8)) & mask;
+        }
+    }
+
+    bool SampleCompression::decode(const uint8_t *data, size_t size, size_t samplesCount,
+                                   std::vector<int16_t> &samples) {
+        BinaryReader reader(data, size);
+        uint32_t residuals[BLOCK_SIZE];
+        int16_t dictionary[MAX_DICTIONARY_SIZE];
+        int32_t previous = 0, beforePrevious = 0;
+
+        samples.resize(samplesCount);
+        for (size_t blockStart = 0; blockStart < samplesCount; blockStart += BLOCK_SIZE) {
+            const size_t count = std::min(BLOCK_SIZE, samplesCount - blockStart);
+            uint8_t header;
+            if (!reader.read(header)) {
+                return false;
+            }
+            const uint8_t mode = header >> 6;
+            const unsigned width = header & 0x3f;
+            if (width > MAX_WIDTH) {
+                return false;
+            }
+
+            uint8_t maxIndex = 0; // dictionary size - 1
+            if (mode == DICTIONARY) {
+                if (!reader.read(maxIndex) || maxIndex >= MAX_DICTIONARY_SIZE ||
+                    !reader.readBytes(dictionary, (maxIndex + 1) * sizeof(int16_t))) {
+                    return false;
+                }
+            }
+            const uint8_t *packed = reader.skip(getPackedSize(count, width));
+            if (!packed) {
+                return false;
+            }
+            unpackBlock(packed, count, width, residuals);
+
+            int16_t *block = samples.data() + blockStart;
+            const int32_t blockPrevious = previous;
+            // one loop per mode keeps the reconstruction free of branches
+            switch (mode) {
+                case PREDICTOR_NONE:
+                    for (size_t i = 0; i < count; ++i) {
+                        block[i] = static_cast<int16_t>(zigzagDecode(residuals[i]));
+                    }
+                    break;
+                case PREDICTOR_DELTA:
+                    for (size_t i = 0; i < count; ++i) {
+                        previous += zigzagDecode(residuals[i]);
+                        block[i] = static_cast<int16_t>(previous);
+                    }
+                    break;
+                case PREDICTOR_LINEAR:
+                    for (size_t i = 0; i < count; ++i) {
+                        const int32_t sample = 2 * previous - beforePrevious + zigzagDecode(residuals[i]);
+                        beforePrevious = previous;
+                        previous = sample;
+                        block[i] = static_cast<int16_t>(sample);
+                    }
+                    break;
+                case DICTIONARY:
+                    for (size_t i = 0; i < count; ++i) {
+                        block[i] = dictionary[std::min<uint32_t>(residuals[i], maxIndex)];
+                    }
+                    break;
+            }
+            beforePrevious = count >= 2 ? block[count - 2] : blockPrevious;
+            previous = block[count - 1];
+        }
+        return reader.getPosition() == size;
+    }
+}
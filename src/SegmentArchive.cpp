@@ -0,0 +1,433 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <date/date.h>
+#include "vibration_daq/SegmentArchive.hpp"
+#include "vibration_daq/CaptureSerializer.hpp"
+#include "vibration_daq/utils/FrameFormat.hpp"
+#include "loguru/loguru.hpp"
+
+namespace vibration_daq {
+    SegmentArchive::SegmentArchive(const fs::path &storageDirectory, const std::string &sensorName,
+                                   const StorageConfig &storageConfig) : storageDirectory(storageDirectory),
+                                                                         sensorName(sensorName),
+                                                                         storageConfig(storageConfig) {}
+
+    SegmentArchive::~SegmentArchive() {
+        close();
+    }
+
+    bool SegmentArchive::writeAll(int fd, const void *data, size_t size, uint64_t offset) {
+        auto bytes = static_cast<const uint8_t *>(data);
+        while (size > 0) {
+            ssize_t written = ::pwrite(fd, bytes, size, offset);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            bytes += written;
+            size -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    bool SegmentArchive::openSegment(const HostTimestamp &timestamp) {
+        const std::string startString = date::format("%FT%H_%M_%S", date::floor<std::chrono::milliseconds>(
+                timestamp.getSystemTimePoint()));
+        const std::string segmentName = "vibration_data_" + sensorName + "_" + startString;
+        segmentPath = storageDirectory / (segmentName + SEGMENT_EXTENSION);
+        // a closed segment of the same millisecond must not be overwritten by the rename on close
+        for (int i = 1; fs::exists(segmentPath); ++i) {
+            segmentPath = storageDirectory / (segmentName + "_" + std::to_string(i) + SEGMENT_EXTENSION);
+        }
+        const std::string openSegmentPath = segmentPath.string() + OPEN_EXTENSION;
+
+        int flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+        if (storageConfig.directIO) {
+            flags |= O_DIRECT;
+        }
+        fd = ::open(openSegmentPath.c_str(), flags, 0644);
+        if (fd < 0 && errno == EINVAL && storageConfig.directIO) {
+            LOG_S(WARNING) << "O_DIRECT is not supported by the file system of " << openSegmentPath;
+            fd = ::open(openSegmentPath.c_str(), flags & ~O_DIRECT, 0644);
+        }
+        if (fd < 0) {
+            LOG_S(ERROR) << "Could not create segment " << openSegmentPath << ": " << std::strerror(errno);
+            return false;
+        }
+
+        // contiguous blocks for the whole segment, the file size still grows with the written data
+        if (storageConfig.preallocate &&
+            ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(storageConfig.segmentMaxSize)) != 0) {
+            LOG_S(WARNING) << "Could not preallocate segment " << openSegmentPath << ": " << std::strerror(errno);
+        }
+
+        if (writeBuffer.getCapacity() != storageConfig.writeBlockSize) {
+            writeBuffer = AlignedBuffer(IO_ALIGNMENT, storageConfig.writeBlockSize);
+        }
+        writeBuffer.clear();
+        bufferOffset = 0;
+
+        std::vector<uint8_t> payload;
+        BinaryWriter writer(payload);
+        writer.write(VERSION);
+        writer.write(static_cast<uint16_t>(sensorName.size()));
+        writer.write(timestamp.realtimeNs);
+        writer.writeBytes(sensorName.data(), sensorName.size());
+
+        std::vector<uint8_t> frame;
+        appendFrame(FrameType::SEGMENT_HEADER, payload, frame);
+        if (!stage(frame.data(), frame.size())) {
+            LOG_S(ERROR) << "Could not write segment header " << openSegmentPath << ": " << std::strerror(errno);
+            abandonSegment();
+            return false;
+        }
+
+        segmentSize = frame.size();
+        segmentStartNs = timestamp.realtimeNs;
+        index.clear();
+        LOG_S(INFO) << "Opened segment: " << openSegmentPath;
+        return true;
+    }
+
+    bool SegmentArchive::closeSegment() {
+        if (fd < 0) {
+            return true;
+        }
+
+        const std::string openSegmentPath = segmentPath.string() + OPEN_EXTENSION;
+        std::vector<uint8_t> footer;
+        createFooter(segmentSize, index, footer);
+        // the padding of the last write and the preallocated blocks are cut off
+        bool closed = stage(footer.data(), footer.size()) && flush() &&
+                      ::ftruncate(fd, static_cast<off_t>(segmentSize + footer.size())) == 0 && ::fsync(fd) == 0;
+        closed = (::close(fd) == 0) && closed;
+        fd = -1;
+        if (!closed) {
+            LOG_S(ERROR) << "Could not close segment " << openSegmentPath << ", it is recovered on next start.";
+            return false;
+        }
+
+        std::error_code errorCode;
+        fs::rename(openSegmentPath, segmentPath, errorCode);
+        if (errorCode) {
+            LOG_S(ERROR) << "Could not rename segment " << openSegmentPath << ": " << errorCode.message();
+            return false;
+        }
+        LOG_S(INFO) << "Closed segment with " << index.size() << " captures: " << segmentPath.string();
+        return true;
+    }
+
+    bool SegmentArchive::append(const VibrationData &vibrationData, const HostTimestamp &triggerTimestamp,
+                                CaptureLocation &captureLocation) {
+        std::vector<uint8_t> payload;
+        CaptureSerializer::serialize(vibrationData, sensorName, triggerTimestamp, payload, storageConfig.sampleCodec);
+        std::vector<uint8_t> frame;
+        appendFrame(FrameType::CAPTURE, payload, frame);
+
+        if (fd >= 0 && !index.empty()) {
+            const bool sizeExceeded = segmentSize + frame.size() > storageConfig.segmentMaxSize;
+            const bool durationExceeded = triggerTimestamp.realtimeNs - segmentStartNs >=
+                                          static_cast<int64_t>(storageConfig.segmentMaxDuration) * 1000000000;
+            if (sizeExceeded || durationExceeded) {
+                closeSegment();
+            }
+        }
+        if (fd < 0 && !openSegment(triggerTimestamp)) {
+            return false;
+        }
+
+        if (!stage(frame.data(), frame.size())) {
+            LOG_S(ERROR) << "Could not append capture to segment " << segmentPath.string() << OPEN_EXTENSION << ": "
+                         << std::strerror(errno);
+            // the captures staged before are lost, the written ones are recovered on the next start
+            abandonSegment();
+            return false;
+        }
+
+        SegmentIndexEntry indexEntry;
+        indexEntry.triggerRealtimeNs = triggerTimestamp.realtimeNs;
+        indexEntry.offset = segmentSize;
+        indexEntry.recordingMode = vibrationData.recordingMode;
+        index.push_back(indexEntry);
+        segmentSize += frame.size();
+
+        captureLocation.sensorName = sensorName;
+        captureLocation.recordingMode = vibrationData.recordingMode;
+        captureLocation.triggerRealtimeNs = triggerTimestamp.realtimeNs;
+        captureLocation.fileName = segmentPath.filename().string();
+        captureLocation.offset = indexEntry.offset;
+
+        LOG_S(INFO) << "Vibration data appended to segment: " << segmentPath.string() << OPEN_EXTENSION;
+        return true;
+    }
+
+    bool SegmentArchive::close() {
+        return closeSegment();
+    }
+
+    bool SegmentArchive::stage(const void *data, size_t size) {
+        auto bytes = static_cast<const uint8_t *>(data);
+        while (size > 0) {
+            const size_t staged = writeBuffer.append(bytes, size);
+            bytes += staged;
+            size -= staged;
+            if (writeBuffer.isFull()) {
+                if (!writeAll(fd, writeBuffer.getData(), writeBuffer.getSize(), bufferOffset)) {
+                    return false;
+                }
+                bufferOffset += writeBuffer.getSize();
+                writeBuffer.clear();
+            }
+        }
+        return true;
+    }
+
+    bool SegmentArchive::flush() {
+        if (fd < 0 || writeBuffer.getSize() == 0) {
+            return true;
+        }
+        if (!writeAll(fd, writeBuffer.getData(), writeBuffer.pad(IO_ALIGNMENT), bufferOffset)) {
+            LOG_S(ERROR) << "Could not write segment " << segmentPath.string() << OPEN_EXTENSION << ": "
+                         << std::strerror(errno);
+            abandonSegment();
+            return false;
+        }
+        // the partial last page stays staged and is written again with the following frames
+        const size_t writtenPages = writeBuffer.getSize() / IO_ALIGNMENT * IO_ALIGNMENT;
+        writeBuffer.consume(writtenPages);
+        bufferOffset += writtenPages;
+        return true;
+    }
+
+    void SegmentArchive::abandonSegment() {
+        ::close(fd);
+        fd = -1;
+        writeBuffer.clear();
+    }
+
+    uint64_t SegmentArchive::getSegmentSize() const {
+        return fd >= 0 ? segmentSize : 0;
+    }
+
+    void SegmentArchive::createFooter(uint64_t offset, const std::vector<SegmentIndexEntry> &index,
+                                      std::vector<uint8_t> &footer) {
+        std::vector<uint8_t> payload;
+        BinaryWriter writer(payload);
+        writer.write(static_cast<uint32_t>(index.size()));
+        writer.write(static_cast<uint32_t>(0));
+        for (const auto &indexEntry : index) {
+            writer.write(indexEntry.triggerRealtimeNs);
+            writer.write(indexEntry.offset);
+            writer.write(static_cast<uint8_t>(indexEntry.recordingMode));
+            writer.align(8);
+        }
+
+        footer.clear();
+        appendFrame(FrameType::SEGMENT_INDEX, payload, footer);
+        BinaryWriter footerWriter(footer);
+        footerWriter.write(SegmentTrailer{offset, TRAILER_MAGIC});
+    }
+
+    bool SegmentArchive::scanSegment(int fd, uint64_t fileSize, std::vector<SegmentIndexEntry> &index,
+                                     uint64_t &validSize) {
+        index.clear();
+        validSize = 0;
+
+        std::vector<uint8_t> frame;
+        uint64_t offset = 0;
+        while (offset + sizeof(FrameHeader) <= fileSize) {
+            FrameHeader header{};
+            if (::pread(fd, &header, sizeof(header), offset) != sizeof(header) || header.magic != FRAME_MAGIC ||
+                header.length > MAX_FRAME_LENGTH || offset + sizeof(FrameHeader) + header.length > fileSize) {
+                break;
+            }
+
+            frame.resize(sizeof(FrameHeader) + header.length);
+            if (::pread(fd, frame.data(), frame.size(), offset) != static_cast<ssize_t>(frame.size()) ||
+                !readFrame(frame.data(), frame.size(), header)) {
+                break;
+            }
+
+            const auto type = static_cast<FrameType>(header.type);
+            if (type == FrameType::SEGMENT_INDEX) {
+                // the segment is closed already
+                break;
+            }
+            if (type == FrameType::CAPTURE) {
+                SegmentIndexEntry indexEntry;
+                if (!CaptureSerializer::readIndexEntry(frame.data() + sizeof(FrameHeader), header.length,
+                                                       indexEntry)) {
+                    break;
+                }
+                indexEntry.offset = offset;
+                index.push_back(indexEntry);
+            }
+
+            offset += getFrameSize(header.length);
+            validSize = std::min(offset, fileSize);
+        }
+
+        return validSize > 0;
+    }
+
+    bool SegmentArchive::recoverSegment(const fs::path &openSegmentPath) {
+        int fd = ::open(openSegmentPath.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd < 0) {
+            LOG_S(ERROR) << "Could not open segment " << openSegmentPath << ": " << std::strerror(errno);
+            return false;
+        }
+
+        std::vector<SegmentIndexEntry> index;
+        uint64_t validSize;
+        const off_t fileSize = ::lseek(fd, 0, SEEK_END);
+        if (fileSize < 0 || !scanSegment(fd, fileSize, index, validSize)) {
+            ::close(fd);
+            LOG_S(WARNING) << "Segment without valid header, removing it: " << openSegmentPath;
+            return fs::remove(openSegmentPath);
+        }
+
+        std::vector<uint8_t> footer;
+        createFooter(validSize, index, footer);
+        bool recovered = ::ftruncate(fd, validSize) == 0 && writeAll(fd, footer.data(), footer.size(), validSize) &&
+                         ::fsync(fd) == 0;
+        recovered = (::close(fd) == 0) && recovered;
+        if (!recovered) {
+            LOG_S(ERROR) << "Could not recover segment " << openSegmentPath << ": " << std::strerror(errno);
+            return false;
+        }
+
+        fs::path segmentPath = openSegmentPath;
+        segmentPath.replace_extension();
+        std::error_code errorCode;
+        fs::rename(openSegmentPath, segmentPath, errorCode);
+        if (errorCode) {
+            LOG_S(ERROR) << "Could not rename segment " << openSegmentPath << ": " << errorCode.message();
+            return false;
+        }
+
+        LOG_S(WARNING) << "Recovered segment with " << index.size() << " captures, dropped "
+                       << (fileSize - validSize) << " bytes: " << segmentPath;
+        return true;
+    }
+
+    bool SegmentArchive::readHeader(const fs::path &segmentPath, std::string &sensorName) {
+        int fd = ::open(segmentPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        FrameHeader header{};
+        std::vector<uint8_t> frame(sizeof(FrameHeader));
+        bool hasHeader = ::pread(fd, frame.data(), frame.size(), 0) == static_cast<ssize_t>(frame.size());
+        if (hasHeader) {
+            std::memcpy(&header, frame.data(), sizeof(header));
+            hasHeader = header.magic == FRAME_MAGIC && header.length <= MAX_FRAME_LENGTH;
+        }
+        if (hasHeader) {
+            frame.resize(sizeof(FrameHeader) + header.length);
+            hasHeader = ::pread(fd, frame.data(), frame.size(), 0) == static_cast<ssize_t>(frame.size()) &&
+                        readFrame(frame.data(), frame.size(), header) &&
+                        static_cast<FrameType>(header.type) == FrameType::SEGMENT_HEADER;
+        }
+        ::close(fd);
+        if (!hasHeader) {
+            return false;
+        }
+
+        BinaryReader reader(frame.data() + sizeof(FrameHeader), header.length);
+        uint16_t version, sensorNameLength;
+        int64_t startRealtimeNs;
+        if (!reader.read(version) || version != VERSION || !reader.read(sensorNameLength) ||
+            !reader.read(startRealtimeNs)) {
+            return false;
+        }
+        sensorName.resize(sensorNameLength);
+        return reader.readBytes(&sensorName[0], sensorNameLength);
+    }
+
+    bool SegmentArchive::readIndex(const fs::path &segmentPath, std::vector<SegmentIndexEntry> &index) {
+        int fd = ::open(segmentPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            LOG_S(ERROR) << "Could not open segment " << segmentPath << ": " << std::strerror(errno);
+            return false;
+        }
+        const off_t fileSize = ::lseek(fd, 0, SEEK_END);
+
+        // the trailer has no CRC, a damaged offset must not size the index frame beyond the file
+        SegmentTrailer trailer{};
+        const off_t minSize = sizeof(FrameHeader) + sizeof(SegmentTrailer);
+        bool hasTrailer = fileSize >= minSize &&
+                          ::pread(fd, &trailer, sizeof(trailer), fileSize - sizeof(trailer)) == sizeof(trailer) &&
+                          trailer.magic == TRAILER_MAGIC &&
+                          trailer.indexOffset <= static_cast<uint64_t>(fileSize - minSize);
+
+        std::vector<uint8_t> frame;
+        FrameHeader header{};
+        if (hasTrailer) {
+            frame.resize(fileSize - sizeof(trailer) - trailer.indexOffset);
+            hasTrailer = ::pread(fd, frame.data(), frame.size(), trailer.indexOffset) ==
+                         static_cast<ssize_t>(frame.size()) &&
+                         readFrame(frame.data(), frame.size(), header) &&
+                         static_cast<FrameType>(header.type) == FrameType::SEGMENT_INDEX;
+        }
+
+        if (!hasTrailer) {
+            // open or damaged segment
+            uint64_t validSize;
+            bool scanned = fileSize >= 0 && scanSegment(fd, fileSize, index, validSize);
+            ::close(fd);
+            return scanned;
+        }
+        ::close(fd);
+
+        BinaryReader reader(frame.data() + sizeof(FrameHeader), header.length);
+        uint32_t count, reserved;
+        if (!reader.read(count) || !reader.read(reserved)) {
+            return false;
+        }
+        index.clear();
+        index.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            SegmentIndexEntry indexEntry;
+            uint8_t recordingMode;
+            if (!reader.read(indexEntry.triggerRealtimeNs) || !reader.read(indexEntry.offset) ||
+                !reader.read(recordingMode) || !reader.align(8)) {
+                return false;
+            }
+            indexEntry.recordingMode = static_cast<RecordingMode>(recordingMode);
+            index.push_back(indexEntry);
+        }
+        return true;
+    }
+
+    bool SegmentArchive::readCapture(const fs::path &segmentPath, uint64_t offset, CaptureRecord &captureRecord) {
+        int fd = ::open(segmentPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            LOG_S(ERROR) << "Could not open segment " << segmentPath << ": " << std::strerror(errno);
+            return false;
+        }
+        FrameHeader header{};
+        std::vector<uint8_t> frame;
+        bool hasFrame = ::pread(fd, &header, sizeof(header), offset) == sizeof(header) &&
+                        header.magic == FRAME_MAGIC && header.length <= MAX_FRAME_LENGTH;
+        if (hasFrame) {
+            frame.resize(sizeof(FrameHeader) + header.length);
+            hasFrame = ::pread(fd, frame.data(), frame.size(), offset) == static_cast<ssize_t>(frame.size()) &&
+                       readFrame(frame.data(), frame.size(), header) &&
+                       static_cast<FrameType>(header.type) == FrameType::CAPTURE;
+        }
+        ::close(fd);
+
+        return hasFrame &&
+               CaptureSerializer::deserialize(frame.data() + sizeof(FrameHeader), header.length, captureRecord);
+    }
+}
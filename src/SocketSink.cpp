@@ -0,0 +1,157 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "vibration_daq/SocketSink.hpp"
+#include "vibration_daq/CaptureSerializer.hpp"
+#include "vibration_daq/utils/FrameFormat.hpp"
+#include "loguru/loguru.hpp"
+
+namespace fs = std::filesystem;
+
+namespace vibration_daq {
+    SocketSink::~SocketSink() {
+        close();
+    }
+
+    bool SocketSink::setup(const std::string &socketPath, SampleCodec sampleCodec) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+            LOG_S(ERROR) << "Invalid socket path: " << socketPath;
+            return false;
+        }
+        std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+        std::error_code errorCode;
+        if (fs::is_socket(socketPath, errorCode)) {
+            fs::remove(socketPath, errorCode);
+        }
+
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) {
+            LOG_S(ERROR) << "Could not create socket: " << std::strerror(errno);
+            return false;
+        }
+        if (::bind(listenFd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd, LISTEN_BACKLOG) != 0) {
+            LOG_S(ERROR) << "Could not listen on socket " << socketPath << ": " << std::strerror(errno);
+            ::close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        this->socketPath = socketPath;
+        this->sampleCodec = sampleCodec;
+        LOG_S(INFO) << "Streaming captures to clients of " << socketPath;
+        return true;
+    }
+
+    void SocketSink::acceptClients() {
+        int clientFd;
+        while ((clientFd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+            clientFds.push_back(clientFd);
+            LOG_S(INFO) << "Socket client connected, clients: " << clientFds.size();
+        }
+    }
+
+    void SocketSink::sendFrame() {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SEND_TIMEOUT_MS);
+        std::vector<size_t> sentSizes(clientFds.size(), 0);
+        std::vector<int> errorNumbers(clientFds.size(), 0);
+        std::vector<pollfd> pollFds;
+        std::vector<size_t> pendingClients;
+
+        while (true) {
+            pollFds.clear();
+            pendingClients.clear();
+            for (size_t i = 0; i < clientFds.size(); ++i) {
+                while (errorNumbers[i] == 0 && sentSizes[i] < frame.size()) {
+                    const ssize_t result = ::send(clientFds[i], frame.data() + sentSizes[i],
+                                                  frame.size() - sentSizes[i], MSG_NOSIGNAL);
+                    if (result > 0) {
+                        sentSizes[i] += result;
+                    } else if (result < 0 && errno == EINTR) {
+                        continue;
+                    } else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        pollFds.push_back({clientFds[i], POLLOUT, 0});
+                        pendingClients.push_back(i);
+                        break;
+                    } else {
+                        errorNumbers[i] = result < 0 ? errno : EPIPE;
+                    }
+                }
+            }
+            if (pendingClients.empty()) {
+                break;
+            }
+
+            const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0) {
+                for (const size_t i : pendingClients) {
+                    errorNumbers[i] = ETIMEDOUT;
+                }
+                break;
+            }
+            if (::poll(pollFds.data(), pollFds.size(), static_cast<int>(remaining)) < 0 && errno != EINTR) {
+                for (const size_t i : pendingClients) {
+                    errorNumbers[i] = errno;
+                }
+                break;
+            }
+        }
+
+        // a partially sent frame leaves the stream unreadable, so the client is dropped
+        size_t keptCount = 0;
+        for (size_t i = 0; i < clientFds.size(); ++i) {
+            if (errorNumbers[i] == 0) {
+                clientFds[keptCount++] = clientFds[i];
+                continue;
+            }
+            LOG_S(WARNING) << "Disconnecting socket client: " << std::strerror(errorNumbers[i]);
+            ::close(clientFds[i]);
+        }
+        clientFds.resize(keptCount);
+    }
+
+    bool SocketSink::storeVibrationData(const VibrationData &vibrationData, const std::string &sensorName,
+                                        const HostTimestamp &triggerTimestamp) {
+        if (listenFd < 0) {
+            return false;
+        }
+        acceptClients();
+        if (clientFds.empty()) {
+            return true;
+        }
+
+        payload.clear();
+        frame.clear();
+        CaptureSerializer::serialize(vibrationData, sensorName, triggerTimestamp, payload, sampleCodec);
+        appendFrame(FrameType::CAPTURE, payload, frame);
+
+        sendFrame();
+        return true;
+    }
+
+    void SocketSink::close() {
+        for (const int clientFd : clientFds) {
+            ::close(clientFd);
+        }
+        clientFds.clear();
+        if (listenFd >= 0) {
+            ::close(listenFd);
+            listenFd = -1;
+            std::error_code errorCode;
+            fs::remove(socketPath, errorCode);
+        }
+    }
+}
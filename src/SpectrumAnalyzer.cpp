@@ -0,0 +1,130 @@
+/* Copyright (c) 2020, Jonas Lauener & Wingtra AG
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include "vibration_daq/FFTPlan.hpp"
+#include "vibration_daq/SpectrumAnalyzer.hpp"
+
+namespace vibration_daq {
+    namespace {
+        struct Window {
+            std::vector<float> values;
+            double sum = 0;
+            double squaredSum = 0;
+        };
+
+        /**
+         * Coefficients of the cosine sum window w[n] = a0 - a1 cos(2 pi n / size) + a2 cos(4 pi n / size) - ...
+         */
+        std::vector<double> getCosineSumCoefficients(WindowSetting windowSetting) {
+            switch (windowSetting) {
+                case WindowSetting::HANNING:
+                    return {0.5, 0.5};
+                case WindowSetting::FLAT_TOP:
+                    return {0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368};
+                case WindowSetting::BLACKMAN_HARRIS:
+                    return {0.35875, 0.48829, 0.14128, 0.01168};
+                default:
+                    return {1};
+            }
+        }
+
+        /**
+         * Computed once per size and window, with the sums needed for the scaling.
+         */
+        std::shared_ptr<const Window> getCachedWindow(size_t size, WindowSetting windowSetting) {
+            static std::mutex mutex;
+            static std::map<std::pair<size_t, WindowSetting>, std::shared_ptr<const Window>> windows;
+            std::lock_guard<std::mutex> lock(mutex);
+            std::shared_ptr<const Window> &cachedWindow = windows[{size, windowSetting}];
+            if (!cachedWindow) {
+                const std::vector<double> coefficients = getCosineSumCoefficients(windowSetting);
+                Window window;
+                window.values.resize(size);
+                for (size_t n = 0; n < size; ++n) {
+                    double value = 0;
+                    for (size_t i = 0; i < coefficients.size(); ++i) {
+                        const double sign = i % 2 == 0 ? 1 : -1;
+                        value += sign * coefficients[i] * std::cos(2 * M_PI * static_cast<double>(i * n) / size);
+                    }
+                    window.values[n] = static_cast<float>(value);
+                    window.sum += window.values[n];
+                    window.squaredSum += static_cast<double>(window.values[n]) * window.values[n];
+                }
+                cachedWindow = std::make_shared<const Window>(std::move(window));
+            }
+            return cachedWindow;
+        }
+    }
+
+    std::shared_ptr<const std::vector<float>> SpectrumAnalyzer::getWindow(size_t size, WindowSetting windowSetting) {
+        const std::shared_ptr<const Window> window = getCachedWindow(size, windowSetting);
+        return std::shared_ptr<const std::vector<float>>(window, &window->values);
+    }
+
+    bool SpectrumAnalyzer::computeSpectrum(Span<const float> samples, float stepSize,
+                                           const SpectrumConfig &spectrumConfig, std::vector<float> &frequencies,
+                                           std::vector<float> &spectrum) {
+        size_t segmentLength = spectrumConfig.segmentLength;
+        if (segmentLength == 0) {
+            segmentLength = 1;
+            while (2 * segmentLength <= samples.size()) {
+                segmentLength *= 2;
+            }
+        }
+        const std::shared_ptr<const FFTPlan> plan = FFTPlan::get(segmentLength);
+        if (!plan || segmentLength > samples.size() || stepSize <= 0 || spectrumConfig.overlap < 0 ||
+            spectrumConfig.overlap >= 1) {
+            return false;
+        }
+
+        const std::shared_ptr<const Window> window = getCachedWindow(segmentLength, spectrumConfig.windowSetting);
+        const float *windowValues = window->values.data();
+
+        const size_t hop = std::max<size_t>(1, std::lround(segmentLength * (1 - spectrumConfig.overlap)));
+        const size_t segmentsCount = (samples.size() - segmentLength) / hop + 1;
+        const size_t binsCount = segmentLength / 2 + 1;
+        std::vector<float> windowed(segmentLength), real, imaginary;
+        std::vector<float> power(binsCount, 0); // sum of |X[k]|^2 over the segments
+        for (size_t segment = 0; segment < segmentsCount; ++segment) {
+            const float *segmentSamples = samples.data() + segment * hop;
+            for (size_t i = 0; i < segmentLength; ++i) {
+                windowed[i] = segmentSamples[i] * windowValues[i];
+            }
+            plan->transform(windowed.data(), real, imaginary);
+            for (size_t k = 0; k < binsCount; ++k) {
+                power[k] += real[k] * real[k] + imaginary[k] * imaginary[k];
+            }
+        }
+
+        const double sampleRate = 1.0 / stepSize;
+        const auto binWidth = static_cast<float>(sampleRate / segmentLength);
+        frequencies.resize(binsCount);
+        for (size_t k = 0; k < binsCount; ++k) {
+            frequencies[k] = k * binWidth;
+        }
+
+        // the negative frequencies are folded onto the positive ones, except for DC and the Nyquist bin
+        spectrum.resize(binsCount);
+        if (spectrumConfig.scaling == SpectrumScaling::PSD) {
+            const auto scale = static_cast<float>(2 / (segmentsCount * sampleRate * window->squaredSum));
+            for (size_t k = 0; k < binsCount; ++k) {
+                spectrum[k] = power[k] * scale;
+            }
+        } else {
+            const auto powerScale = static_cast<float>(1.0 / segmentsCount);
+            const auto scale = static_cast<float>(2 / window->sum);
+            for (size_t k = 0; k < binsCount; ++k) {
+                spectrum[k] = std::sqrt(power[k] * powerScale) * scale;
+            }
+        }
+        spectrum.front() /= 2;
+        spectrum.back() /= 2;
+        return true;
+    }
+}
@@ -3,7 +3,20 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
 
+#include <algorithm>
+#include <charconv>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <sstream>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <yaml-cpp/yaml.h>
 #include "vibration_daq/StorageModule.hpp"
 #include "loguru/loguru.hpp"
 
@@ -21,57 +34,486 @@ namespace vibration_daq {
         return date::format("%FT%H_%M_%S", date::floor<std::chrono::milliseconds>(timePoint));
     }
 
-    bool StorageModule::setup(const fs::path &storageDirectoryPath) {
-        if (!fs::is_directory(storageDirectoryPath)) {
-            LOG_S(ERROR) << "Storage directory does not exist: " << storageDirectoryPath;
-            return false;
+    std::string StorageModule::getAxisColumnName(const Axis &axis) {
+        switch (axis) {
+            case Axis::X:
+                return "x-axis";
+            case Axis::Y:
+                return "y-axis";
+            case Axis::Z:
+            default:
+                return "z-axis";
         }
-        this->storageDirectory = storageDirectoryPath;
-        return true;
     }
 
-    bool StorageModule::storeVibrationData(const vibration_daq::VibrationData &vibrationData,
-                                           const std::string &sensorName,
-                                           const std::chrono::system_clock::time_point &measurementTimestamp) const {
-        std::ostringstream dataFilePath;
-        dataFilePath << storageDirectory.string();
-        dataFilePath << "vibration_data_";
-        dataFilePath << Enum::toString(vibrationData.recordingMode);
-        dataFilePath << "_";
-        dataFilePath << getUTCTimestampString(measurementTimestamp);
-        dataFilePath << "_";
-        dataFilePath << sensorName;
-        dataFilePath << ".csv";
+    std::string StorageModule::getCSVFileStem(RecordingMode recordingMode, const std::string &sensorName,
+                                              const HostTimestamp &triggerTimestamp) {
+        return "vibration_data_" + Enum::toString(recordingMode) + "_" +
+               getUTCTimestampString(triggerTimestamp.getSystemTimePoint()) + "_" + sensorName;
+    }
 
-        auto dataFile = std::fstream(dataFilePath.str(), std::ios::out);
-        if (!dataFile) {
-            LOG_S(ERROR) << "Could not create data file.";
+    bool StorageModule::storeCaptureMetadata(const CaptureMetadata &metadata, const std::string &sensorName,
+                                             const HostTimestamp &triggerTimestamp,
+                                             const std::string &metadataFilePath) {
+        YAML::Node sensorNode;
+        sensorNode["name"] = sensorName;
+        sensorNode["serial_id"] = metadata.serialId;
+        sensorNode["rev_day"] = metadata.revDay;
+        sensorNode["year_mon"] = metadata.yearMon;
+        sensorNode["temp_out"] = metadata.tempOut;
+        sensorNode["supply_out"] = metadata.supplyOut;
+        sensorNode["diag_stat"] = metadata.diagStat;
+        sensorNode["time_stamp"] = metadata.sensorTimestamp;
+
+        YAML::Node recordingNode;
+        recordingNode["decimation_factor"] = metadata.decimationFactor;
+        recordingNode["FIR_filter"] = Enum::toString(metadata.firFilter);
+        recordingNode["window_setting"] = Enum::toString(metadata.windowSetting);
+        recordingNode["spectral_avg_count"] = metadata.spectralAvgCount;
+
+        YAML::Node hostNode;
+        hostNode["trigger_timestamp"] = date::format("%FT%TZ", triggerTimestamp.getSystemTimePoint());
+        hostNode["trigger_realtime_ns"] = triggerTimestamp.realtimeNs;
+        hostNode["trigger_monotonic_raw_ns"] = triggerTimestamp.monotonicRawNs;
+        hostNode["readout_realtime_ns"] = metadata.readoutTimestamp.realtimeNs;
+        hostNode["readout_monotonic_raw_ns"] = metadata.readoutTimestamp.monotonicRawNs;
+
+        // sensor TIME_STAMP to host CLOCK_MONOTONIC_RAW
+        const ClockMapping &clockMapping = metadata.clockMapping;
+        YAML::Node clockMappingNode;
+        clockMappingNode["valid"] = clockMapping.valid;
+        clockMappingNode["points_count"] = clockMapping.pointsCount;
+        clockMappingNode["reference_ticks"] = clockMapping.referenceTicks;
+        clockMappingNode["offset_ns"] = clockMapping.offsetNs;
+        clockMappingNode["ns_per_tick"] = clockMapping.nsPerTick;
+        clockMappingNode["drift_ppm"] = clockMapping.driftPpm;
+        clockMappingNode["residual_ns"] = clockMapping.residualNs;
+
+        YAML::Node metadataNode;
+        metadataNode["sensor"] = sensorNode;
+        metadataNode["recording"] = recordingNode;
+        metadataNode["host"] = hostNode;
+        metadataNode["clock_mapping"] = clockMappingNode;
+
+        // time-domain statistics computed on the host, only MTC captures have them
+        if (!metadata.statistics.empty()) {
+            YAML::Node statisticsNode;
+            for (const auto &statistics : metadata.statistics) {
+                const AxisStatistics &axisStatistics = statistics.second;
+                YAML::Node axisNode;
+                axisNode["mean"] = axisStatistics.mean;
+                axisNode["rms"] = axisStatistics.rms;
+                axisNode["std_dev"] = axisStatistics.stdDev;
+                axisNode["peak"] = axisStatistics.peak;
+                axisNode["peak_to_peak"] = axisStatistics.peakToPeak;
+                axisNode["crest_factor"] = axisStatistics.crestFactor;
+                axisNode["skewness"] = axisStatistics.skewness;
+                axisNode["kurtosis"] = axisStatistics.kurtosis;
+                statisticsNode[Enum::toString(statistics.first)] = axisNode;
+            }
+            metadataNode["statistics"] = statisticsNode;
+        }
+
+        std::ofstream metadataFile(metadataFilePath);
+        if (!metadataFile) {
+            LOG_S(ERROR) << "Could not create metadata file: " << metadataFilePath;
             return false;
         }
+        metadataFile << metadataNode << std::endl;
+        return metadataFile.good();
+    }
 
+    bool StorageModule::writeCSVFile(const VibrationData &vibrationData, const std::string &dataFilePath) {
+        // the file is composed in memory and written at once instead of line by line
+        std::string content;
+        std::string unit;
         switch (vibrationData.recordingMode) {
             case RecordingMode::MTC:
-                dataFile << "Time [s],x-axis [g],y-axis [g],z-axis [g]" << std::endl;
+                content += "Time [s]";
+                unit = "[g]";
                 break;
             case RecordingMode::MFFT:
             case RecordingMode::AFFT:
-                dataFile << "Frequency Bin [Hz],x-axis [mg],y-axis [mg],z-axis [mg]" << std::endl;
+                content += "Frequency Bin [Hz]";
+                unit = "[mg]";
                 break;
             case RecordingMode::RTS:
                 LOG_S(ERROR) << "RTS mode not supported!";
                 return false;
         }
+        // only recorded axes get a column
+        for (const auto &axis : vibrationData.axes) {
+            content += "," + getAxisColumnName(axis) + " " + unit;
+        }
+        content += '\n';
 
-        for (int i = 0; i < vibrationData.xAxis.size(); ++i) {
-            dataFile << vibrationData.stepAxis[i] << "," << vibrationData.xAxis[i] << "," << vibrationData.yAxis[i]
-                     << ","
-                     << vibrationData.zAxis[i] << std::endl;
+        // same format as std::ostream (%g with 6 significant digits), without its per value overhead
+        char value[32];
+        const auto appendValue = [&content, &value](float number) {
+            const auto result = std::to_chars(value, value + sizeof(value), number, std::chars_format::general, 6);
+            content.append(value, result.ptr);
+        };
+        content.reserve(content.size() + vibrationData.stepAxis.size() * (vibrationData.axes.size() + 1) * 12);
+        for (int i = 0; i < vibrationData.stepAxis.size(); ++i) {
+            appendValue(vibrationData.stepAxis[i]);
+            for (const auto &axis : vibrationData.axes) {
+                content += ',';
+                appendValue(vibrationData.getAxisData(axis)[i]);
+            }
+            content += '\n';
         }
 
+        auto dataFile = std::fstream(dataFilePath, std::ios::out);
+        if (!dataFile) {
+            LOG_S(ERROR) << "Could not create data file.";
+            return false;
+        }
+        dataFile.write(content.data(), static_cast<std::streamsize>(content.size()));
         dataFile.close();
+        if (!dataFile.good()) {
+            LOG_S(ERROR) << "Could not write data file: " << dataFilePath;
+            return false;
+        }
+        return true;
+    }
+
+    bool StorageModule::readCSVFile(const std::string &dataFilePath, VibrationData &vibrationData) {
+        const int fd = ::open(dataFilePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat fileStat{};
+        if (::fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void *mapping = ::mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+        ::madvise(mapping, fileStat.st_size, MADV_SEQUENTIAL);
+        const bool parsed = parseCSV(static_cast<const char *>(mapping), fileStat.st_size, vibrationData);
+        ::munmap(mapping, fileStat.st_size);
+        return parsed;
+    }
+
+    bool StorageModule::parseCSV(const char *data, size_t size, VibrationData &vibrationData) {
+        const char *position = data;
+        const char *end = data + size;
+        const char *lineEnd = std::find(position, end, '\n');
+        std::string_view header(position, lineEnd - position);
+        if (!header.empty() && header.back() == '\r') {
+            header.remove_suffix(1);
+        }
+
+        size_t columnEnd = header.find(',');
+        const std::string_view stepColumn = header.substr(0, columnEnd);
+        if (stepColumn.rfind("Time", 0) == 0) {
+            vibrationData.recordingMode = RecordingMode::MTC;
+        } else if (stepColumn.rfind("Frequency", 0) == 0) {
+            vibrationData.recordingMode = RecordingMode::MFFT;
+        } else {
+            return false;
+        }
+
+        vibrationData.axes.clear();
+        while (columnEnd != std::string_view::npos) {
+            const size_t columnStart = columnEnd + 1;
+            columnEnd = header.find(',', columnStart);
+            const std::string_view column = header.substr(columnStart, columnEnd - columnStart);
+            bool knownAxis = false;
+            for (const auto &axis : ALL_AXES) {
+                if (column.rfind(getAxisColumnName(axis), 0) == 0) {
+                    vibrationData.axes.push_back(axis);
+                    knownAxis = true;
+                }
+            }
+            if (!knownAxis) {
+                return false;
+            }
+        }
+
+        position = lineEnd == end ? end : lineEnd + 1;
+        const auto linesCount = static_cast<size_t>(std::count(position, end, '\n')) + 1;
+        vibrationData.stepAxis.clear();
+        vibrationData.stepAxis.reserve(linesCount);
+        for (const auto &axis : ALL_AXES) {
+            vibrationData.getAxisData(axis).clear();
+            vibrationData.getAxisRawData(axis).clear();
+        }
+        for (const auto &axis : vibrationData.axes) {
+            vibrationData.getAxisData(axis).reserve(linesCount);
+        }
+
+        // locale independent and without copying the lines
+        while (position < end) {
+            if (*position == '\n' || *position == '\r') {
+                ++position;
+                continue;
+            }
+            float value;
+            auto result = std::from_chars(position, end, value);
+            if (result.ec != std::errc()) {
+                return false;
+            }
+            vibrationData.stepAxis.push_back(value);
+            for (const auto &axis : vibrationData.axes) {
+                if (result.ptr == end || *result.ptr != ',') {
+                    return false;
+                }
+                result = std::from_chars(result.ptr + 1, end, value);
+                if (result.ec != std::errc()) {
+                    return false;
+                }
+                vibrationData.getAxisData(axis).push_back(value);
+            }
+            position = result.ptr;
+            if (position < end && *position != '\n' && *position != '\r') {
+                return false;
+            }
+        }
+
+        if (vibrationData.stepAxis.size() > 1) {
+            vibrationData.stepSize = vibrationData.stepAxis[1] - vibrationData.stepAxis[0];
+            vibrationData.binOffset = static_cast<int>(std::lround(vibrationData.stepAxis[0] /
+                                                                   vibrationData.stepSize));
+        }
+        return true;
+    }
+
+    bool StorageModule::readCaptureMetadata(const std::string &metadataFilePath, CaptureMetadata &metadata,
+                                            HostTimestamp &triggerTimestamp) {
+        try {
+            const YAML::Node metadataNode = YAML::LoadFile(metadataFilePath);
+            const YAML::Node sensorNode = metadataNode["sensor"];
+            const YAML::Node recordingNode = metadataNode["recording"];
+            const YAML::Node hostNode = metadataNode["host"];
+            if (!sensorNode || !recordingNode || !hostNode) {
+                return false;
+            }
+            metadata.serialId = sensorNode["serial_id"].as<uint16_t>();
+            metadata.revDay = sensorNode["rev_day"].as<uint16_t>();
+            metadata.yearMon = sensorNode["year_mon"].as<uint16_t>();
+            metadata.tempOut = sensorNode["temp_out"].as<uint16_t>();
+            metadata.supplyOut = sensorNode["supply_out"].as<uint16_t>();
+            metadata.diagStat = sensorNode["diag_stat"].as<uint16_t>();
+            metadata.sensorTimestamp = sensorNode["time_stamp"].as<uint32_t>();
+
+            metadata.decimationFactor = recordingNode["decimation_factor"].as<int>();
+            metadata.spectralAvgCount = recordingNode["spectral_avg_count"].as<int>();
+            if (!Enum::convert(recordingNode["FIR_filter"].as<std::string>(), metadata.firFilter) ||
+                !Enum::convert(recordingNode["window_setting"].as<std::string>(), metadata.windowSetting)) {
+                return false;
+            }
+
+            triggerTimestamp.realtimeNs = hostNode["trigger_realtime_ns"].as<int64_t>();
+            triggerTimestamp.monotonicRawNs = hostNode["trigger_monotonic_raw_ns"].as<int64_t>();
+            metadata.readoutTimestamp.realtimeNs = hostNode["readout_realtime_ns"].as<int64_t>();
+            metadata.readoutTimestamp.monotonicRawNs = hostNode["readout_monotonic_raw_ns"].as<int64_t>();
+
+            // older metadata files have no clock mapping
+            const YAML::Node clockMappingNode = metadataNode["clock_mapping"];
+            if (clockMappingNode) {
+                ClockMapping &clockMapping = metadata.clockMapping;
+                clockMapping.valid = clockMappingNode["valid"].as<bool>();
+                clockMapping.pointsCount = clockMappingNode["points_count"].as<int>();
+                clockMapping.referenceTicks = clockMappingNode["reference_ticks"].as<int64_t>();
+                clockMapping.offsetNs = clockMappingNode["offset_ns"].as<double>();
+                clockMapping.nsPerTick = clockMappingNode["ns_per_tick"].as<double>();
+                clockMapping.driftPpm = clockMappingNode["drift_ppm"].as<double>();
+                clockMapping.residualNs = clockMappingNode["residual_ns"].as<double>();
+            }
+
+            metadata.statistics.clear();
+            const YAML::Node statisticsNode = metadataNode["statistics"];
+            for (const auto &statistics : statisticsNode) {
+                Axis axis;
+                if (!Enum::convert(statistics.first.as<std::string>(), axis)) {
+                    return false;
+                }
+                const YAML::Node &axisNode = statistics.second;
+                AxisStatistics &axisStatistics = metadata.statistics[axis];
+                axisStatistics.mean = axisNode["mean"].as<float>();
+                axisStatistics.rms = axisNode["rms"].as<float>();
+                axisStatistics.stdDev = axisNode["std_dev"].as<float>();
+                axisStatistics.peak = axisNode["peak"].as<float>();
+                axisStatistics.peakToPeak = axisNode["peak_to_peak"].as<float>();
+                axisStatistics.crestFactor = axisNode["crest_factor"].as<float>();
+                axisStatistics.skewness = axisNode["skewness"].as<float>();
+                axisStatistics.kurtosis = axisNode["kurtosis"].as<float>();
+            }
+        } catch (const YAML::Exception &exception) {
+            LOG_S(WARNING) << "Could not read metadata file " << metadataFilePath << ": " << exception.what();
+            return false;
+        }
+        return true;
+    }
+
+    void StorageModule::removeTemporaryFiles(const fs::path &storageDirectoryPath) {
+        for (const auto &entry : fs::directory_iterator(storageDirectoryPath)) {
+            if (entry.is_regular_file() && entry.path().extension() == TEMPORARY_EXTENSION) {
+                LOG_S(WARNING) << "Removing capture which was not synced: " << entry.path();
+                std::error_code errorCode;
+                fs::remove(entry.path(), errorCode);
+            }
+        }
+    }
+
+    StorageModule::~StorageModule() {
+        close();
+    }
+
+    bool StorageModule::setup(const fs::path &storageDirectoryPath, const StorageConfig &storageConfig) {
+        if (!fs::is_directory(storageDirectoryPath)) {
+            LOG_S(ERROR) << "Storage directory does not exist: " << storageDirectoryPath;
+            return false;
+        }
+        this->storageDirectory = storageDirectoryPath;
+        this->storageConfig = storageConfig;
+
+        directoryFd = ::open(storageDirectoryPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (directoryFd < 0) {
+            LOG_S(ERROR) << "Could not open storage directory: " << std::strerror(errno);
+            return false;
+        }
+
+        removeTemporaryFiles(storageDirectoryPath);
+
+        for (const auto &entry : fs::directory_iterator(storageDirectoryPath)) {
+            if (entry.is_regular_file() && entry.path().extension() == SegmentArchive::OPEN_EXTENSION) {
+                SegmentArchive::recoverSegment(entry.path());
+            }
+        }
+
+        if (!captureIndex.setup(storageDirectoryPath)) {
+            LOG_S(ERROR) << "Could not setup capture index.";
+            return false;
+        }
+
+        if (!retentionManager.start(storageDirectoryPath, storageConfig.retention)) {
+            LOG_S(ERROR) << "Could not start retention manager.";
+            return false;
+        }
+        return true;
+    }
+
+    void StorageModule::close() {
+        if (directoryFd >= 0) {
+            sync();
+        }
+        segmentArchives.clear();
+        retentionManager.stop();
+        if (directoryFd >= 0) {
+            ::close(directoryFd);
+            directoryFd = -1;
+        }
+    }
+
+    bool StorageModule::isSyncDue() const {
+        return isSyncDue(storageConfig, pendingCaptures, lastSync);
+    }
+
+    bool StorageModule::isSyncDue(const StorageConfig &storageConfig, int pendingCaptures,
+                                  std::chrono::steady_clock::time_point lastSync) {
+        switch (storageConfig.syncMode) {
+            case SyncMode::COUNT:
+                return pendingCaptures >= storageConfig.syncCount;
+            case SyncMode::INTERVAL:
+                return std::chrono::steady_clock::now() - lastSync >= std::chrono::seconds(storageConfig.syncInterval);
+            case SyncMode::CAPTURE:
+            case SyncMode::NEVER:
+            default:
+                return true;
+        }
+    }
+
+    bool StorageModule::sync() {
+        bool synced = true;
+        for (auto &segmentArchive : segmentArchives) {
+            synced = segmentArchive.second->flush() && synced;
+        }
+        // one flush of the whole file system is much cheaper on SD cards than a fsync per file
+        if (storageConfig.syncMode != SyncMode::NEVER && ::syncfs(directoryFd) != 0) {
+            LOG_S(ERROR) << "Could not sync storage directory: " << std::strerror(errno);
+            synced = false;
+        }
+
+        for (const auto &pendingRename : pendingRenames) {
+            std::error_code errorCode;
+            fs::rename(pendingRename.first, pendingRename.second, errorCode);
+            if (errorCode) {
+                LOG_S(ERROR) << "Could not rename " << pendingRename.first << ": " << errorCode.message();
+                synced = false;
+            }
+        }
+        if (storageConfig.syncMode != SyncMode::NEVER && !pendingRenames.empty() && ::fsync(directoryFd) != 0) {
+            LOG_S(ERROR) << "Could not sync storage directory: " << std::strerror(errno);
+            synced = false;
+        }
+
+        pendingRenames.clear();
+        pendingCaptures = 0;
+        lastSync = std::chrono::steady_clock::now();
+        return synced;
+    }
+
+    bool StorageModule::storeVibrationData(const vibration_daq::VibrationData &vibrationData,
+                                           const std::string &sensorName,
+                                           const HostTimestamp &triggerTimestamp) {
+        if (storageConfig.format == StorageFormat::SEGMENT) {
+            auto &segmentArchive = segmentArchives[sensorName];
+            if (!segmentArchive) {
+                segmentArchive = std::make_unique<SegmentArchive>(storageDirectory, sensorName, storageConfig);
+            }
+            CaptureLocation captureLocation;
+            if (!segmentArchive->append(vibrationData, triggerTimestamp, captureLocation)) {
+                return false;
+            }
+            // the capture is stored, a failed index update is repaired by rebuilding the index
+            captureIndex.add(captureLocation);
+            retentionManager.notifyStored(captureLocation.fileName, segmentArchive->getSegmentSize(),
+                                          triggerTimestamp.realtimeNs);
+            ++pendingCaptures;
+            return !isSyncDue() || sync();
+        }
+
+        std::ostringstream dataFilePath;
+        dataFilePath << storageDirectory.string();
+        dataFilePath << getCSVFileStem(vibrationData.recordingMode, sensorName, triggerTimestamp);
+        const std::string dataFileName = fs::path(dataFilePath.str() + ".csv").filename().string();
+        const std::string metadataFilePath = dataFilePath.str() + ".yaml";
+        dataFilePath << ".csv";
+
+        const std::string temporaryDataFilePath = dataFilePath.str() + TEMPORARY_EXTENSION;
+        const std::string temporaryMetadataFilePath = metadataFilePath + TEMPORARY_EXTENSION;
+        if (!writeCSVFile(vibrationData, temporaryDataFilePath) ||
+            !storeCaptureMetadata(vibrationData.metadata, sensorName, triggerTimestamp, temporaryMetadataFilePath)) {
+            std::error_code errorCode;
+            fs::remove(temporaryDataFilePath, errorCode);
+            fs::remove(temporaryMetadataFilePath, errorCode);
+            return false;
+        }
+        // the data file is renamed last, so a data file always has its metadata file
+        pendingRenames.emplace_back(temporaryMetadataFilePath, metadataFilePath);
+        pendingRenames.emplace_back(temporaryDataFilePath, dataFilePath.str());
+        ++pendingCaptures;
 
         LOG_S(INFO) << "Vibration data stored to file: " << dataFilePath.str();
 
-        return dataFile.good();
+        CaptureLocation captureLocation;
+        captureLocation.sensorName = sensorName;
+        captureLocation.recordingMode = vibrationData.recordingMode;
+        captureLocation.triggerRealtimeNs = triggerTimestamp.realtimeNs;
+        captureLocation.fileName = dataFileName;
+        captureIndex.add(captureLocation);
+
+        std::error_code errorCode;
+        uint64_t size = fs::file_size(temporaryDataFilePath, errorCode);
+        const uint64_t metadataSize = fs::file_size(temporaryMetadataFilePath, errorCode);
+        size += errorCode ? 0 : metadataSize;
+        retentionManager.notifyStored(dataFileName, size, triggerTimestamp.realtimeNs);
+
+        return !isSyncDue() || sync();
     }
 }
@@ -5,7 +5,11 @@
 
 #include <vibration_daq/VibrationSensorModule.hpp>
 #include "vibration_daq/utils/HexUtils.hpp"
+#include "vibration_daq/utils/HashUtils.hpp"
+#include "vibration_daq/utils/FeatureUtils.hpp"
+#include "vibration_daq/utils/SampleConversion.hpp"
 #include <cmath>
+#include <algorithm>
 #include <functional>
 #include "chrono"
 #include "thread"
@@ -21,37 +25,85 @@ namespace vibration_daq {
         return name;
     }
 
-    WordBuffer VibrationSensorModule::transfer(WordBuffer sendBuf) const {
+    void VibrationSensorModule::setAxes(const std::vector<Axis> &axes) {
+        this->axes = axes;
+    }
+
+    void VibrationSensorModule::setWordGap(std::chrono::microseconds wordGap) {
+        this->wordGap = wordGap;
+    }
+
+    bool VibrationSensorModule::hasFault() const {
+        return faulted;
+    }
+
+    const FaultCounters &VibrationSensorModule::getFaultCounters() const {
+        return faultCounters;
+    }
+
+    void VibrationSensorModule::setFault(const std::string &reason) const {
+        if (!faulted) {
+            LOG_S(ERROR) << name << ": " << reason << ", sensor needs recovery.";
+        }
+        faulted = true;
+    }
+
+    WordBuffer VibrationSensorModule::transfer(WordBuffer sendBuf, bool keepWordGap) const {
         WordBuffer recBuf = {};
-        if (spi_transfer(spi, sendBuf.data(), recBuf.data(), 2) < 0) {
-            LOG_F(ERROR, "spi_transfer(): %s\n", spi_errmsg(spi));
-            exit(1);
+        // don't waste time on a sensor that has to be recovered anyway
+        if (faulted) {
+            return recBuf;
         }
 
-        // keep processor busy to increase time of SPI disable to ~40us
-        for (int i = 0; i < 2000; ++i) {
-            // fixes the bug of shifting MISO 1 byte
+        for (int attempt = 1; spi_transfer(spi, sendBuf.data(), recBuf.data(), 2) < 0; ++attempt) {
+            faultCounters.spiTransferErrors++;
+            LOG_F(WARNING, "%s: spi_transfer(): %s", name.c_str(), spi_errmsg(spi));
+            if (attempt >= TRANSFER_ATTEMPTS) {
+                setFault("SPI transfer failed");
+                return {};
+            }
+        }
+
+        if (!keepWordGap) {
+            return recBuf;
+        }
+
+        // keep SPI disabled between words, a too short gap shifts MISO by 1 byte (detected by isMISOAligned())
+        const auto wordGapEnd = std::chrono::steady_clock::now() + wordGap;
+        while (std::chrono::steady_clock::now() < wordGapEnd) {
+            // busy wait, sleeping takes way longer than the gap
         }
 
         return recBuf;
     }
 
     WordBuffer VibrationSensorModule::transferBlocking(WordBuffer sendBuf) const {
-        bool notBusy;
+        const auto deadline = std::chrono::steady_clock::now() + busyTimeout;
+        int gpioReadAttempts = 0;
 
-        do {
+        while (!faulted) {
+            bool notBusy;
             if (gpio_read(gpioBusy, &notBusy) < 0) {
-                LOG_F(ERROR, "gpio_read(): %s\n", gpio_errmsg(gpioBusy));
-                exit(1);
+                faultCounters.gpioReadErrors++;
+                LOG_F(WARNING, "%s: gpio_read(): %s", name.c_str(), gpio_errmsg(gpioBusy));
+                if (++gpioReadAttempts >= TRANSFER_ATTEMPTS) {
+                    setFault("Busy pin not readable");
+                }
+                continue;
             }
 
             if (notBusy) {
                 return transfer(sendBuf);
+            }
+
+            if (std::chrono::steady_clock::now() > deadline) {
+                faultCounters.busyTimeouts++;
+                setFault("Busy for longer than " + std::to_string(busyTimeout.count()) + " ms");
             } else {
                 DLOG_S(INFO) << name << " is busy.";
                 sleep_for(10ms);
             }
-        } while (!notBusy);
+        }
 
         return {};
     }
@@ -72,6 +124,44 @@ namespace vibration_daq {
         return convert(resp);
     }
 
+    std::vector<uint16_t> VibrationSensorModule::readRegisters(const std::vector<SpiCommand> &cmds) const {
+        for (const auto &cmd : cmds) {
+            if (!cmd.readFlag) {
+                LOG_S(ERROR) << name << ": Cannot read SpiCommand (PageID: " << cmd.pageId << ", Address: "
+                             << cmd.address << "). Read flag not set.";
+                return {};
+            }
+        }
+
+        std::vector<uint16_t> values;
+        values.reserve(cmds.size());
+
+        // the response of a read is received with the next transfer
+        bool responsePending = false;
+        int pageId = -1;
+        for (const auto &cmd : cmds) {
+            if (cmd.pageId != pageId) {
+                WordBuffer resp = transferBlocking({0x80, cmd.pageId});
+                if (responsePending) {
+                    values.push_back(convert(resp));
+                }
+                responsePending = false;
+                pageId = cmd.pageId;
+            }
+
+            WordBuffer resp = transferBlocking({cmd.address, 0});
+            if (responsePending) {
+                values.push_back(convert(resp));
+            }
+            responsePending = true;
+        }
+        if (responsePending) {
+            values.push_back(convert(transferBlocking({0, 0})));
+        }
+
+        return values;
+    }
+
     void VibrationSensorModule::write(SpiCommand cmd, uint16_t value) const {
         if (!cmd.writeFlag) {
             LOG_S(ERROR) << name << ": Cannot write SpiCommand (PageID: " << cmd.pageId << ", Address: " << cmd.address
@@ -114,17 +204,82 @@ namespace vibration_daq {
             return false;
         }
 
-        // important for transient behaviour of busy pin on startup!
-        sleep_for(500ms);
-
         // check if the right model (ADcmXL3021) is connected and if the connection works
-        uint16_t prodId = read(spi_commands::PROD_ID);
-        if (prodId != 0x0BCD) {
-            LOG_F(ERROR, "Not getting the right prodId, getting: 0x%04X", prodId);
+        return waitUntilReady(READY_TIMEOUT);
+    }
+
+    bool VibrationSensorModule::reset() {
+        // the sensor loads its settings from flash after reset, the caches don't match anymore
+        faulted = false;
+        firFilterWritten = false;
+        customFilterTapsWritten = false;
+        currentRecCtrl = 0;
+        currentRecordingMode = RecordingMode::MTC;
+        // TIME_STAMP restarts
+        clockSync.clear();
+
+        bool resetPinWritten = false;
+        for (int attempt = 0; attempt < TRANSFER_ATTEMPTS && !resetPinWritten; ++attempt) {
+            resetPinWritten = gpio_write(gpioReset, false) >= 0;
+            if (resetPinWritten) {
+                sleep_for(10ms);
+                resetPinWritten = gpio_write(gpioReset, true) >= 0;
+            }
+            LOG_IF_F(WARNING, !resetPinWritten, "%s: gpio_write(): %s", name.c_str(), gpio_errmsg(gpioReset));
+        }
+
+        if (resetPinWritten && waitUntilReady(READY_TIMEOUT)) {
+            faultCounters.recoveries++;
+            LOG_S(INFO) << name << ": recovered by reset.";
+            return true;
+        }
+
+        faultCounters.failedRecoveries++;
+        setFault("Reset failed");
+        return false;
+    }
+
+    bool VibrationSensorModule::waitUntilReady(std::chrono::milliseconds timeout) const {
+        // busy pin toggles after reset, it has to stay high for a few polls
+        const int settledPollsCount = 5;
+
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        int notBusyPollsCount = 0;
+        bool prodIdRead = false;
+        uint16_t prodId = 0;
+        while (std::chrono::steady_clock::now() < deadline) {
+            bool notBusy;
+            if (gpio_read(gpioBusy, &notBusy) < 0) {
+                faultCounters.gpioReadErrors++;
+                LOG_F(ERROR, "gpio_read(): %s\n", gpio_errmsg(gpioBusy));
+                return false;
+            }
+
+            notBusyPollsCount = notBusy ? notBusyPollsCount + 1 : 0;
+            if (notBusyPollsCount >= settledPollsCount) {
+                prodId = read(spi_commands::PROD_ID);
+                prodIdRead = true;
+                if (prodId == 0x0BCD) {
+                    return true;
+                }
+                notBusyPollsCount = 0;
+            }
+
+            sleep_for(1ms);
+        }
+
+        if (!prodIdRead) {
+            // the busy pin never settled, so PROD_ID wasn't read
+            faultCounters.busyTimeouts++;
+            LOG_F(ERROR, "%s: Not ready after %lld ms, busy pin didn't settle", name.c_str(),
+                  static_cast<long long>(timeout.count()));
             return false;
         }
 
-        return true;
+        faultCounters.prodIdMismatches++;
+        LOG_F(ERROR, "%s: Not ready after %lld ms, getting prodId: 0x%04X", name.c_str(),
+              static_cast<long long>(timeout.count()), prodId);
+        return false;
     }
 
     void VibrationSensorModule::close() {
@@ -139,138 +294,394 @@ namespace vibration_daq {
     }
 
     bool VibrationSensorModule::writeRecordingControl(const RecordingMode &recordingMode,
-                                                      const WindowSetting &windowSetting) {
-        // hard type sample rate option 0
-        uint16_t recCtrl = 0x100;
+                                                      const WindowSetting &windowSetting, int sampleRateSlot) {
+        // one bit per sample rate option, starting at SR0 == 0x100
+        uint16_t recCtrl = 0x100 << sampleRateSlot;
 
         recCtrl |= (static_cast<uint8_t>(windowSetting) << 12);
         recCtrl |= static_cast<uint8_t>(recordingMode);
 
+        if (recCtrl == currentRecCtrl) {
+            return true;
+        }
+
         write(spi_commands::REC_CTRL, recCtrl);
 
-        recCtrl = read(spi_commands::REC_CTRL);
-        currentRecordingMode = static_cast<RecordingMode>(recCtrl & 0x3);
+        uint16_t recCtrlRead = read(spi_commands::REC_CTRL);
+        currentRecordingMode = static_cast<RecordingMode>(recCtrlRead & 0x3);
+        currentRecCtrl = recCtrlRead;
 
-        return currentRecordingMode == recordingMode;
+        return currentRecordingMode == recordingMode && (recCtrlRead & 0xF00) == (recCtrl & 0xF00);
     }
 
     VibrationData VibrationSensorModule::retrieveVibrationData() const {
         int samplesCount = 0;
+        int bufferOffset = 0;
         float recordStepSize = 0;
-        int decimationFactor = readRecInfoDecimationFactor();
+        const CaptureMetadata metadata = readCaptureMetadata();
+        const int decimationFactor = metadata.decimationFactor;
 
-        std::function<float(int16_t)> convertVibrationValue;
         switch (currentRecordingMode) {
             case RecordingMode::MTC:
                 samplesCount = 4096;
-                recordStepSize = 1.f / (220000.f / static_cast<float>(decimationFactor));
-                convertVibrationValue = {
-                        [](int16_t valueRaw) {
-                            return static_cast<float>(valueRaw) * 0.001907349;
-                        }
-                };
+                recordStepSize = getStepSize(currentRecordingMode, decimationFactor);
                 break;
             case RecordingMode::MFFT:
             case RecordingMode::AFFT:
-                const uint8_t numberOfFFTAvg = readRecInfoFFTAveragesCount();
-                samplesCount = 2048;
-                recordStepSize = 110000.f / static_cast<float>(decimationFactor) / static_cast<float>(samplesCount);
-                convertVibrationValue = {
-                        [numberOfFFTAvg](int16_t valueRaw) {
-                            // handle special case according to https://ez.analog.com/mems/f/q-a/162759/adcmxl3021-fft-conversion/372600#372600
-                            if(valueRaw == 0) {
-                                return 0.0;
-                            }
-                            return std::pow(2, static_cast<float>(valueRaw) / 2048) / numberOfFFTAvg * 0.9535;
-                        }
-                };
+                recordStepSize = getStepSize(currentRecordingMode, decimationFactor);
+                getFrequencyBandBins(recordStepSize, bufferOffset, samplesCount);
                 break;
         }
 
-        write(spi_commands::BUF_PNTR, 0);
-
         VibrationData vibrationData;
         vibrationData.recordingMode = currentRecordingMode;
-        vibrationData.stepAxis = generateSteps(recordStepSize, samplesCount);
-        vibrationData.xAxis = readSamplesBuffer(spi_commands::X_BUF, samplesCount, convertVibrationValue);
-        vibrationData.yAxis = readSamplesBuffer(spi_commands::Y_BUF, samplesCount, convertVibrationValue);
-        vibrationData.zAxis = readSamplesBuffer(spi_commands::Z_BUF, samplesCount, convertVibrationValue);
+        vibrationData.binOffset = bufferOffset;
+        vibrationData.axes = axes;
+        vibrationData.metadata = metadata;
+        vibrationData.stepSize = recordStepSize;
+        vibrationData.stepAxis = generateSteps(recordStepSize, samplesCount, bufferOffset);
+        for (const auto &axis : axes) {
+            vibrationData.getAxisRawData(axis) = readSamplesBuffer(getSamplesBufferCommand(axis), bufferOffset,
+                                                                   samplesCount);
+            vibrationData.getAxisData(axis) = convertVibrationValues(currentRecordingMode,
+                                                                     vibrationData.getAxisRawData(axis),
+                                                                     metadata.spectralAvgCount);
+            if (currentRecordingMode == RecordingMode::MTC) {
+                vibrationData.metadata.statistics[axis] = computeAxisStatistics(vibrationData.getAxisData(axis));
+            }
+        }
 
         return vibrationData;
     }
 
-    std::vector<float> VibrationSensorModule::generateSteps(float stepSize, int samplesCount) {
+    void VibrationSensorModule::getFrequencyBandBins(float binSize, int &firstBin, int &binsCount) const {
+        const int mfftBinsCount = 2048;
+
+        firstBin = std::min(static_cast<int>(std::floor(frequencyBandMin / binSize)), mfftBinsCount - 1);
+        int lastBin = mfftBinsCount - 1;
+        if (frequencyBandMax > 0) {
+            lastBin = std::min(static_cast<int>(std::ceil(frequencyBandMax / binSize)), mfftBinsCount - 1);
+        }
+        binsCount = lastBin - firstBin + 1;
+    }
+
+    SpiCommand VibrationSensorModule::getSamplesBufferCommand(const Axis &axis) {
+        switch (axis) {
+            case Axis::X:
+                return spi_commands::X_BUF;
+            case Axis::Y:
+                return spi_commands::Y_BUF;
+            case Axis::Z:
+            default:
+                return spi_commands::Z_BUF;
+        }
+    }
+
+    std::vector<float> VibrationSensorModule::generateSteps(float stepSize, int samplesCount, int firstStep) {
         std::vector<float> stepAxis;
         stepAxis.reserve(samplesCount);
 
-        for (int i = 0; i < samplesCount; ++i) {
+        for (int i = firstStep; i < (firstStep + samplesCount); ++i) {
             stepAxis.push_back(stepSize * i);
         }
 
         return stepAxis;
     }
 
-    std::vector<float> VibrationSensorModule::readSamplesBuffer(SpiCommand cmd, int samplesCount,
-                                                                const std::function<float(int16_t)> &convertVibrationValue) const {
-        std::vector<float> axisData;
-        axisData.reserve(samplesCount);
+    std::vector<int16_t> VibrationSensorModule::readSamplesBuffer(SpiCommand cmd, int bufferOffset,
+                                                                  int samplesCount) const {
+        std::vector<int16_t> samplesRaw;
+        for (int attempt = 1; !readRawSamplesBuffer(cmd, bufferOffset, samplesCount, samplesRaw); ++attempt) {
+            if (faulted) {
+                break;
+            }
+            if (attempt >= TRANSFER_ATTEMPTS) {
+                setFault("MISO shift persists");
+                break;
+            }
+        }
+
+        return samplesRaw;
+    }
+
+    bool VibrationSensorModule::readRawSamplesBuffer(SpiCommand cmd, int bufferOffset, int samplesCount,
+                                                     std::vector<int16_t> &samplesRaw) const {
+        samplesRaw.clear();
+        samplesRaw.reserve(samplesCount);
+
+        // seek to first sample, BUF_PNTR is on the same page as the buffers
+        write(spi_commands::BUF_PNTR, bufferOffset);
 
-        // select page
-        transferBlocking({0x80, cmd.pageId});
         transferBlocking({cmd.address, 0});
 
         for (int i = 0; i < (samplesCount - 1); ++i) {
             uint16_t resp = convert(transferBlocking({cmd.address, 0}));
-            auto valueRaw = static_cast<int16_t>(resp);
-            axisData.push_back(convertVibrationValue(valueRaw));
+            samplesRaw.push_back(static_cast<int16_t>(resp));
         }
-        int16_t valueRaw = static_cast<int16_t>(convert(transferBlocking({0, 0})));
-        axisData.push_back(convertVibrationValue(valueRaw));
-        return axisData;
+        samplesRaw.push_back(static_cast<int16_t>(convert(transferBlocking({0, 0}))));
+
+        return isMISOAligned();
     }
 
-    int VibrationSensorModule::readRecInfoFFTAveragesCount() const {
-        return read(spi_commands::REC_INFO1) & 0xFF;
+    bool VibrationSensorModule::isMISOAligned() const {
+        // a shift of MISO persists for the following words, so reading a known register afterwards reveals it
+        uint16_t prodId = read(spi_commands::PROD_ID);
+        if (faulted || prodId == 0x0BCD) {
+            return !faulted;
+        }
+
+        faultCounters.misoShifts++;
+        LOG_F(WARNING, "%s: MISO shift detected, reading PROD_ID as 0x%04X. Reading again.", name.c_str(),
+              prodId);
+        return false;
     }
 
-    int VibrationSensorModule::readRecInfoDecimationFactor() const {
-        int avgCnt = read(spi_commands::REC_INFO2) & 0x7;
-        return static_cast<int>(pow(2, avgCnt));
+    CaptureMetadata VibrationSensorModule::readCaptureMetadata() const {
+        CaptureMetadata metadata;
+
+        std::vector<uint16_t> values;
+        std::vector<uint16_t> timestampValues;
+        HostTimestamp beforeTimestamp;
+        HostTimestamp afterTimestamp;
+        // decimation and averages determine the step size and the conversion, so a shifted sweep is not stored
+        for (int attempt = 1;; ++attempt) {
+            values = readRegisters({
+                    spi_commands::REC_INFO1,
+                    spi_commands::REC_INFO2,
+                    spi_commands::REC_CTRL,
+                    spi_commands::FILT_CTRL,
+                    spi_commands::SERIAL_ID,
+                    spi_commands::REV_DAY,
+                    spi_commands::YEAR_MON,
+                    spi_commands::TEMP_OUT,
+                    spi_commands::SUPPLY_OUT,
+                    spi_commands::DIAG_STAT
+            });
+
+            // read TIME_STAMP separately, so that it is enclosed tightly by the host timestamps
+            beforeTimestamp = getHostTimestamp();
+            timestampValues = readRegisters({spi_commands::TIME_STAMP_L, spi_commands::TIME_STAMP_H});
+            afterTimestamp = getHostTimestamp();
+
+            if (faulted || isMISOAligned()) {
+                break;
+            }
+            if (attempt >= TRANSFER_ATTEMPTS) {
+                setFault("MISO shift persists");
+                break;
+            }
+        }
+
+        metadata.readoutTimestamp.monotonicRawNs = beforeTimestamp.monotonicRawNs +
+                                                   (afterTimestamp.monotonicRawNs - beforeTimestamp.monotonicRawNs) / 2;
+        metadata.readoutTimestamp.realtimeNs = beforeTimestamp.realtimeNs +
+                                               (afterTimestamp.realtimeNs - beforeTimestamp.realtimeNs) / 2;
+
+        if (values.size() != 10 || timestampValues.size() != 2 || faulted) {
+            return metadata;
+        }
+
+        if (currentRecordingMode != RecordingMode::MTC) {
+            metadata.spectralAvgCount = values[0] & 0xFF;
+        }
+        metadata.decimationFactor = 1 << (values[1] & 0x7);
+        metadata.windowSetting = static_cast<WindowSetting>((values[2] >> 12) & 0x3);
+        // custom taps are stored in bank F, which can't be distinguished by FILT_CTRL
+        metadata.firFilter = static_cast<FIRFilter>(values[3] & 0x7);
+        if (currentFIRFilter == FIRFilter::CUSTOM && metadata.firFilter == FIRFilter::HIGH_PASS_10kHz) {
+            metadata.firFilter = FIRFilter::CUSTOM;
+        }
+        metadata.serialId = values[4];
+        metadata.revDay = values[5];
+        metadata.yearMon = values[6];
+        metadata.tempOut = values[7];
+        metadata.supplyOut = values[8];
+        metadata.diagStat = values[9];
+        metadata.sensorTimestamp = (static_cast<uint32_t>(timestampValues[1]) << 16) | timestampValues[0];
+
+        clockSync.addPoint(metadata.sensorTimestamp, metadata.readoutTimestamp.monotonicRawNs);
+        metadata.clockMapping = clockSync.getMapping();
+
+        return metadata;
+    }
+
+    std::array<uint16_t, 3> VibrationSensorModule::getSampleRateRegisters(const SampleRateSlots &sampleRateSlots) {
+        uint16_t avgCnt = 0;
+        for (int i = 0; i < sampleRateSlots.size(); ++i) {
+            avgCnt |= static_cast<uint8_t>(sampleRateSlots[i].decimationFactor) << (i * 4);
+        }
+        uint16_t fftAvg1 = sampleRateSlots[0].spectralAvgCount | (sampleRateSlots[1].spectralAvgCount << 8);
+        uint16_t fftAvg2 = sampleRateSlots[2].spectralAvgCount | (sampleRateSlots[3].spectralAvgCount << 8);
+
+        return {avgCnt, fftAvg1, fftAvg2};
+    }
+
+    void VibrationSensorModule::setupSampleRateSlots(const SampleRateSlots &sampleRateSlots) const {
+        auto sampleRateRegisters = getSampleRateRegisters(sampleRateSlots);
+        write(spi_commands::AVG_CNT, sampleRateRegisters[0]);
+        write(spi_commands::FFT_AVG1, sampleRateRegisters[1]);
+        write(spi_commands::FFT_AVG2, sampleRateRegisters[2]);
+    }
+
+    std::optional<std::array<int16_t, 32>>
+    VibrationSensorModule::getCustomFilterTaps(const VibrationSensorConfig &config) {
+        for (const auto &scheduleEntry : config.schedule) {
+            const RecordingConfig &recordingConfig = scheduleEntry.recordingMode == RecordingMode::MFFT
+                                                     ? static_cast<const RecordingConfig &>(scheduleEntry.mfftConfig)
+                                                     : scheduleEntry.mtcConfig;
+            if (recordingConfig.firFilter == FIRFilter::CUSTOM) {
+                return recordingConfig.customFilterTaps;
+            }
+        }
+        return std::nullopt;
+    }
+
+    uint16_t VibrationSensorModule::computeConfigHash(const SampleRateSlots &sampleRateSlots,
+                                                      const std::optional<std::array<int16_t, 32>> &customFilterTaps,
+                                                      bool externalTrigger) {
+        // bump on changes of what configure() programs
+        const uint8_t hashVersion = 1;
+
+        uint32_t hash = fnv1aValue(hashVersion);
+        hash = fnv1aValue(static_cast<uint8_t>(externalTrigger), hash);
+        for (const auto &register_ : getSampleRateRegisters(sampleRateSlots)) {
+            hash = fnv1aValue(register_, hash);
+        }
+        hash = fnv1aValue(static_cast<uint8_t>(customFilterTaps.has_value()), hash);
+        if (customFilterTaps) {
+            for (const auto &tap : *customFilterTaps) {
+                hash = fnv1aValue(tap, hash);
+            }
+        }
+
+        auto configHash = static_cast<uint16_t>((hash >> 16) ^ (hash & 0xFFFF));
+        return configHash == 0 ? 1 : configHash;
+    }
+
+    bool VibrationSensorModule::verifyConfig(const SampleRateSlots &sampleRateSlots,
+                                             const std::optional<std::array<int16_t, 32>> &customFilterTaps,
+                                             bool externalTrigger) const {
+        auto sampleRateRegisters = getSampleRateRegisters(sampleRateSlots);
+        if (read(spi_commands::AVG_CNT) != sampleRateRegisters[0] ||
+            read(spi_commands::FFT_AVG1) != sampleRateRegisters[1] ||
+            read(spi_commands::FFT_AVG2) != sampleRateRegisters[2]) {
+            return false;
+        }
+
+        if (((read(spi_commands::MISC_CTRL) & 0x1000) != 0) != externalTrigger) {
+            return false;
+        }
+
+        if (customFilterTaps) {
+            for (int i = 0; i < customFilterTaps->size(); ++i) {
+                if (static_cast<int16_t>(read(spi_commands::FIR_COEFFS_F[i])) != (*customFilterTaps)[i]) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool VibrationSensorModule::configure(const VibrationSensorConfig &config, bool externalTrigger, bool verify) {
+        const auto customFilterTaps = getCustomFilterTaps(config);
+        const uint16_t configHash = computeConfigHash(config.sampleRateSlots, customFilterTaps, externalTrigger);
+
+        bool configured = read(spi_commands::USER_SCRATCH) == configHash;
+        if (configured && verify) {
+            configured = verifyConfig(config.sampleRateSlots, customFilterTaps, externalTrigger);
+            LOG_IF_S(WARNING, !configured) << name << ": config hash matches but read back differs, reprogramming.";
+        }
+
+        if (configured) {
+            LOG_S(INFO) << name << ": config hash " << getHexString(configHash) << " matches, skipping configuration.";
+        } else {
+            activateExternalTrigger(externalTrigger);
+            setupSampleRateSlots(config.sampleRateSlots);
+            if (customFilterTaps) {
+                writeCustomFIRFilterTaps(*customFilterTaps);
+            }
+
+            write(spi_commands::USER_SCRATCH, configHash);
+            saveToFlash();
+            LOG_S(INFO) << name << ": configured, config hash " << getHexString(configHash);
+        }
+
+        if (customFilterTaps) {
+            currentCustomFilterTaps = *customFilterTaps;
+            customFilterTapsWritten = true;
+        }
+
+        return !configured;
     }
 
     bool
     VibrationSensorModule::activateMode(const RecordingConfig &recordingConfig, const RecordingMode &recordingMode,
                                         const WindowSetting &windowSetting) {
-        // only modify SR0 as we only work with that. keep rest default.
-        uint16_t avgCnt = 0x7420;
-        avgCnt |= static_cast<uint8_t>(recordingConfig.decimationFactor);
-        write(spi_commands::AVG_CNT, avgCnt);
+        updateFIRFilter(recordingConfig);
 
-        if (recordingConfig.firFilter == FIRFilter::CUSTOM) {
-            writeCustomFIRFilterTaps(recordingConfig.customFilterTaps);
+        return writeRecordingControl(recordingMode, windowSetting, recordingConfig.sampleRateSlot);
+    }
 
-            // select filter bank F
-            writeFIRFilter(FIRFilter::HIGH_PASS_10kHz);
-        } else {
-            writeFIRFilter(recordingConfig.firFilter);
-        }
+    void VibrationSensorModule::updateBusyTimeout(const RecordingConfig &recordingConfig, int recordsCount) {
+        // 4096 samples per record at the decimated sample rate
+        const auto decimation = 1 << static_cast<uint8_t>(recordingConfig.decimationFactor);
+        const std::chrono::milliseconds recordingDuration{4096LL * decimation * recordsCount * 1000 / 220000};
 
-        return writeRecordingControl(recordingMode, windowSetting);
+        busyTimeout = std::max(DEFAULT_BUSY_TIMEOUT, 2 * recordingDuration + DEFAULT_BUSY_TIMEOUT);
     }
 
     bool VibrationSensorModule::activateMode(const MFFTConfig &mfftConfig) {
-        // only modify SR0 as we only work with that. keep rest default.
-        uint16_t fftAvg1 = 0x0100;
-        fftAvg1 |= mfftConfig.spectralAvgCount;
-        write(spi_commands::FFT_AVG1, fftAvg1);
+        frequencyBandMin = mfftConfig.frequencyBandMin;
+        frequencyBandMax = mfftConfig.frequencyBandMax;
+        updateBusyTimeout(mfftConfig, mfftConfig.spectralAvgCount);
 
         return activateMode(mfftConfig, RecordingMode::MFFT, mfftConfig.windowSetting);
     }
 
     bool VibrationSensorModule::activateMode(const MTCConfig &mtcConfig) {
+        updateBusyTimeout(mtcConfig, 1);
         return activateMode(mtcConfig, RecordingMode::MTC);
     }
 
+    bool VibrationSensorModule::activateMode(const ScheduleEntry &scheduleEntry) {
+        switch (scheduleEntry.recordingMode) {
+            case RecordingMode::MFFT:
+                return activateMode(scheduleEntry.mfftConfig);
+            case RecordingMode::MTC:
+                return activateMode(scheduleEntry.mtcConfig);
+            default:
+                LOG_S(ERROR) << name << ": only MFFT and MTC supported.";
+                return false;
+        }
+    }
+
+    void VibrationSensorModule::updateFIRFilter(const RecordingConfig &recordingConfig) {
+        // custom taps stay in filter bank F, even if another filter is selected in between
+        bool customFilterTapsChanged = recordingConfig.firFilter == FIRFilter::CUSTOM &&
+                                       (!customFilterTapsWritten ||
+                                        currentCustomFilterTaps != recordingConfig.customFilterTaps);
+        if (firFilterWritten && currentFIRFilter == recordingConfig.firFilter && !customFilterTapsChanged) {
+            return;
+        }
+
+        if (recordingConfig.firFilter == FIRFilter::CUSTOM) {
+            if (customFilterTapsChanged) {
+                writeCustomFIRFilterTaps(recordingConfig.customFilterTaps);
+                currentCustomFilterTaps = recordingConfig.customFilterTaps;
+                customFilterTapsWritten = true;
+            }
+
+            // select filter bank F
+            writeFIRFilter(FIRFilter::HIGH_PASS_10kHz);
+        } else {
+            writeFIRFilter(recordingConfig.firFilter);
+        }
+
+        currentFIRFilter = recordingConfig.firFilter;
+        firFilterWritten = true;
+    }
+
     void VibrationSensorModule::writeFIRFilter(FIRFilter firFilter) {
         uint16_t filtCtrl = 0x0000;
         // set for every axis same filter
@@ -291,42 +702,77 @@ namespace vibration_daq {
         write(spi_commands::GLOB_CMD, 0x0800);
     }
 
-    void VibrationSensorModule::activateExternalTrigger() const {
-        write(spi_commands::MISC_CTRL, 0x1000);
+    void VibrationSensorModule::prepareTrigger() const {
+        // select page and write lower byte of GLOB_CMD, the command is executed with the upper byte
+        transferBlocking({0x80, spi_commands::GLOB_CMD.pageId});
+        transferBlocking({static_cast<unsigned char>(spi_commands::GLOB_CMD.address | 0x80), 0x00});
     }
 
-    void VibrationSensorModule::triggerAutonull() const {
-        // Clear autonull correction 
-        write(spi_commands::GLOB_CMD, 0x8000);
+    HostTimestamp VibrationSensorModule::fireTrigger() const {
+        // the sensor is busy after the trigger anyway, no need to wait the word gap
+        transfer({static_cast<unsigned char>((spi_commands::GLOB_CMD.address + 1) | 0x80), 0x08}, false);
+        return getHostTimestamp();
+    }
 
-        // save to flash
+    void VibrationSensorModule::activateExternalTrigger(bool activate) const {
+        write(spi_commands::MISC_CTRL, activate ? 0x1000 : 0x0000);
+    }
+
+    void VibrationSensorModule::saveToFlash() const {
         write(spi_commands::GLOB_CMD, 0x0040);
+    }
 
+    std::array<uint16_t, 3> VibrationSensorModule::measureStatistics() {
         // setting statistic mode
-        LOG_S(INFO) << "setting statistic mode";
+        LOG_S(INFO) << name << ": setting statistic mode";
         write(spi_commands::REC_CTRL, 0x1142);
+        currentRecCtrl = 0x1142;
         sleep_for(200ms);
 
         // execute sensor
-        LOG_S(INFO) << "start record";
+        LOG_S(INFO) << name << ": start record";
         write(spi_commands::GLOB_CMD, 0x0800);
         sleep_for(1000ms);
 
         // read stat
-        uint16_t x_stat = read(spi_commands::X_STATISTIC);
-        uint16_t y_stat = read(spi_commands::Y_STATISTIC);
-        uint16_t z_stat = read(spi_commands::Z_STATISTIC);
-        LOG_S(INFO) << "x_stat: " << x_stat;
-        LOG_S(INFO) << "y_stat: " << y_stat;
-        LOG_S(INFO) << "z_stat: " << z_stat;
+        std::array<uint16_t, 3> statistics = {
+                read(spi_commands::X_STATISTIC),
+                read(spi_commands::Y_STATISTIC),
+                read(spi_commands::Z_STATISTIC)
+        };
+        LOG_S(INFO) << name << ": x_stat: " << statistics[0];
+        LOG_S(INFO) << name << ": y_stat: " << statistics[1];
+        LOG_S(INFO) << name << ": z_stat: " << statistics[2];
+
+        return statistics;
+    }
+
+    std::array<uint16_t, 3> VibrationSensorModule::triggerAutonull() {
+        // Clear autonull correction, no need to save it to flash as the new one is saved below
+        write(spi_commands::GLOB_CMD, 0x8000);
+
+        auto statistics = measureStatistics();
         sleep_for(200ms);
 
-        write(spi_commands::X_ANULL, x_stat);
-        write(spi_commands::Y_ANULL, y_stat);
-        write(spi_commands::Z_ANULL, z_stat);
+        write(spi_commands::X_ANULL, statistics[0]);
+        write(spi_commands::Y_ANULL, statistics[1]);
+        write(spi_commands::Z_ANULL, statistics[2]);
 
-        // save to flash
-        write(spi_commands::GLOB_CMD, 0x0040);
+        saveToFlash();
+
+        return statistics;
+    }
+
+    std::array<uint16_t, 3> VibrationSensorModule::readAutonullCorrection() const {
+        return {read(spi_commands::X_ANULL), read(spi_commands::Y_ANULL), read(spi_commands::Z_ANULL)};
+    }
+
+    uint16_t VibrationSensorModule::readSerialId() const {
+        return read(spi_commands::SERIAL_ID);
+    }
+
+    uint32_t VibrationSensorModule::readFlashWriteCount() const {
+        return read(spi_commands::ENDUR_LWR) | (static_cast<uint32_t>(read(spi_commands::ENDUR_UPR)) << 16);
     }
 
     void VibrationSensorModule::restoreFactorySettings() {